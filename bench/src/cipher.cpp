@@ -0,0 +1,389 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief The cipher benchmark.
+ *
+ * Measures the throughput of every registered cipher algorithm, for buffer sizes from 16 bytes to 16 MiB, using raw EVP calls, a cipher_context and a cipher_stream. Each buffer is ciphered as a whole message: initialization, update and finalization.
+ *
+ * An algorithm stops being measured with larger buffers once ciphering a single buffer takes more than a quarter of a second.
+ *
+ * Usage: cipher_bench [-d duration_ms] [algorithm...]
+ *
+ * The results are written to the standard output in JSON.
+ */
+
+#include <cryptoplus/cryptoplus.hpp>
+#include <cryptoplus/cipher/cipher_context.hpp>
+#include <cryptoplus/cipher/cipher_stream.hpp>
+#include <cryptoplus/random/random.hpp>
+#include <cryptoplus/error/error_strings.hpp>
+
+#include <openssl/opensslv.h>
+#include <openssl/evp.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using cryptoplus::cipher::cipher_algorithm;
+using cryptoplus::cipher::cipher_context;
+using cryptoplus::cipher::cipher_stream;
+
+namespace
+{
+	const size_t minimum_size = 16;
+	const size_t maximum_size = 16 * 1024 * 1024;
+	const size_t size_factor = 4;
+
+	// The minimum count of bytes to cipher between two clock reads.
+	const size_t batch_size = 64 * 1024;
+
+	const unsigned int default_duration = 20;
+
+	// Algorithms slower than this per message (like the 1-bit CFB modes) are not measured with larger buffers.
+	const boost::int64_t maximum_message_duration = 250000;
+
+	void add_algorithm_name(const EVP_CIPHER* cipher, const char* from, const char*, void* arg)
+	{
+		// Aliases have no cipher.
+		if (cipher)
+		{
+			static_cast<std::set<std::string>*>(arg)->insert(from);
+		}
+	}
+
+	std::vector<std::string> get_algorithm_names()
+	{
+		std::set<std::string> names;
+
+		EVP_CIPHER_do_all_sorted(add_algorithm_name, &names);
+
+		return std::vector<std::string>(names.begin(), names.end());
+	}
+
+	std::string json_string(const std::string& str)
+	{
+		std::ostringstream result;
+
+		result << '"';
+
+		for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+		{
+			if ((*it == '"') || (*it == '\\'))
+			{
+				result << '\\' << *it;
+			}
+			else if (static_cast<unsigned char>(*it) < 0x20)
+			{
+				result << ' ';
+			}
+			else
+			{
+				result << *it;
+			}
+		}
+
+		result << '"';
+
+		return result.str();
+	}
+
+	class evp_method : public boost::noncopyable
+	{
+		public:
+
+			evp_method(const cipher_algorithm& algorithm, const std::vector<unsigned char>& key, const std::vector<unsigned char>& iv) :
+				m_algorithm(algorithm), m_key(key), m_iv(iv), m_ctx(EVP_CIPHER_CTX_new())
+			{
+				cryptoplus::error::throw_error_if_not(m_ctx != NULL);
+			}
+
+			~evp_method()
+			{
+				EVP_CIPHER_CTX_free(m_ctx);
+			}
+
+			static const char* name()
+			{
+				return "evp";
+			}
+
+			void operator()(unsigned char* out, const unsigned char* in, size_t len)
+			{
+				int out_len = 0;
+
+				cryptoplus::error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, m_algorithm.raw(), NULL, &m_key[0], m_iv.empty() ? NULL : &m_iv[0], 1) != 0);
+				cryptoplus::error::throw_error_if_not(EVP_CipherUpdate(m_ctx, out, &out_len, in, static_cast<int>(len)) != 0);
+				cryptoplus::error::throw_error_if_not(EVP_CipherFinal_ex(m_ctx, out + out_len, &out_len) != 0);
+			}
+
+		private:
+
+			cipher_algorithm m_algorithm;
+			const std::vector<unsigned char>& m_key;
+			const std::vector<unsigned char>& m_iv;
+			EVP_CIPHER_CTX* m_ctx;
+	};
+
+	class context_method
+	{
+		public:
+
+			context_method(const cipher_algorithm& algorithm, const std::vector<unsigned char>& key, const std::vector<unsigned char>& iv) :
+				m_algorithm(algorithm), m_key(key), m_iv(iv)
+			{
+			}
+
+			static const char* name()
+			{
+				return "cipher_context";
+			}
+
+			void operator()(unsigned char* out, const unsigned char* in, size_t len)
+			{
+				const size_t out_len = len + m_algorithm.block_size();
+
+				m_ctx.initialize(m_algorithm, cipher_context::encrypt, &m_key[0], m_key.size(), m_iv.empty() ? NULL : &m_iv[0], m_iv.size());
+				const size_t cnt = m_ctx.update(out, out_len, in, len);
+				m_ctx.finalize(out + cnt, out_len - cnt);
+			}
+
+		private:
+
+			cipher_algorithm m_algorithm;
+			const std::vector<unsigned char>& m_key;
+			const std::vector<unsigned char>& m_iv;
+			cipher_context m_ctx;
+	};
+
+	class stream_method
+	{
+		public:
+
+			stream_method(const cipher_algorithm& algorithm, const std::vector<unsigned char>& key, const std::vector<unsigned char>& iv) :
+				m_algorithm(algorithm), m_key(key), m_iv(iv), m_stream(maximum_size + algorithm.block_size())
+			{
+			}
+
+			static const char* name()
+			{
+				return "cipher_stream";
+			}
+
+			void operator()(unsigned char*, const unsigned char* in, size_t len)
+			{
+				// The output stays in the stream's own buffer.
+				m_stream.initialize(m_algorithm, cipher_stream::encrypt, &m_key[0], m_key.size(), m_iv.empty() ? NULL : &m_iv[0], m_iv.size());
+				m_stream.append(in, len);
+				m_stream.finalize();
+			}
+
+		private:
+
+			cipher_algorithm m_algorithm;
+			const std::vector<unsigned char>& m_key;
+			const std::vector<unsigned char>& m_iv;
+			cipher_stream m_stream;
+	};
+
+	class benchmark
+	{
+		public:
+
+			explicit benchmark(unsigned int duration) :
+				m_duration(duration),
+				m_input(cryptoplus::random::get_random_bytes<unsigned char>(maximum_size)),
+				m_output(maximum_size + EVP_MAX_BLOCK_LENGTH),
+				m_first_result(true)
+			{
+			}
+
+			void run(const std::string& name)
+			{
+				try
+				{
+					const cipher_algorithm algorithm(name);
+
+					if (algorithm.key_length() == 0)
+					{
+						throw std::invalid_argument("The algorithm takes no key");
+					}
+
+					const std::vector<unsigned char> key = cryptoplus::random::get_random_bytes<unsigned char>(algorithm.key_length());
+					const std::vector<unsigned char> iv = cryptoplus::random::get_random_bytes<unsigned char>(algorithm.iv_length());
+
+					evp_method evp(algorithm, key, iv);
+					context_method context(algorithm, key, iv);
+					stream_method stream(algorithm, key, iv);
+
+					for (size_t size = minimum_size; size <= maximum_size; size *= size_factor)
+					{
+						boost::int64_t message_duration = measure(name, evp, size);
+						message_duration = std::max(message_duration, measure(name, context, size));
+						message_duration = std::max(message_duration, measure(name, stream, size));
+
+						if (message_duration > maximum_message_duration)
+						{
+							break;
+						}
+					}
+				}
+				catch (std::exception& ex)
+				{
+					// Some algorithms can't be used without specific parameters (key wrapping, stitched modes, ...).
+					m_errors.push_back(std::make_pair(name, std::string(ex.what())));
+				}
+			}
+
+			void write_errors()
+			{
+				std::cout << "\n\t],\n\t\"errors\": [";
+
+				for (std::vector<std::pair<std::string, std::string> >::const_iterator it = m_errors.begin(); it != m_errors.end(); ++it)
+				{
+					std::cout << ((it == m_errors.begin()) ? "\n" : ",\n");
+					std::cout << "\t\t{ \"algorithm\": " << json_string(it->first) << ", \"error\": " << json_string(it->second) << " }";
+				}
+
+				std::cout << "\n\t]";
+			}
+
+		private:
+
+			template <typename Method>
+			boost::int64_t measure(const std::string& name, Method& method, size_t size)
+			{
+				const size_t batch = std::max(batch_size / size, static_cast<size_t>(1));
+
+				// Warm up, and make sure the algorithm works before printing anything.
+				if (size <= batch_size)
+				{
+					method(&m_output[0], &m_input[0], size);
+				}
+
+				boost::uint64_t iterations = 0;
+				const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+				boost::posix_time::time_duration elapsed;
+
+				do
+				{
+					for (size_t i = 0; i < batch; ++i)
+					{
+						method(&m_output[0], &m_input[0], size);
+					}
+
+					iterations += batch;
+					elapsed = boost::posix_time::microsec_clock::universal_time() - start;
+				}
+				while (elapsed.total_milliseconds() < m_duration);
+
+				const double bytes_per_second = static_cast<double>(iterations) * static_cast<double>(size) * 1000000.0 / static_cast<double>(std::max(elapsed.total_microseconds(), static_cast<boost::int64_t>(1)));
+
+				std::cout << (m_first_result ? "\n" : ",\n");
+				std::cout << "\t\t{ \"algorithm\": " << json_string(name) << ", \"method\": " << json_string(Method::name()) << ", \"size\": " << size << ", \"iterations\": " << iterations << ", \"bytes_per_second\": " << static_cast<boost::uint64_t>(bytes_per_second) << " }";
+				std::cout.flush();
+
+				m_first_result = false;
+
+				return elapsed.total_microseconds() / static_cast<boost::int64_t>(iterations);
+			}
+
+			boost::int64_t m_duration;
+			std::vector<unsigned char> m_input;
+			std::vector<unsigned char> m_output;
+			bool m_first_result;
+			std::vector<std::pair<std::string, std::string> > m_errors;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	cryptoplus::crypto_initializer crypto_initializer;
+	cryptoplus::algorithms_initializer algorithms_initializer;
+	cryptoplus::error::error_strings_initializer error_strings_initializer;
+
+	unsigned int duration = default_duration;
+	std::vector<std::string> names;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if ((std::strcmp(argv[i], "-d") == 0) && (i + 1 < argc))
+		{
+			duration = static_cast<unsigned int>(std::atoi(argv[++i]));
+		}
+		else
+		{
+			names.push_back(argv[i]);
+		}
+	}
+
+	if (names.empty())
+	{
+		names = get_algorithm_names();
+	}
+
+	benchmark bench(duration);
+
+	std::cout << "{\n\t\"openssl_version\": " << json_string(OPENSSL_VERSION_TEXT) << ",\n\t\"duration_ms\": " << duration << ",\n\t\"results\": [";
+
+	for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name)
+	{
+		std::cerr << "Benchmarking " << *name << "..." << std::endl;
+
+		bench.run(*name);
+	}
+
+	bench.write_errors();
+
+	std::cout << "\n}" << std::endl;
+
+	return EXIT_SUCCESS;
+}
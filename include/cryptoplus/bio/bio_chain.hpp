@@ -73,7 +73,11 @@ namespace cryptoplus
 				 * \brief Create a new bio_chain from a BIO_METHOD.
 				 * \param type The type.
 				 */
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+				explicit bio_chain(const BIO_METHOD* type);
+#else
 				explicit bio_chain(BIO_METHOD* type);
+#endif
 
 				/**
 				 * \brief Create a new bio_chain by taking ownership of an existing BIO pointer.
@@ -93,9 +97,13 @@ namespace cryptoplus
 				boost::shared_ptr<BIO> m_bio;
 		};
 
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		inline bio_chain::bio_chain(const BIO_METHOD* _type) : m_bio(BIO_new(_type), BIO_free_all)
+#else
 		inline bio_chain::bio_chain(BIO_METHOD* _type) : m_bio(BIO_new(_type), BIO_free_all)
+#endif
 		{
-			error::throw_error_if_not(m_bio);
+			error::throw_error_if_not(m_bio.get() != NULL);
 		}
 		inline bio_chain::bio_chain(BIO* bio) : m_bio(bio, BIO_free_all)
 		{
@@ -94,12 +94,16 @@ namespace cryptoplus
 				 */
 				BIO* raw();
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
 				/**
 				 * \brief Set the method of the BIO.
 				 * \param type The type.
 				 * \return true on success.
+				 *
+				 * BIO_set() was removed in OpenSSL 1.1: this method is not available there.
 				 */
 				bool set_method(BIO_METHOD* type);
+#endif
 
 				/**
 				 * \brief Push a bio_ptr at the bottom of the BIO chain.
@@ -492,10 +496,12 @@ namespace cryptoplus
 		{
 			return m_bio;
 		}
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
 		inline bool bio_ptr::set_method(BIO_METHOD* _type)
 		{
 			return BIO_set(m_bio, _type) != 0;
 		}
+#endif
 		inline bio_ptr bio_ptr::push(bio_ptr bio)
 		{
 			return bio_ptr(BIO_push(m_bio, bio.raw()));
@@ -0,0 +1,127 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file buffer.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Buffer reference types, for scatter/gather operations.
+ */
+
+#ifndef CRYPTOPLUS_BUFFER_HPP
+#define CRYPTOPLUS_BUFFER_HPP
+
+#include <cstddef>
+
+namespace cryptoplus
+{
+	/**
+	 * \brief A reference to a writable memory region.
+	 *
+	 * A mutable_buffer does not own the memory it refers to.
+	 */
+	struct mutable_buffer
+	{
+		/**
+		 * \brief Create an empty mutable_buffer.
+		 */
+		mutable_buffer() : data(NULL), size(0) {}
+
+		/**
+		 * \brief Create a mutable_buffer.
+		 * \param _data The memory region. Can be NULL only if _size is 0.
+		 * \param _size The size of the memory region.
+		 */
+		mutable_buffer(void* _data, size_t _size) : data(_data), size(_size) {}
+
+		void* data; /**< \brief The memory region. */
+		size_t size; /**< \brief The size of the memory region. */
+	};
+
+	/**
+	 * \brief A reference to a read-only memory region.
+	 *
+	 * A const_buffer does not own the memory it refers to.
+	 */
+	struct const_buffer
+	{
+		/**
+		 * \brief Create an empty const_buffer.
+		 */
+		const_buffer() : data(NULL), size(0) {}
+
+		/**
+		 * \brief Create a const_buffer.
+		 * \param _data The memory region. Can be NULL only if _size is 0.
+		 * \param _size The size of the memory region.
+		 */
+		const_buffer(const void* _data, size_t _size) : data(_data), size(_size) {}
+
+		/**
+		 * \brief Create a const_buffer from a mutable_buffer.
+		 * \param buf The mutable_buffer.
+		 */
+		const_buffer(const mutable_buffer& buf) : data(buf.data), size(buf.size) {}
+
+		const void* data; /**< \brief The memory region. */
+		size_t size; /**< \brief The size of the memory region. */
+	};
+
+	/**
+	 * \brief Get the total size of a buffer sequence.
+	 * \param buffers The buffers.
+	 * \param buffers_count The count of buffers.
+	 * \return The sum of the buffers sizes.
+	 */
+	template <typename T>
+	size_t buffers_size(const T* buffers, size_t buffers_count);
+
+	template <typename T>
+	inline size_t buffers_size(const T* buffers, size_t buffers_count)
+	{
+		size_t result = 0;
+
+		for (const T* buf = buffers; buf != buffers + buffers_count; ++buf)
+		{
+			result += buf->size;
+		}
+
+		return result;
+	}
+}
+
+#endif /* CRYPTOPLUS_BUFFER_HPP */
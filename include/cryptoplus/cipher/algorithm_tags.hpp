@@ -0,0 +1,233 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file algorithm_tags.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Compile-time cipher algorithm tags.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_ALGORITHM_TAGS_HPP
+#define CRYPTOPLUS_CIPHER_ALGORITHM_TAGS_HPP
+
+#include "cipher_algorithm.hpp"
+
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+
+#include <boost/array.hpp>
+
+#include <cstddef>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief The base class of the cipher algorithm tags.
+		 * \tparam KeyLength The key length.
+		 * \tparam IvLength The iv length.
+		 * \tparam BlockSize The block size.
+		 *
+		 * A cipher algorithm tag gives the sizes of a cipher algorithm as integral constant expressions, so that they can be used to size arrays. Its raw() static method returns the EVP_CIPHER directly, without any lookup by name.
+		 *
+		 * Tags can be given to the cipher_context::initialize() overload that takes fixed-size boost::array keys and ivs: that overload does not need any runtime length check.
+		 */
+		template <size_t KeyLength, size_t IvLength, size_t BlockSize>
+		struct cipher_algorithm_tag
+		{
+			/**
+			 * \brief The key length.
+			 */
+			static const size_t key_length = KeyLength;
+
+			/**
+			 * \brief The iv length.
+			 */
+			static const size_t iv_length = IvLength;
+
+			/**
+			 * \brief The block size.
+			 */
+			static const size_t block_size = BlockSize;
+
+			/**
+			 * \brief The key type.
+			 */
+			typedef boost::array<unsigned char, KeyLength> key_type;
+
+			/**
+			 * \brief The iv type.
+			 */
+			typedef boost::array<unsigned char, IvLength> iv_type;
+		};
+
+		template <size_t KeyLength, size_t IvLength, size_t BlockSize>
+		const size_t cipher_algorithm_tag<KeyLength, IvLength, BlockSize>::key_length;
+
+		template <size_t KeyLength, size_t IvLength, size_t BlockSize>
+		const size_t cipher_algorithm_tag<KeyLength, IvLength, BlockSize>::iv_length;
+
+		template <size_t KeyLength, size_t IvLength, size_t BlockSize>
+		const size_t cipher_algorithm_tag<KeyLength, IvLength, BlockSize>::block_size;
+
+		/**
+		 * \brief Get the cipher_algorithm of a tag.
+		 * \param tag The tag.
+		 * \return The cipher_algorithm.
+		 */
+		template <typename Algorithm>
+		cipher_algorithm get_cipher_algorithm(Algorithm tag);
+
+		/**
+		 * \brief The AES-128-ECB algorithm tag.
+		 */
+		struct aes_128_ecb : cipher_algorithm_tag<16, 0, 16>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_128_ecb(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-256-ECB algorithm tag.
+		 */
+		struct aes_256_ecb : cipher_algorithm_tag<32, 0, 16>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_256_ecb(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-128-CBC algorithm tag.
+		 */
+		struct aes_128_cbc : cipher_algorithm_tag<16, 16, 16>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_128_cbc(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-192-CBC algorithm tag.
+		 */
+		struct aes_192_cbc : cipher_algorithm_tag<24, 16, 16>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_192_cbc(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-256-CBC algorithm tag.
+		 */
+		struct aes_256_cbc : cipher_algorithm_tag<32, 16, 16>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_256_cbc(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The DES-EDE3-CBC algorithm tag.
+		 */
+		struct des_ede3_cbc : cipher_algorithm_tag<24, 8, 8>
+		{
+			static const EVP_CIPHER* raw() { return EVP_des_ede3_cbc(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+		/**
+		 * \brief The AES-128-CTR algorithm tag.
+		 */
+		struct aes_128_ctr : cipher_algorithm_tag<16, 16, 1>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_128_ctr(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-256-CTR algorithm tag.
+		 */
+		struct aes_256_ctr : cipher_algorithm_tag<32, 16, 1>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_256_ctr(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-128-GCM algorithm tag.
+		 */
+		struct aes_128_gcm : cipher_algorithm_tag<16, 12, 1>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_128_gcm(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-256-GCM algorithm tag.
+		 */
+		struct aes_256_gcm : cipher_algorithm_tag<32, 12, 1>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_256_gcm(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-128-XTS algorithm tag.
+		 */
+		struct aes_128_xts : cipher_algorithm_tag<32, 16, 1>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_128_xts(); } /**< \brief Get the EVP_CIPHER. */
+		};
+
+		/**
+		 * \brief The AES-256-XTS algorithm tag.
+		 */
+		struct aes_256_xts : cipher_algorithm_tag<64, 16, 1>
+		{
+			static const EVP_CIPHER* raw() { return EVP_aes_256_xts(); } /**< \brief Get the EVP_CIPHER. */
+		};
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		/**
+		 * \brief The ChaCha20-Poly1305 algorithm tag.
+		 */
+		struct chacha20_poly1305 : cipher_algorithm_tag<32, 12, 1>
+		{
+			static const EVP_CIPHER* raw() { return EVP_chacha20_poly1305(); } /**< \brief Get the EVP_CIPHER. */
+		};
+#endif
+
+		template <typename Algorithm>
+		inline cipher_algorithm get_cipher_algorithm(Algorithm)
+		{
+			return cipher_algorithm(Algorithm::raw());
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_CIPHER_ALGORITHM_TAGS_HPP */
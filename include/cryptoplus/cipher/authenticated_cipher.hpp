@@ -0,0 +1,159 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file authenticated_cipher.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief An encrypt-then-MAC authenticated cipher class.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_AUTHENTICATED_CIPHER_HPP
+#define CRYPTOPLUS_CIPHER_AUTHENTICATED_CIPHER_HPP
+
+#include "cipher_context.hpp"
+#include "../hash/hmac_context.hpp"
+
+#include <boost/noncopyable.hpp>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief An encrypt-then-MAC authenticated cipher class.
+		 *
+		 * authenticated_cipher combines a non-AEAD cipher algorithm (for instance: AES-128-CBC) and a HMAC into an authenticated encryption scheme, with the construction of draft-mcgrew-aead-aes-cbc-hmac-sha2: the tag is the HMAC of the additional data, the iv, the ciphertext and the bit length of the additional data (as a 64-bits big-endian integer), truncated to the requested length.
+		 *
+		 * The data is processed in a single pass: it is split in small chunks and each chunk is authenticated right after it was encrypted (or right before it is decrypted), while it is still in the processor cache.
+		 *
+		 * Both keys are set once, on construction: each message only sets a new iv and resets the HMAC state.
+		 *
+		 * An authenticated_cipher can be used by only one thread at a time. authenticated_cipher is noncopyable by design.
+		 */
+		class authenticated_cipher : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The size of the chunks the data is processed by.
+				 */
+				static const size_t chunk_size;
+
+				/**
+				 * \brief Create a new authenticated_cipher.
+				 * \param algorithm The cipher algorithm to use. If algorithm is an AEAD algorithm, a std::invalid_argument is thrown.
+				 * \param key The encryption key. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param mac_algorithm The message digest algorithm to use for the HMAC.
+				 * \param mac_key The HMAC key. Cannot be NULL and must differ from key.
+				 * \param mac_key_len The length of mac_key. Cannot be 0 or a std::invalid_argument is thrown.
+				 */
+				authenticated_cipher(const cipher_algorithm& algorithm, const void* key, size_t key_len, const hash::message_digest_algorithm& mac_algorithm, const void* mac_key, size_t mac_key_len);
+
+				/**
+				 * \brief Get the cipher algorithm.
+				 * \return The cipher algorithm.
+				 */
+				cipher_algorithm algorithm() const;
+
+				/**
+				 * \brief Get the message digest algorithm used for the HMAC.
+				 * \return The message digest algorithm.
+				 */
+				hash::message_digest_algorithm mac_algorithm() const;
+
+				/**
+				 * \brief Encrypt and authenticate a buffer.
+				 * \param out The output buffer. Must be at least in_len + algorithm().block_size() bytes long. Cannot overlap in.
+				 * \param out_len The length of out.
+				 * \param in The buffer to encrypt. Can be NULL if in_len is 0.
+				 * \param in_len The length of in.
+				 * \param iv The iv to use (if one is needed for the algorithm, NULL otherwise).
+				 * \param iv_len The length of iv. Must match algorithm().iv_length() or a std::runtime_error is thrown.
+				 * \param aad The additional authenticated data. Can be NULL if aad_len is 0.
+				 * \param aad_len The length of aad.
+				 * \param tag The buffer that receives the authentication tag. Cannot be NULL.
+				 * \param tag_len The length of tag. Cannot be 0 or greater than mac_algorithm().result_size() or a std::invalid_argument is thrown.
+				 * \return The count of bytes written to out.
+				 */
+				size_t encrypt(void* out, size_t out_len, const void* in, size_t in_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* tag, size_t tag_len);
+
+				/**
+				 * \brief Check the authenticity of a buffer and decrypt it.
+				 * \param out The output buffer. Must be at least in_len + algorithm().block_size() bytes long. Cannot overlap in.
+				 * \param out_len The length of out.
+				 * \param in The buffer to decrypt. Can be NULL if in_len is 0.
+				 * \param in_len The length of in.
+				 * \param iv The iv that was used to encrypt in (if one is needed for the algorithm, NULL otherwise).
+				 * \param iv_len The length of iv. Must match algorithm().iv_length() or a std::runtime_error is thrown.
+				 * \param aad The additional authenticated data. Can be NULL if aad_len is 0.
+				 * \param aad_len The length of aad.
+				 * \param tag The authentication tag. Cannot be NULL.
+				 * \param tag_len The length of tag. Cannot be 0 or greater than mac_algorithm().result_size() or a std::invalid_argument is thrown.
+				 * \param len A pointer to the variable that receives the count of bytes written to out. Cannot be NULL.
+				 * \return true if the tag matches. If the tag does not match, false is returned, nothing is written to len and the first in_len + algorithm().block_size() bytes of out (at most out_len) are zeroed so that no unauthenticated plaintext is ever exposed.
+				 *
+				 * The padding is only checked once the tag was checked, so that the padding errors of forged messages remain undistinguishable from tag errors.
+				 */
+				bool decrypt(void* out, size_t out_len, const void* in, size_t in_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, const void* tag, size_t tag_len, size_t* len);
+
+			private:
+
+				void start_mac(const void* iv, size_t iv_len, const void* aad, size_t aad_len);
+				void finish_mac(unsigned char* mac, size_t aad_len);
+
+				cipher_algorithm m_algorithm;
+				hash::message_digest_algorithm m_mac_algorithm;
+				cipher_context m_encrypt_context;
+				cipher_context m_decrypt_context;
+				hash::hmac_context m_hmac_context;
+		};
+
+		inline cipher_algorithm authenticated_cipher::algorithm() const
+		{
+			return m_algorithm;
+		}
+
+		inline hash::message_digest_algorithm authenticated_cipher::mac_algorithm() const
+		{
+			return m_mac_algorithm;
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_CIPHER_AUTHENTICATED_CIPHER_HPP */
@@ -0,0 +1,304 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file channel.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A secure datagram channel class.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_CHANNEL_HPP
+#define CRYPTOPLUS_CIPHER_CHANNEL_HPP
+
+#include "cipher_context.hpp"
+#include "../hash/message_digest_algorithm.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/lockfree/stack.hpp>
+
+#include <vector>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief An anti-replay window.
+		 *
+		 * replay_window remembers which sequence numbers were seen among the last size() ones and rejects the sequence numbers that were already seen or that are too old to be checked.
+		 *
+		 * The window is a bitmap of 32-bits words, each one tagged with the block of sequence numbers it currently holds. Both the tag and the bits live in the same atomic 64-bits word so that accept() only needs one compare-and-swap: a replay_window can be used concurrently by several threads without any lock.
+		 */
+		class replay_window : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief Create a new replay_window.
+				 * \param size The count of sequence numbers the window spans. It is rounded up to a multiple of 32. Cannot be 0 or a std::invalid_argument is thrown.
+				 */
+				explicit replay_window(size_t size);
+
+				/**
+				 * \brief Get the size of the window.
+				 * \return The count of sequence numbers the window spans.
+				 */
+				size_t size() const;
+
+				/**
+				 * \brief Get the highest accepted sequence number.
+				 * \return The highest accepted sequence number, or 0 if none was accepted.
+				 */
+				boost::uint64_t highest() const;
+
+				/**
+				 * \brief Check whether a sequence number would be accepted, without marking it.
+				 * \param sequence The sequence number.
+				 * \return true if sequence was not seen yet and is not too old.
+				 *
+				 * check() is meant to drop replayed packets before their authenticity is checked. A positive result must still be confirmed by accept().
+				 */
+				bool check(boost::uint64_t sequence) const;
+
+				/**
+				 * \brief Mark a sequence number as seen.
+				 * \param sequence The sequence number.
+				 * \return true if sequence was not seen yet and is not too old. If several threads accept the same sequence number concurrently, only one of them gets true.
+				 *
+				 * Only the sequence numbers of authenticated packets should be accepted, otherwise a forged packet could move the window forward.
+				 */
+				bool accept(boost::uint64_t sequence);
+
+			private:
+
+				bool is_too_old(boost::uint64_t sequence) const;
+
+				size_t m_size;
+				size_t m_words_count;
+				boost::scoped_array<boost::atomic<boost::uint64_t> > m_words;
+				boost::atomic<boost::uint64_t> m_highest;
+		};
+
+		/**
+		 * \brief A secure datagram channel class.
+		 *
+		 * channel seals and opens datagrams, as done by VPN-like protocols. A sealed datagram is made of a 8 bytes big-endian sequence number, the ciphertext (which has the same length than the plaintext) and an authentication tag.
+		 *
+		 * Two kinds of protection are supported:
+		 * - an AEAD algorithm (GCM, CCM, OCB or ChaCha20-Poly1305), which authenticates the sequence number as additional data;
+		 * - a counter mode algorithm followed by a HMAC over the sequence number and the ciphertext (encrypt-then-MAC).
+		 *
+		 * The nonce of each datagram is derived from the iv given on construction and the sequence number: for AEAD algorithms, the sequence number is xored into the last 8 bytes of the iv (as TLS 1.3 does); for counter mode algorithms, it is xored into the first 8 bytes, so that the counter blocks of two datagrams never overlap.
+		 *
+		 * The key schedules are computed once per context and contexts are kept in a lock-free pool: sealing or opening a datagram never allocates memory once the pool is warm. Both seal() and open() may be called concurrently from several threads.
+		 *
+		 * Each channel should only be used in one direction: a peer that both sends and receives needs two channels with two different keys.
+		 *
+		 * channel is noncopyable by design.
+		 */
+		class channel : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The open() results.
+				 */
+				enum open_result
+				{
+					opened, /**< \brief The datagram is authentic and was decrypted. */
+					malformed, /**< \brief The datagram is too short, or its plaintext does not fit in the output buffer. */
+					forged, /**< \brief The datagram is not authentic. */
+					replayed /**< \brief The datagram was already received or is too old. */
+				};
+
+				/**
+				 * \brief The size of the sequence number that starts every datagram.
+				 */
+				static const size_t header_size;
+
+				/**
+				 * \brief The default anti-replay window size.
+				 */
+				static const size_t default_window_size;
+
+				/**
+				 * \brief Create a new channel that uses an AEAD algorithm.
+				 * \param algorithm The AEAD cipher algorithm to use. If algorithm.is_aead() is false, a std::invalid_argument is thrown.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param iv The base iv, from which the nonce of each datagram is derived. Cannot be NULL.
+				 * \param iv_len The length of iv. Must be at least 8 bytes or a std::invalid_argument is thrown.
+				 * \param window_size The size of the anti-replay window.
+				 */
+				channel(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t window_size = default_window_size);
+
+				/**
+				 * \brief Create a new channel that uses a counter mode algorithm and a HMAC.
+				 * \param algorithm The counter mode cipher algorithm to use. If algorithm is not a counter mode algorithm, a std::invalid_argument is thrown.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param iv The base iv, from which the nonce of each datagram is derived. Cannot be NULL.
+				 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+				 * \param mac_algorithm The message digest algorithm to use for the HMAC.
+				 * \param mac_key The HMAC key. Must differ from key.
+				 * \param mac_key_len The length of mac_key.
+				 * \param window_size The size of the anti-replay window.
+				 */
+				channel(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, const hash::message_digest_algorithm& mac_algorithm, const void* mac_key, size_t mac_key_len, size_t window_size = default_window_size);
+
+				/**
+				 * \brief Destroy a channel.
+				 *
+				 * The keys are cleansed.
+				 */
+				~channel();
+
+				/**
+				 * \brief Get the cipher algorithm.
+				 * \return The cipher algorithm.
+				 */
+				cipher_algorithm algorithm() const;
+
+				/**
+				 * \brief Get the size of the authentication tag.
+				 * \return The size of the authentication tag.
+				 */
+				size_t tag_size() const;
+
+				/**
+				 * \brief Get the count of bytes a sealed datagram has in addition to its plaintext.
+				 * \return header_size + tag_size().
+				 */
+				size_t overhead() const;
+
+				/**
+				 * \brief Get the anti-replay window.
+				 * \return The anti-replay window.
+				 */
+				const replay_window& window() const;
+
+				/**
+				 * \brief Seal a datagram.
+				 * \param out The output buffer. Must be at least in_len + overhead() bytes long or a std::runtime_error is thrown. May overlap in.
+				 * \param out_len The length of out.
+				 * \param in The plaintext.
+				 * \param in_len The length of in.
+				 * \return The count of bytes written to out, which is in_len + overhead().
+				 *
+				 * Each call consumes one sequence number. Once every sequence number was used, a std::runtime_error is thrown: the channel must then be rekeyed.
+				 */
+				size_t seal(void* out, size_t out_len, const void* in, size_t in_len);
+
+				/**
+				 * \brief Open a datagram.
+				 * \param out The output buffer. May overlap in. If it is shorter than in_len - overhead() bytes, nothing is written to it and malformed is returned.
+				 * \param out_len The length of out.
+				 * \param in The sealed datagram.
+				 * \param in_len The length of in.
+				 * \param len A pointer to the variable that receives the count of bytes written to out. Cannot be NULL.
+				 * \return opened if the datagram was authentic and not replayed. On any other result, nothing is written to len and no unauthenticated plaintext is left in out.
+				 *
+				 * The sequence number is checked against the anti-replay window before the datagram is authenticated, so that replayed datagrams are dropped cheaply. It is only marked as seen once the datagram was authenticated.
+				 */
+				open_result open(void* out, size_t out_len, const void* in, size_t in_len, size_t* len);
+
+			private:
+
+				class state;
+				class state_guard;
+
+				state* acquire_state();
+				void release_state(state*);
+				boost::uint64_t next_sequence();
+				void get_nonce(unsigned char* nonce, boost::uint64_t sequence) const;
+
+				cipher_algorithm m_algorithm;
+				hash::message_digest_algorithm m_mac_algorithm;
+				std::vector<unsigned char> m_key;
+				std::vector<unsigned char> m_iv;
+				std::vector<unsigned char> m_mac_key;
+				size_t m_tag_size;
+				boost::atomic<boost::uint64_t> m_sequence;
+				replay_window m_window;
+				boost::mutex m_states_mutex;
+				std::vector<boost::shared_ptr<state> > m_states;
+				boost::lockfree::stack<state*> m_free_states;
+		};
+
+		inline size_t replay_window::size() const
+		{
+			return m_size;
+		}
+
+		inline boost::uint64_t replay_window::highest() const
+		{
+			return m_highest.load(boost::memory_order_relaxed);
+		}
+
+		inline cipher_algorithm channel::algorithm() const
+		{
+			return m_algorithm;
+		}
+
+		inline size_t channel::tag_size() const
+		{
+			return m_tag_size;
+		}
+
+		inline size_t channel::overhead() const
+		{
+			return header_size + m_tag_size;
+		}
+
+		inline const replay_window& channel::window() const
+		{
+			return m_window;
+		}
+	}
+}
+
+#endif
+
+#endif /* CRYPTOPLUS_CIPHER_CHANNEL_HPP */
@@ -0,0 +1,260 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file chunked_container.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A chunked, random-access authenticated encrypted container format.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_CHUNKED_CONTAINER_HPP
+#define CRYPTOPLUS_CIPHER_CHUNKED_CONTAINER_HPP
+
+#include "cipher_context.hpp"
+#include "../bio/bio_ptr.hpp"
+#include "../file.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+
+#include <vector>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief Write a chunked container.
+		 *
+		 * A chunked container is made of:
+		 * - A 24 bytes header: the magic "CPXC", a version byte, the tag length, two reserved bytes, the algorithm NID, the chunk size and a random 8 bytes nonce prefix. All integers are big-endian.
+		 * - The chunks: each chunk of plaintext (chunk size bytes, except for the last one) is sealed independently with an AEAD algorithm and stored as its ciphertext followed by its tag. The nonce of a chunk is the nonce prefix followed by the big-endian 32 bits index of the chunk. The additional authenticated data is the header followed by a byte that is 1 for the last chunk and 0 otherwise.
+		 * - The index: the 64 bits total plaintext length and the 32 bits chunk count, sealed like a chunk whose index is 0xffffffff and whose flag byte is 2.
+		 *
+		 * Since chunks have a fixed size, the position of any chunk is known and a chunked_reader can decrypt any range by touching only the chunks it spans. The index and the flags prevent truncation, extension and reordering.
+		 *
+		 * Chunks are buffered and sealed in parallel by batches.
+		 *
+		 * chunked_writer is noncopyable by design.
+		 */
+		class chunked_writer : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The default chunk size.
+				 */
+				static const size_t default_chunk_size;
+
+				/**
+				 * \brief The maximum chunk size.
+				 */
+				static const size_t maximum_chunk_size;
+
+				/**
+				 * \brief Create a chunked_writer that writes to a file.
+				 * \param _file The file to write to. The container is written from the current position.
+				 * \param algorithm The AEAD cipher algorithm to use. If algorithm.is_aead() is false, a std::invalid_argument is thrown.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param chunk_size The chunk size. Must be between 1 and maximum_chunk_size or a std::invalid_argument is thrown.
+				 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+				 *
+				 * The header is written immediately.
+				 */
+				chunked_writer(file _file, const cipher_algorithm& algorithm, const void* key, size_t key_len, size_t chunk_size = default_chunk_size, unsigned int threads_count = 0);
+
+				/**
+				 * \brief Create a chunked_writer that writes to a BIO.
+				 * \param bio The BIO to write to.
+				 * \param algorithm The AEAD cipher algorithm to use. If algorithm.is_aead() is false, a std::invalid_argument is thrown.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param chunk_size The chunk size. Must be between 1 and maximum_chunk_size or a std::invalid_argument is thrown.
+				 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+				 *
+				 * The header is written immediately.
+				 */
+				chunked_writer(bio::bio_ptr bio, const cipher_algorithm& algorithm, const void* key, size_t key_len, size_t chunk_size = default_chunk_size, unsigned int threads_count = 0);
+
+				/**
+				 * \brief Append data to the container.
+				 * \param buf The data.
+				 * \param buf_len The length of buf.
+				 */
+				void write(const void* buf, size_t buf_len);
+
+				/**
+				 * \brief Write the pending chunks and the index.
+				 *
+				 * The destruction of the chunked_writer does not finalize it: finalize() must be called explicitely once all the data was written, or the container will not be readable.
+				 */
+				void finalize();
+
+				/**
+				 * \brief Get the count of plaintext bytes written so far.
+				 * \return The count of plaintext bytes written so far.
+				 */
+				boost::uint64_t size() const;
+
+			private:
+
+				void initialize(const cipher_algorithm& algorithm, const void* key, size_t key_len, size_t chunk_size, unsigned int threads_count);
+				void flush(bool final);
+				void write_raw(const void* buf, size_t buf_len);
+
+				file m_file;
+				bio::bio_ptr m_bio;
+				std::vector<unsigned char> m_header;
+				std::vector<boost::shared_ptr<cipher_context> > m_contexts;
+				std::vector<unsigned char> m_batch;
+				size_t m_chunk_size;
+				unsigned int m_threads_count;
+				size_t m_pending;
+				boost::uint64_t m_chunks_count;
+				boost::uint64_t m_size;
+		};
+
+		/**
+		 * \brief Read a chunked container.
+		 *
+		 * The header and the index are read and authenticated on construction. read() then decrypts only the chunks that the requested range spans. The last decrypted chunk is kept, so that consecutive small reads do not decrypt it again.
+		 *
+		 * See chunked_writer for a description of the format.
+		 *
+		 * chunked_reader is noncopyable by design.
+		 */
+		class chunked_reader : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief Create a chunked_reader that reads from a file.
+				 * \param _file The file to read from. It must be seekable and the container must start at its beginning and end at its end.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match the key length of the container algorithm or a std::runtime_error is thrown.
+				 *
+				 * If the container is invalid or was tampered with, a std::runtime_error is thrown.
+				 */
+				chunked_reader(file _file, const void* key, size_t key_len);
+
+				/**
+				 * \brief Create a chunked_reader that reads from a BIO.
+				 * \param bio The BIO to read from. It must support seek() and the container must start at its beginning.
+				 * \param container_size The total size of the container, in bytes.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match the key length of the container algorithm or a std::runtime_error is thrown.
+				 *
+				 * If the container is invalid or was tampered with, a std::runtime_error is thrown.
+				 */
+				chunked_reader(bio::bio_ptr bio, boost::uint64_t container_size, const void* key, size_t key_len);
+
+				/**
+				 * \brief Get the algorithm of the container.
+				 * \return The algorithm.
+				 */
+				cipher_algorithm algorithm() const;
+
+				/**
+				 * \brief Get the chunk size of the container.
+				 * \return The chunk size.
+				 */
+				size_t chunk_size() const;
+
+				/**
+				 * \brief Get the plaintext size of the container.
+				 * \return The plaintext size.
+				 */
+				boost::uint64_t size() const;
+
+				/**
+				 * \brief Read and decrypt a range of the container.
+				 * \param offset The plaintext offset to read from.
+				 * \param buf The output buffer.
+				 * \param buf_len The length of buf.
+				 * \return The count of bytes read. It is lower than buf_len only if the end of the container was reached.
+				 *
+				 * If a chunk fails to authenticate, a std::runtime_error is thrown.
+				 */
+				size_t read(boost::uint64_t offset, void* buf, size_t buf_len);
+
+			private:
+
+				void initialize(boost::uint64_t container_size, const void* key, size_t key_len);
+				void read_raw(boost::uint64_t offset, void* buf, size_t buf_len);
+				void load_chunk(boost::uint64_t index);
+
+				file m_file;
+				bio::bio_ptr m_bio;
+				std::vector<unsigned char> m_header;
+				cipher_context m_context;
+				std::vector<unsigned char> m_chunk;
+				size_t m_chunk_size;
+				boost::uint64_t m_chunks_count;
+				boost::uint64_t m_size;
+				boost::uint64_t m_loaded_chunk;
+		};
+
+		inline boost::uint64_t chunked_writer::size() const
+		{
+			return m_size;
+		}
+
+		inline cipher_algorithm chunked_reader::algorithm() const
+		{
+			return m_context.algorithm();
+		}
+
+		inline size_t chunked_reader::chunk_size() const
+		{
+			return m_chunk_size;
+		}
+
+		inline boost::uint64_t chunked_reader::size() const
+		{
+			return m_size;
+		}
+	}
+}
+
+#endif
+
+#endif /* CRYPTOPLUS_CIPHER_CHUNKED_CONTAINER_HPP */
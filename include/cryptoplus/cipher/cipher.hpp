@@ -0,0 +1,158 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Cipher helper functions.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_CIPHER_HPP
+#define CRYPTOPLUS_CIPHER_CIPHER_HPP
+
+#include "cipher_algorithm.hpp"
+
+#include <openssl/evp.h>
+
+#include <vector>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief Encrypt a buffer in one call.
+		 * \param out The output buffer. Must be at least in_len + algorithm.block_size() bytes long.
+		 * \param out_len The output buffer length.
+		 * \param in The buffer to encrypt.
+		 * \param in_len The buffer length.
+		 * \param algorithm The cipher algorithm to use. If algorithm is an AEAD algorithm, a std::invalid_argument is thrown: use cipher_context::aead_encrypt() instead.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv to use (if one is needed for the specified algorithm, NULL otherwise).
+		 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+		 * \param impl The engine to use. The NULL default value indicate that no engine should be used.
+		 * \return The count of bytes written to out.
+		 *
+		 * PKCS padding is enabled. The cipher_context is taken from a per-thread pool that holds one context per algorithm and engine: after the first call on a thread, no context is created or destroyed and the context memory is reused, only the key and the iv are set.
+		 *
+		 * \warning As a consequence, the key schedule of the last key used with each algorithm stays in memory until the thread exits. Call clear_context_pool() to wipe it sooner.
+		 * \see clear_context_pool
+		 */
+		size_t encrypt(void* out, size_t out_len, const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl = NULL);
+
+		/**
+		 * \brief Encrypt a buffer in one call.
+		 * \param in The buffer to encrypt.
+		 * \param in_len The buffer length.
+		 * \param algorithm The cipher algorithm to use.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv to use (if one is needed for the specified algorithm, NULL otherwise).
+		 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+		 * \param impl The engine to use. The NULL default value indicate that no engine should be used.
+		 * \return The encrypted buffer.
+		 * \see encrypt(void*, size_t, const void*, size_t, const cipher_algorithm&, const void*, size_t, const void*, size_t, ENGINE*)
+		 */
+		template <typename T>
+		std::vector<T> encrypt(const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl = NULL);
+
+		/**
+		 * \brief Decrypt a buffer in one call.
+		 * \param out The output buffer. Must be at least in_len + algorithm.block_size() bytes long.
+		 * \param out_len The output buffer length.
+		 * \param in The buffer to decrypt.
+		 * \param in_len The buffer length.
+		 * \param algorithm The cipher algorithm to use. If algorithm is an AEAD algorithm, a std::invalid_argument is thrown: use cipher_context::aead_decrypt() instead.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv to use (if one is needed for the specified algorithm, NULL otherwise).
+		 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+		 * \param impl The engine to use. The NULL default value indicate that no engine should be used.
+		 * \return The count of bytes written to out.
+		 *
+		 * The contexts are pooled as in encrypt(). If the padding is wrong, a cryptographic_exception is thrown.
+		 */
+		size_t decrypt(void* out, size_t out_len, const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl = NULL);
+
+		/**
+		 * \brief Decrypt a buffer in one call.
+		 * \param in The buffer to decrypt.
+		 * \param in_len The buffer length.
+		 * \param algorithm The cipher algorithm to use.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv to use (if one is needed for the specified algorithm, NULL otherwise).
+		 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+		 * \param impl The engine to use. The NULL default value indicate that no engine should be used.
+		 * \return The decrypted buffer.
+		 * \see decrypt(void*, size_t, const void*, size_t, const cipher_algorithm&, const void*, size_t, const void*, size_t, ENGINE*)
+		 */
+		template <typename T>
+		std::vector<T> decrypt(const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl = NULL);
+
+		/**
+		 * \brief Free the cipher contexts pooled for the calling thread by encrypt() and decrypt().
+		 *
+		 * The key schedules they hold are cleansed. The next encrypt() or decrypt() call on the thread creates a new context. The pools of the other threads are left untouched.
+		 */
+		void clear_context_pool();
+
+		template <typename T>
+		inline std::vector<T> encrypt(const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl)
+		{
+			std::vector<T> result(in_len + algorithm.block_size());
+
+			result.resize(encrypt(&result[0], result.size(), in, in_len, algorithm, key, key_len, iv, iv_len, impl));
+
+			return result;
+		}
+
+		template <typename T>
+		inline std::vector<T> decrypt(const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl)
+		{
+			std::vector<T> result(in_len + algorithm.block_size());
+
+			result.resize(decrypt(&result[0], result.size(), in, in_len, algorithm, key, key_len, iv, iv_len, impl));
+
+			return result;
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_CIPHER_CIPHER_HPP */
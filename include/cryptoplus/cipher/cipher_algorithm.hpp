@@ -73,6 +73,8 @@ namespace cryptoplus
 				/**
 				 * \brief Create a new cipher_algorithm from a const EVP_CIPHER pointer.
 				 * \param cipher The raw const EVP_CIPHER pointer. If cipher is NULL, the behavior is undefined.
+				 *
+				 * Since OpenSSL 3, a legacy EVP_CIPHER (as returned by EVP_aes_256_cbc() for instance) is fetched from the providers on every context initialization that uses it. To avoid that, the algorithm is fetched once from the default library context and the fetched handle is cached for the lifetime of the process: raw() then returns the fetched handle. If the algorithm cannot be fetched, cipher is kept as is.
 				 */
 				cipher_algorithm(const EVP_CIPHER* cipher);
 
@@ -138,15 +140,25 @@ namespace cryptoplus
 				 */
 				unsigned long mode() const;
 
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+				/**
+				 * \brief Check if the cipher_algorithm is an AEAD (authenticated encryption with associated data) algorithm.
+				 * \return true if the cipher_algorithm is an AEAD algorithm, such as GCM, CCM or ChaCha20-Poly1305.
+				 */
+				bool is_aead() const;
+#endif
+
 			private:
 
 				const EVP_CIPHER* m_cipher;
 		};
 
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
 		inline cipher_algorithm::cipher_algorithm(const EVP_CIPHER* cipher) :
 			m_cipher(cipher)
 		{
 		}
+#endif
 
 		inline const EVP_CIPHER* cipher_algorithm::raw() const
 		{
@@ -187,6 +199,13 @@ namespace cryptoplus
 		{
 			return EVP_CIPHER_mode(m_cipher);
 		}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+		inline bool cipher_algorithm::is_aead() const
+		{
+			return (flags() & EVP_CIPH_FLAG_AEAD_CIPHER) != 0;
+		}
+#endif
 	}
 }
 
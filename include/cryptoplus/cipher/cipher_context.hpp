@@ -46,6 +46,7 @@
 #define CRYPTOPLUS_CIPHER_CIPHER_CONTEXT_HPP
 
 #include "../error/cryptographic_exception.hpp"
+#include "../buffer.hpp"
 #include "cipher_algorithm.hpp"
 
 #include <openssl/evp.h>
@@ -53,6 +54,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <vector>
+#include <iterator>
 #include <cstring>
 
 namespace cryptoplus
@@ -64,6 +66,8 @@ namespace cryptoplus
 
 	namespace cipher
 	{
+		class nonce_generator;
+
 		/**
 		 * \brief A cipher context class.
 		 *
@@ -87,6 +91,20 @@ namespace cryptoplus
 					encrypt = 1 /**< \brief Specifies an encryption cipher context. */
 				};
 
+				/**
+				 * \brief A packet descriptor.
+				 * \see process_packets
+				 */
+				struct packet
+				{
+					const void* iv; /**< \brief The iv to use for this packet. Must be algorithm().iv_length() bytes long. */
+					const void* in; /**< \brief The input buffer. */
+					size_t in_len; /**< \brief The length of the in buffer. */
+					void* out; /**< \brief The output buffer. Should be at least in_len + algorithm().block_size() bytes long. Cannot be NULL. */
+					size_t out_len; /**< \brief The length of the out buffer. */
+					size_t result_len; /**< \brief The count of bytes written to out. Set by process_packets(). */
+				};
+
 				/**
 				 * \brief Create a new cipher_context.
 				 */
@@ -95,7 +113,7 @@ namespace cryptoplus
 				/**
 				 * \brief Destroy a cipher_context.
 				 *
-				 * Calls EVP_CIPHER_CTX_cleanup() on the internal EVP_CIPHER_CTX.
+				 * Calls EVP_CIPHER_CTX_free() on the internal EVP_CIPHER_CTX.
 				 */
 				~cipher_context();
 
@@ -116,6 +134,54 @@ namespace cryptoplus
 				 */
 				void initialize(const cipher_algorithm& algorithm, cipher_direction direction, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl = NULL);
 
+				/**
+				 * \brief Initialize the cipher_context from a cipher algorithm tag.
+				 * \param tag The cipher algorithm tag (for instance: aes_256_cbc()). See algorithm_tags.hpp.
+				 * \param direction The direction of the cipher_context. If a previous call to initialize() was done, you may specify cipher_direction::unchanged to keep the same direction value.
+				 * \param key The key to use. Its size is fixed by the tag, so no runtime check is done.
+				 * \param iv The iv to use. Its size is fixed by the tag, so no runtime check is done.
+				 * \param impl The engine to use. Default is NULL which indicates that no engine should be used.
+				 *
+				 * The EVP_CIPHER is taken directly from the tag: no lookup by name takes place.
+				 */
+				template <typename Algorithm>
+				void initialize(Algorithm tag, cipher_direction direction, const typename Algorithm::key_type& key, const typename Algorithm::iv_type& iv, ENGINE* impl = NULL);
+
+				/**
+				 * \brief Reset the cipher_context with a new iv, keeping the current key.
+				 * \param iv The iv to use.
+				 * \param iv_len The length of iv. Must match algorithm().iv_length() or a std::runtime_error is thrown.
+				 *
+				 * initialize() must have been called first. The key schedule computed by initialize() is reused, which makes this call much cheaper than a new call to initialize().
+				 */
+				void set_iv(const void* iv, size_t iv_len);
+
+				/**
+				 * \brief Initialize the cipher_context with an iv taken from a nonce generator.
+				 * \param algorithm The AEAD cipher algorithm to use. If algorithm.is_aead() is false, a std::invalid_argument is thrown.
+				 * \param direction The direction of the cipher_context.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param generator The nonce generator. Its nonce_size() must match algorithm.iv_length() or a std::invalid_argument is thrown.
+				 * \param iv The buffer that receives the generated iv, so that it can be sent along with the ciphertext. Cannot be NULL.
+				 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+				 * \param impl The engine to use. Default is NULL which indicates that no engine should be used.
+				 *
+				 * If generator cannot generate any more nonces, a nonce_exhausted_error is thrown.
+				 */
+				void initialize(const cipher_algorithm& algorithm, cipher_direction direction, const void* key, size_t key_len, nonce_generator& generator, void* iv, size_t iv_len, ENGINE* impl = NULL);
+
+				/**
+				 * \brief Reset the cipher_context with a new iv taken from a nonce generator, keeping the current key.
+				 * \param generator The nonce generator. Its nonce_size() must match algorithm().iv_length() or a std::invalid_argument is thrown.
+				 * \param iv The buffer that receives the generated iv, so that it can be sent along with the ciphertext. Cannot be NULL.
+				 * \param iv_len The length of iv. Must match algorithm().iv_length() or a std::runtime_error is thrown.
+				 * \see set_iv(const void*, size_t)
+				 *
+				 * algorithm() must be an AEAD algorithm or a std::invalid_argument is thrown. If generator cannot generate any more nonces, a nonce_exhausted_error is thrown.
+				 */
+				void set_iv(nonce_generator& generator, void* iv, size_t iv_len);
+
 				/**
 				 * \brief Initialize the cipher_context for envelope sealing.
 				 * \param algorithm The cipher algorithm to use.
@@ -142,6 +208,35 @@ namespace cryptoplus
 				 */
 				std::vector<unsigned char> seal_initialize(const cipher_algorithm& algorithm, void* iv, size_t iv_len, pkey::pkey pkey);
 
+				/**
+				 * \brief Get the size of the arena needed to seal an envelope for several recipients.
+				 * \param pkeys The public pkeys of the recipients.
+				 * \param pkeys_count The count of pkeys.
+				 * \return The size of the arena.
+				 * \see seal_initialize
+				 *
+				 * get_seal_arena_size(pkeys, i) is also the offset of the i-th encrypted key within the arena.
+				 */
+				static size_t get_seal_arena_size(const pkey::pkey* pkeys, size_t pkeys_count);
+
+				/**
+				 * \brief Initialize the cipher_context for envelope sealing, writing the encrypted keys to a caller-provided arena.
+				 * \param algorithm The cipher algorithm to use.
+				 * \param iv The iv that was generated (if one is needed for the specified algorithm, NULL otherwise).
+				 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+				 * \param pkeys The public pkeys of the recipients.
+				 * \param pkeys_count The count of pkeys.
+				 * \param arena The buffer that receives the encrypted shared secret keys. The key of the i-th recipient is written at offset get_seal_arena_size(pkeys, i).
+				 * \param arena_len The length of arena. Must be at least get_seal_arena_size(pkeys, pkeys_count) or a std::runtime_error is thrown.
+				 * \param ek_len An array of pkeys_count elements that receives the length of each encrypted shared secret key.
+				 * \param threads_count The maximum count of threads to use to encrypt the shared secret key. If 0, default_threads_count() is used.
+				 * \see seal_update
+				 * \see seal_finalize
+				 *
+				 * The result is equivalent to the one of the other seal_initialize() overloads, but no memory is allocated per recipient and the public key operations are spread over several threads.
+				 */
+				void seal_initialize(const cipher_algorithm& algorithm, void* iv, size_t iv_len, const pkey::pkey* pkeys, size_t pkeys_count, void* arena, size_t arena_len, size_t* ek_len, unsigned int threads_count = 0);
+
 				/**
 				 * \brief Initialize the cipher_context for envelope opening.
 				 * \param algorithm The cipher algorithm to use.
@@ -155,6 +250,71 @@ namespace cryptoplus
 				 */
 				void open_initialize(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, pkey::pkey pkey);
 
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+				/**
+				 * \brief Initialize the cipher_context for AEAD operations.
+				 * \param algorithm The AEAD cipher algorithm to use (GCM, CCM, OCB or ChaCha20-Poly1305). If algorithm.is_aead() is false, a std::invalid_argument is thrown.
+				 * \param direction The direction of the cipher_context: encrypt for aead_encrypt(), decrypt for aead_decrypt().
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param iv_len The length of the ivs that will be given to aead_encrypt() and aead_decrypt().
+				 * \param tag_len The length of the tags that will be given to aead_encrypt() and aead_decrypt(). CCM and OCB modes need to know it before the key is set.
+				 * \param impl The engine to use. Default is NULL which indicates that no engine should be used.
+				 * \see aead_encrypt
+				 * \see aead_decrypt
+				 *
+				 * Once initialized, the cipher_context can be used for any number of aead_encrypt() (or aead_decrypt(), depending on direction) calls: the key is only set once.
+				 */
+				void aead_initialize(const cipher_algorithm& algorithm, cipher_direction direction, const void* key, size_t key_len, size_t iv_len, size_t tag_len, ENGINE* impl = NULL);
+
+				/**
+				 * \brief Encrypt and authenticate a buffer in place.
+				 * \param buf The buffer to encrypt. Its content is replaced by the ciphertext, which has the same length.
+				 * \param buf_len The length of buf.
+				 * \param iv The iv to use. Must be unique for a given key. Cannot be NULL.
+				 * \param iv_len The length of iv. Must match the iv_len given to aead_initialize() or a std::runtime_error is thrown.
+				 * \param aad The additional authenticated data. Can be NULL if aad_len is 0.
+				 * \param aad_len The length of aad.
+				 * \param tag The buffer that receives the authentication tag. Cannot be NULL.
+				 * \param tag_len The length of tag. Must match the tag_len given to aead_initialize() or a std::runtime_error is thrown.
+				 *
+				 * aead_initialize() must have been called first, with the encrypt direction. No memory is allocated.
+				 */
+				void aead_encrypt(void* buf, size_t buf_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* tag, size_t tag_len);
+
+				/**
+				 * \brief Encrypt and authenticate a buffer in place, with an iv taken from a nonce generator.
+				 * \param buf The buffer to encrypt. Its content is replaced by the ciphertext, which has the same length.
+				 * \param buf_len The length of buf.
+				 * \param generator The nonce generator. Its nonce_size() must match iv_len or a std::invalid_argument is thrown.
+				 * \param iv The buffer that receives the generated iv, so that it can be sent along with the ciphertext. Cannot be NULL.
+				 * \param iv_len The length of iv. Must match the iv_len given to aead_initialize() or a std::runtime_error is thrown.
+				 * \param aad The additional authenticated data. Can be NULL if aad_len is 0.
+				 * \param aad_len The length of aad.
+				 * \param tag The buffer that receives the authentication tag. Cannot be NULL.
+				 * \param tag_len The length of tag. Must match the tag_len given to aead_initialize() or a std::runtime_error is thrown.
+				 *
+				 * If generator cannot generate any more nonces, a nonce_exhausted_error is thrown and buf is left untouched.
+				 */
+				void aead_encrypt(void* buf, size_t buf_len, nonce_generator& generator, void* iv, size_t iv_len, const void* aad, size_t aad_len, void* tag, size_t tag_len);
+
+				/**
+				 * \brief Check the authenticity of a buffer and decrypt it in place.
+				 * \param buf The buffer to decrypt. Its content is replaced by the plaintext, which has the same length.
+				 * \param buf_len The length of buf.
+				 * \param iv The iv that was used to encrypt buf. Cannot be NULL.
+				 * \param iv_len The length of iv. Must match the iv_len given to aead_initialize() or a std::runtime_error is thrown.
+				 * \param aad The additional authenticated data. Can be NULL if aad_len is 0.
+				 * \param aad_len The length of aad.
+				 * \param tag The authentication tag. Cannot be NULL.
+				 * \param tag_len The length of tag. Must match the tag_len given to aead_initialize() or a std::runtime_error is thrown.
+				 * \return true if the tag matches. If the tag does not match, false is returned and buf is zeroed so that no unauthenticated plaintext is ever exposed.
+				 *
+				 * aead_initialize() must have been called first, with the decrypt direction. No memory is allocated.
+				 */
+				bool aead_decrypt(void* buf, size_t buf_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, const void* tag, size_t tag_len);
+#endif
+
 				/**
 				 * \brief Set PKCS padding state.
 				 * \param enabled If enabled is true, PKCS padding will be enabled.
@@ -239,6 +399,32 @@ namespace cryptoplus
 				 */
 				size_t update(void* out, size_t out_len, const void* in, size_t in_len);
 
+				/**
+				 * \brief Update the cipher_context with some scattered data.
+				 * \param out The output buffers. They are filled in order. Their total size should be at least the total size of in plus algorithm().block_size(), or a std::logic_error is thrown.
+				 * \param out_count The count of output buffers.
+				 * \param in The input buffers. They are processed in order, as if they were contiguous.
+				 * \param in_count The count of input buffers.
+				 * \return The count of bytes written, across all the output buffers.
+				 *
+				 * Input and output fragments need not be aligned on block boundaries nor have the same layout: partial blocks are carried across fragment boundaries by the cipher_context itself. The data is never linearized: only the few bytes that would straddle two output fragments go through a small internal buffer.
+				 */
+				size_t update(const mutable_buffer* out, size_t out_count, const const_buffer* in, size_t in_count);
+
+				/**
+				 * \brief Update the cipher_context with some data, in place.
+				 * \param buf The buffer to cipher. On return, it contains exactly buf_len ciphered bytes.
+				 * \param buf_len The length of buf.
+				 *
+				 * In-place ciphering is only possible when the cipher_context outputs exactly as many bytes as it gets:
+				 * - for algorithms with a block size of 1 (stream ciphers, CTR, OFB, CFB, GCM, ChaCha20 and ChaCha20-Poly1305), any length is accepted;
+				 * - XTS and CCM also have a block size of 1, but keep their own limits: with XTS, each call ciphers a whole data unit of at least 16 bytes; with CCM, the total length must have been given first and only one call can be made;
+				 * - for block algorithms (for instance, CBC or ECB), padding must be disabled (see set_padding()) and buf_len must be a multiple of algorithm().block_size().
+				 *
+				 * In any other case (including key wrapping modes), a std::logic_error is thrown and buf is left untouched.
+				 */
+				void update_in_place(void* buf, size_t buf_len);
+
 				/**
 				 * \brief Update the cipher_context with some data.
 				 * \param out The output buffer. Should be at least in_len + algorithm().block_size() bytes long. Cannot be NULL.
@@ -259,6 +445,18 @@ namespace cryptoplus
 				 */
 				size_t open_update(void* out, size_t out_len, const void* in, size_t in_len);
 
+				/**
+				 * \brief Cipher a batch of independent packets, each with its own iv.
+				 * \param packets The packets to process. The result_len member of each packet is set to the count of bytes written to its out buffer.
+				 * \param packets_count The count of packets.
+				 * \see packet
+				 *
+				 * initialize() must have been called first to set the algorithm, the direction and the key. Each packet is then processed as if initialize(), update() and finalize() had been called on it, but the key schedule is computed only once for the whole batch.
+				 *
+				 * The current padding setting applies to every packet.
+				 */
+				void process_packets(packet* packets, size_t packets_count);
+
 				/**
 				 * \brief Finalize the cipher_context and get the resulting buffer.
 				 * \param out The output buffer. Should be at least algorithm().block_size() bytes long. Cannot be NULL.
@@ -269,6 +467,16 @@ namespace cryptoplus
 				 */
 				size_t finalize(void* out, size_t out_len);
 
+				/**
+				 * \brief Finalize the cipher_context and scatter the resulting buffer.
+				 * \param out The output buffers. They are filled in order. Their total size should be at least algorithm().block_size(), or a std::logic_error is thrown.
+				 * \param out_count The count of output buffers.
+				 * \return The count of bytes written, across all the output buffers.
+				 *
+				 * After a call to finalize() no more call to update() can be made unless initialize() is called again first.
+				 */
+				size_t finalize(const mutable_buffer* out, size_t out_count);
+
 				/**
 				 * \brief Finalize the cipher_context and get the resulting buffer.
 				 * \param out The output buffer. Should be at least algorithm().block_size() bytes long. Cannot be NULL.
@@ -289,6 +497,16 @@ namespace cryptoplus
 				 */
 				size_t open_finalize(void* out, size_t out_len);
 
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+				/**
+				 * \brief Copy an existing cipher_context, including its current state.
+				 * \param ctx A cipher_context to copy.
+				 *
+				 * The key schedule is copied as well: this is much cheaper than calling initialize() with the same key. Use set_iv() afterwards to start a new message.
+				 */
+				void copy(const cipher_context& ctx);
+#endif
+
 				/**
 				 * \brief Get the underlying context.
 				 * \return The underlying context.
@@ -304,75 +522,62 @@ namespace cryptoplus
 
 			private:
 
-				EVP_CIPHER_CTX m_ctx;
+				EVP_CIPHER_CTX* m_ctx;
+				size_t m_aead_iv_len;
+				size_t m_aead_tag_len;
 		};
 
-		inline cipher_context::cipher_context()
+		inline cipher_context::cipher_context() :
+			m_ctx(EVP_CIPHER_CTX_new()),
+			m_aead_iv_len(0),
+			m_aead_tag_len(0)
 		{
-			EVP_CIPHER_CTX_init(&m_ctx);
+			error::throw_error_if_not(m_ctx != NULL);
 		}
 
 		inline cipher_context::~cipher_context()
 		{
-			EVP_CIPHER_CTX_cleanup(&m_ctx);
+			EVP_CIPHER_CTX_free(m_ctx);
 		}
 
 		template <typename T>
 		inline std::vector<std::vector<unsigned char> > cipher_context::seal_initialize(const cipher_algorithm& _algorithm, void* iv, size_t iv_len, T pkeys_begin, T pkeys_end)
 		{
-			if (iv && (iv_len != _algorithm.iv_length()))
-			{
-				throw std::runtime_error("iv_len");
-			}
-
-			size_t pkeys_count = std::distance(pkeys_begin, pkeys_end);
+			// pkey::pkey is incomplete here: we rely on T to get a dependent type.
+			typedef typename std::iterator_traits<T>::value_type pkey_type;
 
-			std::vector<std::vector<unsigned char> > result;
-			std::vector<unsigned char*> ek;
-			std::vector<int> ekl(pkeys_count);
-			std::vector<EVP_PKEY*> pubk;
+			const std::vector<pkey_type> pkeys(pkeys_begin, pkeys_end);
+			const size_t pkeys_count = pkeys.size();
 
-			ek.reserve(pkeys_count);
-			pubk.reserve(pkeys_count);
-			result.reserve(pkeys_count);
-
-			try
-			{
-				for (T pkey = pkeys_begin; pkey != pkeys_end; ++pkey)
-				{
-					ek.push_back(new unsigned char[pkey->size()]);
-					pubk.push_back(pkey->raw());
-				}
+			std::vector<unsigned char> arena(get_seal_arena_size(pkeys.empty() ? NULL : &pkeys[0], pkeys_count));
+			std::vector<size_t> ek_len(pkeys_count);
 
-				error::throw_error_if_not(EVP_SealInit(&m_ctx, _algorithm.raw(), &ek[0], &ekl[0], static_cast<unsigned char*>(iv), &pubk[0], static_cast<int>(pkeys_count)) != 0);
+			seal_initialize(_algorithm, iv, iv_len, pkeys.empty() ? NULL : &pkeys[0], pkeys_count, arena.empty() ? NULL : &arena[0], arena.size(), ek_len.empty() ? NULL : &ek_len[0], 1);
 
-				for (std::vector<unsigned char*>::iterator p = ek.begin(); p != ek.end(); ++p)
-				{
-					result.push_back(std::vector<unsigned char>(*p, *p + ekl[std::distance(ek.begin(), p)]));
-				}
-			}
-			catch (...)
-			{
-				for (std::vector<unsigned char*>::iterator p = ek.begin(); p != ek.end(); ++p)
-				{
-					delete[] *p;
-				}
+			std::vector<std::vector<unsigned char> > result;
+			result.reserve(pkeys_count);
 
-				throw;
-			}
+			size_t offset = 0;
 
-			for (std::vector<unsigned char*>::iterator p = ek.begin(); p != ek.end(); ++p)
+			for (size_t i = 0; i < pkeys_count; ++i)
 			{
-				delete[] *p;
+				result.push_back(std::vector<unsigned char>(arena.begin() + offset, arena.begin() + offset + ek_len[i]));
+				offset += pkeys[i].size();
 			}
 
 			return result;
 		}
 
+		template <typename Algorithm>
+		inline void cipher_context::initialize(Algorithm, cipher_direction direction, const typename Algorithm::key_type& key, const typename Algorithm::iv_type& iv, ENGINE* impl)
+		{
+			error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, cipher_algorithm(Algorithm::raw()).raw(), impl, key.data(), (Algorithm::iv_length > 0) ? iv.data() : NULL, static_cast<int>(direction)) != 0);
+		}
+
 		inline void cipher_context::set_padding(bool enabled)
 		{
 			// The call always returns 1 so testing its return value is useless.
-			EVP_CIPHER_CTX_set_padding(&m_ctx, static_cast<int>(enabled));
+			EVP_CIPHER_CTX_set_padding(m_ctx, static_cast<int>(enabled));
 		}
 
 		inline size_t cipher_context::get_iso_10126_padding_size(size_t len) const
@@ -392,33 +597,40 @@ namespace cryptoplus
 
 		inline size_t cipher_context::key_length() const
 		{
-			return EVP_CIPHER_CTX_key_length(&m_ctx);
+			return EVP_CIPHER_CTX_key_length(m_ctx);
 		}
 
 		inline void cipher_context::set_key_length(size_t len)
 		{
-			error::throw_error_if_not(EVP_CIPHER_CTX_set_key_length(&m_ctx, static_cast<int>(len)) != 0);
+			error::throw_error_if_not(EVP_CIPHER_CTX_set_key_length(m_ctx, static_cast<int>(len)) != 0);
 		}
 
 		template <typename T>
 		inline void cipher_context::ctrl_get(int type, T& value)
 		{
-			error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(&m_ctx, type, 0, &value) != 0);
+			error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(m_ctx, type, 0, &value) != 0);
 		}
 
 		inline void cipher_context::ctrl_set(int type, int value)
 		{
-			error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(&m_ctx, type, value, NULL) != 0);
+			error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(m_ctx, type, value, NULL) != 0);
+		}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+		inline void cipher_context::copy(const cipher_context& ctx)
+		{
+			error::throw_error_if_not(EVP_CIPHER_CTX_copy(m_ctx, ctx.m_ctx) != 0);
 		}
+#endif
 
 		inline EVP_CIPHER_CTX& cipher_context::raw()
 		{
-			return m_ctx;
+			return *m_ctx;
 		}
 
 		inline cipher_algorithm cipher_context::algorithm() const
 		{
-			return cipher_algorithm(EVP_CIPHER_CTX_cipher(&m_ctx));
+			return cipher_algorithm(EVP_CIPHER_CTX_cipher(m_ctx));
 		}
 	}
 }
@@ -0,0 +1,204 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher_context_cache.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A keyed cipher context cache class.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_CIPHER_CONTEXT_CACHE_HPP
+#define CRYPTOPLUS_CIPHER_CIPHER_CONTEXT_CACHE_HPP
+
+#include "cipher_context.hpp"
+
+#include <openssl/opensslv.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief A keyed cipher context cache class.
+		 *
+		 * The cipher_context_cache class holds a bounded number of already keyed cipher contexts, indexed by a key identifier and a direction.
+		 *
+		 * Initializing a cipher_context with a key computes the key schedule, which is costly compared to the ciphering of a small message. When the same long-lived keys are used over and over again (for instance, one key per tenant), the keyed contexts can be stored in a cipher_context_cache once and then cloned with get(), which only copies the key schedule and sets a new iv.
+		 *
+		 * When the cache is full, the least recently used entry is evicted. The memory used by the cache is bounded by capacity() times the size of a keyed cipher_context.
+		 *
+		 * All methods are thread-safe. cipher_context_cache is noncopyable by design.
+		 */
+		class cipher_context_cache : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief Create a new cipher_context_cache.
+				 * \param capacity The maximum number of keyed contexts to hold. Cannot be 0.
+				 */
+				explicit cipher_context_cache(size_t capacity);
+
+				/**
+				 * \brief Add a keyed context to the cache.
+				 * \param key_id The key identifier.
+				 * \param algorithm The cipher algorithm to use.
+				 * \param direction The direction of the context. Cannot be cipher_context::unchanged.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param impl The engine to use. Default is NULL which indicates that no engine should be used.
+				 *
+				 * If an entry already exists for key_id and direction, it is replaced. If the cache is full, the least recently used entry is evicted.
+				 */
+				void insert(const std::string& key_id, const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, const void* key, size_t key_len, ENGINE* impl = NULL);
+
+				/**
+				 * \brief Get a keyed context from the cache.
+				 * \param key_id The key identifier.
+				 * \param direction The direction of the context.
+				 * \param ctx The cipher_context to initialize with a copy of the cached keyed context.
+				 * \param iv The iv to use (if one is needed for the algorithm, NULL otherwise).
+				 * \param iv_len The length of iv. Must match the algorithm iv length or a std::runtime_error is thrown.
+				 * \return true on a cache hit, in which case ctx is ready to use. On a cache miss, false is returned and ctx is left untouched: call insert() then get() again.
+				 */
+				bool get(const std::string& key_id, cipher_context::cipher_direction direction, cipher_context& ctx, const void* iv, size_t iv_len);
+
+				/**
+				 * \brief Remove an entry from the cache.
+				 * \param key_id The key identifier.
+				 * \param direction The direction of the context.
+				 * \return true if an entry was removed.
+				 */
+				bool erase(const std::string& key_id, cipher_context::cipher_direction direction);
+
+				/**
+				 * \brief Remove all the entries from the cache.
+				 *
+				 * The hit and miss counters are left untouched.
+				 */
+				void clear();
+
+				/**
+				 * \brief Get the count of entries in the cache.
+				 * \return The count of entries.
+				 */
+				size_t size() const;
+
+				/**
+				 * \brief Get the maximum count of entries in the cache.
+				 * \return The capacity.
+				 */
+				size_t capacity() const;
+
+				/**
+				 * \brief Get the count of cache hits.
+				 * \return The count of calls to get() that returned true.
+				 */
+				unsigned long hits() const;
+
+				/**
+				 * \brief Get the count of cache misses.
+				 * \return The count of calls to get() that returned false.
+				 */
+				unsigned long misses() const;
+
+				/**
+				 * \brief Get the count of evictions.
+				 * \return The count of entries that were evicted to make room for new ones.
+				 */
+				unsigned long evictions() const;
+
+				/**
+				 * \brief Reset the hit, miss and eviction counters.
+				 */
+				void reset_statistics();
+
+			private:
+
+				typedef std::pair<std::string, cipher_context::cipher_direction> index_type;
+
+				struct entry_type
+				{
+					index_type index;
+					boost::shared_ptr<cipher_context> ctx;
+				};
+
+				typedef std::list<entry_type> entry_list;
+				typedef std::map<index_type, entry_list::iterator> entry_map;
+
+				mutable boost::mutex m_mutex;
+				const size_t m_capacity;
+				entry_list m_entries;
+				entry_map m_index;
+				unsigned long m_hits;
+				unsigned long m_misses;
+				unsigned long m_evictions;
+		};
+
+		inline cipher_context_cache::cipher_context_cache(size_t _capacity) :
+			m_capacity(_capacity),
+			m_hits(0),
+			m_misses(0),
+			m_evictions(0)
+		{
+			if (m_capacity == 0)
+			{
+				throw std::invalid_argument("capacity");
+			}
+		}
+
+		inline size_t cipher_context_cache::capacity() const
+		{
+			return m_capacity;
+		}
+	}
+}
+
+#endif
+
+#endif /* CRYPTOPLUS_CIPHER_CIPHER_CONTEXT_CACHE_HPP */
@@ -0,0 +1,100 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher_selection.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Runtime cipher algorithm selection functions.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_CIPHER_SELECTION_HPP
+#define CRYPTOPLUS_CIPHER_CIPHER_SELECTION_HPP
+
+#include "cipher_algorithm.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief Select the fastest cipher algorithm on the current host.
+		 * \param candidates The candidate algorithms. Cannot be NULL if candidates_count is not 0.
+		 * \param candidates_count The count of candidates.
+		 * \param typical_size The typical size of the messages that will be ciphered. Cannot be 0 or a std::invalid_argument is thrown.
+		 * \return The fastest candidate. If no candidate can be used, a std::invalid_argument is thrown.
+		 *
+		 * Each candidate briefly ciphers messages of typical_size bytes (at most 1 MiB), in several interleaved rounds, and the one with the best throughput wins. AEAD candidates are measured with aead_encrypt(), the other ones with an update() and finalize() sequence in which only the iv is set again, as the key schedule is kept between messages. Candidates that cannot be used (for instance, because they are disabled) are ignored.
+		 *
+		 * The result is cached: later calls with the same candidates, in the same order, and the same typical_size return immediately. The measurement takes a few milliseconds per candidate and is done once per process.
+		 *
+		 * select_fastest() is thread-safe.
+		 */
+		cipher_algorithm select_fastest(const cipher_algorithm* candidates, size_t candidates_count, size_t typical_size);
+
+		/**
+		 * \brief Select the fastest cipher algorithm on the current host.
+		 * \param candidates The candidate algorithms.
+		 * \param typical_size The typical size of the messages that will be ciphered. Cannot be 0 or a std::invalid_argument is thrown.
+		 * \return The fastest candidate. If no candidate can be used, a std::invalid_argument is thrown.
+		 * \see select_fastest(const cipher_algorithm*, size_t, size_t)
+		 */
+		cipher_algorithm select_fastest(const std::vector<cipher_algorithm>& candidates, size_t typical_size);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+		/**
+		 * \brief Select the fastest AEAD algorithm on the current host.
+		 * \param typical_size The typical size of the messages that will be ciphered. Cannot be 0 or a std::invalid_argument is thrown.
+		 * \return The fastest algorithm among AES-128-GCM, AES-256-GCM and, with OpenSSL 1.1.0 or later, ChaCha20-Poly1305.
+		 * \see select_fastest(const cipher_algorithm*, size_t, size_t)
+		 *
+		 * AES-GCM usually wins on hosts with AES and carry-less multiplication instructions while ChaCha20-Poly1305 usually wins on the other ones.
+		 */
+		cipher_algorithm select_fastest_aead(size_t typical_size);
+#endif
+
+		inline cipher_algorithm select_fastest(const std::vector<cipher_algorithm>& candidates, size_t typical_size)
+		{
+			return select_fastest(candidates.empty() ? NULL : &candidates[0], candidates.size(), typical_size);
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_CIPHER_CIPHER_SELECTION_HPP */
@@ -46,12 +46,22 @@
 #define CRYPTOPLUS_CIPHER_CIPHER_STREAM_HPP
 
 #include "cipher_context.hpp"
+#include "../file.hpp"
+
+#include <boost/function.hpp>
 
 #include <vector>
+#include <algorithm>
 #include <cstring>
+#include <cassert>
 
 namespace cryptoplus
 {
+	namespace bio
+	{
+		class bio_ptr;
+	}
+
 	namespace cipher
 	{
 		/**
@@ -61,6 +71,10 @@ namespace cryptoplus
 		 *
 		 * To work with cipher_stream, call the initialize() method like you would do on a cipher_context, call append() or operator<<() as long as you have data to cipher then call finalize(). The resulting ciphered buffer can be get by calling result().
 		 *
+		 * For in-place ciphering, update_in_place() can be used instead of append(): it bypasses the internal buffer entirely. See cipher_context::update_in_place() for its requirements.
+		 *
+		 * When created with a sink, cipher_stream works with a fixed-size internal buffer instead: the output is pushed to the sink each time the buffer is full and when finalize() is called. The memory usage is then constant, whatever the amount of data to cipher.
+		 *
 		 * The list of the available cipher methods depends on the version of OpenSSL and can be found on the man page of EVP_EncryptInit().
 		 *
 		 * cipher_stream is noncopyable by design.
@@ -80,6 +94,28 @@ namespace cryptoplus
 				using cipher_context::ctrl_get;
 				using cipher_context::ctrl_set;
 				using cipher_context::algorithm;
+				using cipher_context::update_in_place;
+
+				/**
+				 * \brief The sink type.
+				 *
+				 * A sink is called with each chunk of output data, in order.
+				 */
+				typedef boost::function<void (const void*, size_t)> sink_type;
+
+				/**
+				 * \brief Get a sink that writes to a BIO.
+				 * \param bio The BIO to write to. Must remain valid as long as the sink is used.
+				 * \return The sink. On error, the sink throws a cryptographic_exception.
+				 */
+				static sink_type bio_sink(bio::bio_ptr bio);
+
+				/**
+				 * \brief Get a sink that writes to a file.
+				 * \param _file The file to write to. Must remain valid as long as the sink is used.
+				 * \return The sink. On error, the sink throws a std::runtime_error.
+				 */
+				static sink_type file_sink(file _file);
 
 				/**
 				 * \brief Create a new cipher stream.
@@ -90,6 +126,16 @@ namespace cryptoplus
 				 */
 				explicit cipher_stream(size_t alloc);
 
+				/**
+				 * \brief Create a new cipher stream that pushes its output to a sink.
+				 * \param buffer_size The size of the internal buffer. It is never reallocated. Values smaller than twice the maximum block length are rounded up.
+				 * \param sink The sink. Cannot be empty.
+				 * \see initalize()
+				 *
+				 * In this mode, result() is not meaningful and reallocate() must not be called.
+				 */
+				cipher_stream(size_t buffer_size, const sink_type& sink);
+
 				/**
 				 * \brief Append data to the stream.
 				 * \param buf The data to append to the stream.
@@ -115,6 +161,8 @@ namespace cryptoplus
 				/**
 				 * \brief Finalize the stream input.
 				 * \see result()
+				 *
+				 * If the cipher_stream has a sink, all the remaining output is pushed to it.
 				 */
 				void finalize();
 
@@ -138,8 +186,11 @@ namespace cryptoplus
 				using cipher_context::update;
 				using cipher_context::finalize;
 
+				void flush();
+
 				std::vector<unsigned char> m_buffer;
 				size_t m_offset;
+				sink_type m_sink;
 		};
 
 		/**
@@ -156,6 +207,12 @@ namespace cryptoplus
 		{
 		}
 
+		inline cipher_stream::cipher_stream(size_t buffer_size, const sink_type& sink) :
+			m_buffer(std::max(buffer_size, static_cast<size_t>(2 * EVP_MAX_BLOCK_LENGTH))), m_offset(0), m_sink(sink)
+		{
+			assert(m_sink);
+		}
+
 		inline cipher_stream& cipher_stream::append(const char* cstr)
 		{
 			return append(cstr, std::strlen(cstr));
@@ -168,6 +225,8 @@ namespace cryptoplus
 
 		inline void cipher_stream::reallocate(size_t alloc)
 		{
+			assert(!m_sink);
+
 			m_buffer.resize(alloc);
 		}
 
@@ -0,0 +1,175 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher_streambuf.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Cipher stream buffer classes.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_CIPHER_STREAMBUF_HPP
+#define CRYPTOPLUS_CIPHER_CIPHER_STREAMBUF_HPP
+
+#include "cipher_context.hpp"
+
+#include <boost/noncopyable.hpp>
+
+#include <streambuf>
+#include <vector>
+#include <cassert>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief An output stream buffer that ciphers everything written to it.
+		 *
+		 * Call context().initialize() like you would do on a cipher_context, use the cipher_ostreambuf with a std::ostream then call finalize() once everything was written. The ciphered data is written to the destination stream buffer as it goes.
+		 *
+		 * Data is ciphered by chunks of a multiple of the block size. Large writes are ciphered directly from the caller's buffer, without being copied to the internal buffer first.
+		 *
+		 * cipher_ostreambuf is noncopyable by design.
+		 */
+		class cipher_ostreambuf : public std::streambuf, public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The default internal buffer size.
+				 */
+				static const size_t default_buffer_size;
+
+				/**
+				 * \brief Create a new cipher_ostreambuf.
+				 * \param destination The stream buffer to write the ciphered data to. Cannot be NULL. Must remain valid as long as the cipher_ostreambuf is used.
+				 * \param buffer_size The size of the internal buffers. It is rounded up to a multiple of EVP_MAX_BLOCK_LENGTH.
+				 */
+				explicit cipher_ostreambuf(std::streambuf* destination, size_t buffer_size = default_buffer_size);
+
+				/**
+				 * \brief Get the underlying cipher_context.
+				 * \return The cipher_context.
+				 *
+				 * The cipher_context must be initialized before anything is written.
+				 */
+				cipher_context& context();
+
+				/**
+				 * \brief Cipher all the pending data, finalize the cipher_context and write the result to the destination.
+				 *
+				 * The destruction of the cipher_ostreambuf does not finalize it: finalize() must be called explicitely once all the data was written.
+				 */
+				void finalize();
+
+			protected:
+
+				int_type overflow(int_type c);
+				std::streamsize xsputn(const char_type* s, std::streamsize n);
+				int sync();
+
+			private:
+
+				void cipher_input(const void* buf, size_t buf_len);
+				void write_output(size_t len);
+
+				std::streambuf* m_destination;
+				cipher_context m_context;
+				std::vector<char_type> m_input;
+				std::vector<unsigned char> m_output;
+		};
+
+		/**
+		 * \brief An input stream buffer that ciphers everything read from it.
+		 *
+		 * Call context().initialize() like you would do on a cipher_context then use the cipher_istreambuf with a std::istream. The data read from the source stream buffer is ciphered as it goes and the cipher_context is finalized once the source reaches its end.
+		 *
+		 * If the finalization fails (for instance, because of a bad padding), the cryptographic_exception is propagated to the std::istream, which either sets its badbit or rethrows it, depending on its exception mask.
+		 *
+		 * cipher_istreambuf is noncopyable by design.
+		 */
+		class cipher_istreambuf : public std::streambuf, public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The default internal buffer size.
+				 */
+				static const size_t default_buffer_size;
+
+				/**
+				 * \brief Create a new cipher_istreambuf.
+				 * \param source The stream buffer to read the data to cipher from. Cannot be NULL. Must remain valid as long as the cipher_istreambuf is used.
+				 * \param buffer_size The size of the internal buffers. It is rounded up to a multiple of EVP_MAX_BLOCK_LENGTH.
+				 */
+				explicit cipher_istreambuf(std::streambuf* source, size_t buffer_size = default_buffer_size);
+
+				/**
+				 * \brief Get the underlying cipher_context.
+				 * \return The cipher_context.
+				 *
+				 * The cipher_context must be initialized before anything is read.
+				 */
+				cipher_context& context();
+
+			protected:
+
+				int_type underflow();
+
+			private:
+
+				std::streambuf* m_source;
+				cipher_context m_context;
+				std::vector<char_type> m_input;
+				std::vector<char_type> m_output;
+				bool m_finalized;
+		};
+
+		inline cipher_context& cipher_ostreambuf::context()
+		{
+			return m_context;
+		}
+
+		inline cipher_context& cipher_istreambuf::context()
+		{
+			return m_context;
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_CIPHER_CIPHER_STREAMBUF_HPP */
@@ -0,0 +1,106 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file file_cipher.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Pipelined file ciphering functions.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_FILE_CIPHER_HPP
+#define CRYPTOPLUS_CIPHER_FILE_CIPHER_HPP
+
+#include "cipher_algorithm.hpp"
+#include "../file.hpp"
+
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief The default buffer size for encrypt_file() and decrypt_file().
+		 */
+		extern const size_t default_file_buffer_size;
+
+		/**
+		 * \brief The default buffer count for encrypt_file() and decrypt_file().
+		 */
+		extern const size_t default_file_buffers_count;
+
+		/**
+		 * \brief Encrypt a file.
+		 * \param destination The file to write the ciphertext to. Data is written from the current position.
+		 * \param source The file to read the plaintext from. Data is read from the current position until the end of the file.
+		 * \param algorithm The cipher algorithm to use.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv to use (if one is needed for the specified algorithm, NULL otherwise).
+		 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+		 * \param buffer_size The size of each buffer.
+		 * \param buffers_count The count of buffers in flight. Must be at least 2.
+		 * \return The count of bytes written to destination.
+		 *
+		 * The work is split in three stages: a reader thread fills buffers from source, the calling thread ciphers them and a writer thread writes them to destination. The stages are connected by bounded lock-free queues and the buffers are recycled, so that reading, ciphering and writing overlap and no memory is allocated once the pipeline runs. A stage that has no buffer to work on sleeps until another stage hands it one, so a slow disk does not keep the other threads busy.
+		 *
+		 * If any stage fails, the whole pipeline stops and the error is rethrown in the calling thread.
+		 */
+		boost::uint64_t encrypt_file(file destination, file source, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t buffer_size = default_file_buffer_size, size_t buffers_count = default_file_buffers_count);
+
+		/**
+		 * \brief Decrypt a file.
+		 * \param destination The file to write the plaintext to. Data is written from the current position.
+		 * \param source The file to read the ciphertext from. Data is read from the current position until the end of the file.
+		 * \param algorithm The cipher algorithm to use.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv to use (if one is needed for the specified algorithm, NULL otherwise).
+		 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+		 * \param buffer_size The size of each buffer.
+		 * \param buffers_count The count of buffers in flight. Must be at least 2.
+		 * \return The count of bytes written to destination.
+		 * \see encrypt_file
+		 */
+		boost::uint64_t decrypt_file(file destination, file source, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t buffer_size = default_file_buffer_size, size_t buffers_count = default_file_buffers_count);
+	}
+}
+
+#endif /* CRYPTOPLUS_CIPHER_FILE_CIPHER_HPP */
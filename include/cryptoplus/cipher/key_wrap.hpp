@@ -0,0 +1,139 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file key_wrap.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief AES key wrapping functions.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_KEY_WRAP_HPP
+#define CRYPTOPLUS_CIPHER_KEY_WRAP_HPP
+
+#include "cipher_algorithm.hpp"
+
+#include <openssl/opensslv.h>
+
+#include <cstddef>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief A key wrap entry descriptor.
+		 * \see key_wrap
+		 * \see key_unwrap
+		 */
+		struct key_wrap_entry
+		{
+			const void* in; /**< \brief The input buffer: the key to wrap or the wrapped key to unwrap. */
+			size_t in_len; /**< \brief The length of the in buffer. */
+			void* out; /**< \brief The output buffer. Should be at least get_wrapped_key_size() bytes long when wrapping, or in_len - 8 bytes long when unwrapping. Cannot be NULL. */
+			size_t out_len; /**< \brief The length of the out buffer. */
+			size_t result_len; /**< \brief The count of bytes written to out. Set by key_wrap() or key_unwrap(). */
+		};
+
+		/**
+		 * \brief Get the size of a wrapped key.
+		 * \param algorithm The key wrap algorithm (for instance: id-aes128-wrap or id-aes128-wrap-pad). If algorithm is not a key wrap algorithm, a std::invalid_argument is thrown.
+		 * \param key_len The length of the key to wrap.
+		 * \return The size of the wrapped key.
+		 */
+		size_t get_wrapped_key_size(const cipher_algorithm& algorithm, size_t key_len);
+
+		/**
+		 * \brief Wrap a key.
+		 * \param algorithm The key wrap algorithm to use: id-aesXXX-wrap (RFC 3394) or id-aesXXX-wrap-pad (RFC 5649). If algorithm is not a key wrap algorithm, a std::invalid_argument is thrown.
+		 * \param kek The key encryption key. Cannot be NULL.
+		 * \param kek_len The length of kek. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param out The output buffer. Must be at least get_wrapped_key_size(algorithm, key_len) bytes long.
+		 * \param out_len The length of out.
+		 * \param key The key to wrap. Cannot be NULL.
+		 * \param key_len The length of key. Without padding, it must be a multiple of 8 and at least 16 bytes long or a std::invalid_argument is thrown.
+		 * \return The count of bytes written to out.
+		 */
+		size_t key_wrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, void* out, size_t out_len, const void* key, size_t key_len);
+
+		/**
+		 * \brief Unwrap a key.
+		 * \param algorithm The key wrap algorithm that was used to wrap the key. If algorithm is not a key wrap algorithm, a std::invalid_argument is thrown.
+		 * \param kek The key encryption key. Cannot be NULL.
+		 * \param kek_len The length of kek. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param out The output buffer. Must be at least wrapped_key_len - 8 bytes long.
+		 * \param out_len The length of out.
+		 * \param wrapped_key The wrapped key. Cannot be NULL.
+		 * \param wrapped_key_len The length of wrapped_key. Must be a multiple of 8 and at least 16 bytes long (24 bytes without padding) or a std::invalid_argument is thrown.
+		 * \return The count of bytes written to out, which is 0 if the integrity check failed.
+		 */
+		size_t key_unwrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, void* out, size_t out_len, const void* wrapped_key, size_t wrapped_key_len);
+
+		/**
+		 * \brief Wrap several keys with the same key encryption key.
+		 * \param algorithm The key wrap algorithm to use. If algorithm is not a key wrap algorithm, a std::invalid_argument is thrown.
+		 * \param kek The key encryption key. Cannot be NULL.
+		 * \param kek_len The length of kek. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param entries The entries to wrap. Cannot be NULL if entries_count is not 0. Every entry is checked before any is wrapped.
+		 * \param entries_count The count of entries.
+		 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+		 *
+		 * The entries are split in runs of consecutive entries. Each run is processed by one cipher_context that is keyed only once, and the runs are spread across several threads. Small batches are processed by the calling thread only.
+		 */
+		void key_wrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, key_wrap_entry* entries, size_t entries_count, unsigned int threads_count = 0);
+
+		/**
+		 * \brief Unwrap several keys with the same key encryption key.
+		 * \param algorithm The key wrap algorithm that was used to wrap the keys. If algorithm is not a key wrap algorithm, a std::invalid_argument is thrown.
+		 * \param kek The key encryption key. Cannot be NULL.
+		 * \param kek_len The length of kek. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param entries The entries to unwrap. Cannot be NULL if entries_count is not 0. Every entry is checked before any is unwrapped.
+		 * \param entries_count The count of entries.
+		 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+		 * \return The count of entries that were successfully unwrapped. The result_len of the entries whose integrity check failed is set to 0 and their out buffer is zeroed.
+		 *
+		 * The entries are processed as in key_wrap().
+		 */
+		size_t key_unwrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, key_wrap_entry* entries, size_t entries_count, unsigned int threads_count = 0);
+	}
+}
+
+#endif
+
+#endif /* CRYPTOPLUS_CIPHER_KEY_WRAP_HPP */
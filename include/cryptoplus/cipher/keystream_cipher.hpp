@@ -0,0 +1,187 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file keystream_cipher.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A keystream precomputing cipher class.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_KEYSTREAM_CIPHER_HPP
+#define CRYPTOPLUS_CIPHER_KEYSTREAM_CIPHER_HPP
+
+#include "cipher_context.hpp"
+
+#include <openssl/opensslv.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <vector>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief A stream cipher that computes its keystream ahead of time.
+		 *
+		 * keystream_cipher takes a counter mode algorithm (for instance: AES-128-CTR) or ChaCha20. A background thread computes the keystream in advance into a ring buffer, so that ciphering some data only takes a xor with the precomputed keystream: the latency of update() no longer depends on the cost of the block function.
+		 *
+		 * When the ring buffer runs out of keystream, update() computes the missing part synchronously and the background thread skips it. On a host with a single core, no background thread is started and update() always works synchronously.
+		 *
+		 * The data given to successive update() calls forms a single stream: the result is byte-identical to the one of a cipher_context initialized with the same key and iv. In counter mode, encryption and decryption are the same operation.
+		 *
+		 * A keystream_cipher can be used by only one thread at a time (apart from its own background thread). keystream_cipher is noncopyable by design.
+		 */
+		class keystream_cipher : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The default size of the ring buffer.
+				 */
+				static const size_t default_buffer_size;
+
+				/**
+				 * \brief Create a new keystream_cipher and start its background thread, if the host has more than one core.
+				 * \param algorithm The cipher algorithm to use. If algorithm is neither a counter mode algorithm nor ChaCha20, a std::invalid_argument is thrown.
+				 * \param key The key to use. Cannot be NULL.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param iv The initial counter block. Cannot be NULL.
+				 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+				 * \param buffer_size The size of the ring buffer. Cannot be 0 or a std::invalid_argument is thrown.
+				 */
+				keystream_cipher(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t buffer_size = default_buffer_size);
+
+				/**
+				 * \brief Stop the background thread and destroy the keystream_cipher.
+				 *
+				 * The ring buffer is cleansed.
+				 */
+				~keystream_cipher();
+
+				/**
+				 * \brief Get the cipher algorithm.
+				 * \return The cipher algorithm.
+				 */
+				cipher_algorithm algorithm() const;
+
+				/**
+				 * \brief Cipher some data.
+				 * \param out The output buffer. Must be at least len bytes long. May be equal to in.
+				 * \param in The input buffer. Can be NULL if len is 0.
+				 * \param len The length of in.
+				 */
+				void update(void* out, const void* in, size_t len);
+
+				/**
+				 * \brief Get the count of bytes ciphered so far.
+				 * \return The position in the keystream.
+				 */
+				boost::uint64_t position() const;
+
+				/**
+				 * \brief Get the count of precomputed keystream bytes that are ready to use.
+				 * \return The count of precomputed keystream bytes.
+				 */
+				size_t available() const;
+
+				/**
+				 * \brief Get the count of bytes that were ciphered synchronously, because the ring buffer was exhausted.
+				 * \return The count of bytes ciphered synchronously.
+				 */
+				boost::uint64_t misses() const;
+
+			private:
+
+				void seek(cipher_context& ctx, boost::uint64_t position) const;
+				void produce();
+				bool is_refill_needed(boost::uint64_t produced, boost::uint64_t consumed) const;
+
+				cipher_algorithm m_algorithm;
+				std::vector<unsigned char> m_iv;
+				size_t m_keystream_block_size;
+				std::vector<unsigned char> m_buffer;
+				cipher_context m_context;
+				boost::uint64_t m_context_position;
+				cipher_context m_producer_context;
+				boost::atomic<boost::uint64_t> m_produced;
+				boost::atomic<boost::uint64_t> m_consumed;
+				boost::uint64_t m_misses;
+				boost::atomic<bool> m_stopped;
+				boost::atomic<bool> m_producer_waiting;
+				boost::mutex m_mutex;
+				boost::condition_variable m_condition;
+				boost::thread m_thread;
+		};
+
+		inline cipher_algorithm keystream_cipher::algorithm() const
+		{
+			return m_algorithm;
+		}
+
+		inline boost::uint64_t keystream_cipher::position() const
+		{
+			return m_consumed.load(boost::memory_order_relaxed);
+		}
+
+		inline size_t keystream_cipher::available() const
+		{
+			const boost::uint64_t consumed = m_consumed.load(boost::memory_order_relaxed);
+			const boost::uint64_t produced = m_produced.load(boost::memory_order_acquire);
+
+			return (produced > consumed) ? static_cast<size_t>(produced - consumed) : 0;
+		}
+
+		inline boost::uint64_t keystream_cipher::misses() const
+		{
+			return m_misses;
+		}
+	}
+}
+
+#endif
+
+#endif /* CRYPTOPLUS_CIPHER_KEYSTREAM_CIPHER_HPP */
@@ -0,0 +1,186 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file nonce_generator.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A per-thread nonce generator class.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_NONCE_GENERATOR_HPP
+#define CRYPTOPLUS_CIPHER_NONCE_GENERATOR_HPP
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief The exception thrown when a nonce_generator cannot generate any more nonces.
+		 *
+		 * When this exception is thrown, the key the nonces were used with must be rotated.
+		 */
+		class nonce_exhausted_error : public std::runtime_error
+		{
+			public:
+
+				/**
+				 * \brief Create a new nonce_exhausted_error.
+				 */
+				nonce_exhausted_error();
+		};
+
+		/**
+		 * \brief A per-thread nonce generator class.
+		 *
+		 * nonce_generator generates unique nonces for AEAD algorithms (GCM, CCM, ChaCha20-Poly1305) without any lock or system call: each thread gets its own prefix on its first call, then its nonces are made of that prefix followed by a 64-bits big-endian counter.
+		 *
+		 * The prefixes are taken from a random base, drawn once on construction, to which the index of each thread is added. Nonces are therefore unique within a nonce_generator: a key must only be used with one nonce_generator.
+		 *
+		 * When a thread's counter reaches the limit given on construction, generate() throws a nonce_exhausted_error and the key must be rotated.
+		 *
+		 * The generated nonces are not suitable as initial counter blocks for counter mode algorithms, whose counter would overlap the one of the next nonce, nor as CBC ivs, which must be unpredictable: the cipher_context overloads that take a nonce_generator only accept AEAD algorithms.
+		 *
+		 * generate() may be called concurrently from several threads. nonce_generator is noncopyable by design.
+		 */
+		class nonce_generator : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The default nonce size.
+				 */
+				static const size_t default_nonce_size;
+
+				/**
+				 * \brief The default count of nonces a thread may generate.
+				 *
+				 * The limit is per thread, not per key: with n threads, a key may see up to n times the limit nonces. It cannot be used as a key rotation bound.
+				 */
+				static const boost::uint64_t default_limit;
+
+				/**
+				 * \brief Create a new nonce_generator.
+				 * \param nonce_size The size of the nonces. Must be between 12 and 16 bytes or a std::invalid_argument is thrown.
+				 * \param limit The count of nonces each thread may generate. Cannot be 0 or a std::invalid_argument is thrown. See default_limit.
+				 */
+				explicit nonce_generator(size_t nonce_size = default_nonce_size, boost::uint64_t limit = default_limit);
+
+				/**
+				 * \brief Get the nonce size.
+				 * \return The nonce size.
+				 */
+				size_t nonce_size() const;
+
+				/**
+				 * \brief Get the count of nonces the calling thread may still generate.
+				 * \return The count of nonces the calling thread may still generate.
+				 */
+				boost::uint64_t remaining() const;
+
+				/**
+				 * \brief Generate a nonce.
+				 * \param nonce The buffer that receives the nonce. Cannot be NULL.
+				 * \param nonce_len The length of nonce. Must match nonce_size() or a std::invalid_argument is thrown.
+				 *
+				 * If the calling thread cannot generate any more nonces, a nonce_exhausted_error is thrown.
+				 */
+				void generate(void* nonce, size_t nonce_len);
+
+				/**
+				 * \brief Generate a nonce.
+				 * \return The nonce.
+				 *
+				 * If the calling thread cannot generate any more nonces, a nonce_exhausted_error is thrown.
+				 */
+				template <typename T>
+				std::vector<T> generate();
+
+			private:
+
+				static const size_t counter_size = 8;
+				static const size_t maximum_prefix_size = 8;
+
+				struct thread_state
+				{
+					boost::uint64_t generator_id;
+					unsigned char prefix[maximum_prefix_size];
+					boost::uint64_t counter;
+				};
+
+				thread_state& get_thread_state() const;
+
+				boost::uint64_t m_id;
+				size_t m_nonce_size;
+				boost::uint64_t m_limit;
+				unsigned char m_base[maximum_prefix_size];
+				mutable boost::atomic<boost::uint64_t> m_threads_count;
+				mutable boost::thread_specific_ptr<thread_state> m_thread_states;
+		};
+
+		inline size_t nonce_generator::nonce_size() const
+		{
+			return m_nonce_size;
+		}
+
+		inline boost::uint64_t nonce_generator::remaining() const
+		{
+			return m_limit - get_thread_state().counter;
+		}
+
+		template <typename T>
+		inline std::vector<T> nonce_generator::generate()
+		{
+			std::vector<T> result(m_nonce_size / sizeof(T));
+
+			generate(&result[0], result.size() * sizeof(T));
+
+			return result;
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_CIPHER_NONCE_GENERATOR_HPP */
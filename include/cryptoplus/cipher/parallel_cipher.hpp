@@ -0,0 +1,121 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file parallel_cipher.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Multi-threaded counter mode ciphering functions.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_PARALLEL_CIPHER_HPP
+#define CRYPTOPLUS_CIPHER_PARALLEL_CIPHER_HPP
+
+#include "cipher_algorithm.hpp"
+
+#include <openssl/opensslv.h>
+
+#include <cstddef>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief Cipher a buffer with a counter mode algorithm, using several threads.
+		 * \param algorithm The counter mode cipher algorithm to use (for instance: AES-128-CTR). If algorithm is not a counter mode algorithm, a std::invalid_argument is thrown.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The initial counter block. Cannot be NULL.
+		 * \param iv_len The length of iv. Must match algorithm.iv_length() or a std::runtime_error is thrown.
+		 * \param out The output buffer. Must be at least len bytes long. May be equal to in.
+		 * \param in The input buffer.
+		 * \param len The length of in.
+		 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+		 *
+		 * The buffer is split in block-aligned chunks. Each thread ciphers its chunk starting with the counter block that a single cipher_context would have reached at that offset, so the result is byte-identical to the one of a single cipher_context.
+		 *
+		 * In counter mode, encryption and decryption are the same operation.
+		 */
+		void parallel_encrypt(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, void* out, const void* in, size_t len, unsigned int threads_count = 0);
+
+		/**
+		 * \brief Encrypt and authenticate a buffer with AES-GCM, using several threads.
+		 * \param algorithm The AES-GCM cipher algorithm to use. If algorithm is not AES-128-GCM, AES-192-GCM or AES-256-GCM, a std::invalid_argument is thrown.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv to use. Cannot be NULL.
+		 * \param iv_len The length of iv. Must be 12 or a std::invalid_argument is thrown.
+		 * \param aad The additional authenticated data. Can be NULL if aad_len is 0.
+		 * \param aad_len The length of aad.
+		 * \param out The output buffer. Must be at least len bytes long. May be equal to in.
+		 * \param in The input buffer.
+		 * \param len The length of in.
+		 * \param tag The buffer that receives the authentication tag. Cannot be NULL.
+		 * \param tag_len The length of tag. Must be between 12 and 16 bytes or a std::invalid_argument is thrown.
+		 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+		 *
+		 * Each thread encrypts its chunk in counter mode and computes the GHASH of the resulting ciphertext. The partial GHASH values are then combined in GF(2^128) so that both the ciphertext and the tag are byte-identical to the ones of a single cipher_context.
+		 */
+		void parallel_encrypt(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* out, const void* in, size_t len, void* tag, size_t tag_len, unsigned int threads_count = 0);
+
+		/**
+		 * \brief Check the authenticity of a buffer and decrypt it with AES-GCM, using several threads.
+		 * \param algorithm The AES-GCM cipher algorithm to use. If algorithm is not AES-128-GCM, AES-192-GCM or AES-256-GCM, a std::invalid_argument is thrown.
+		 * \param key The key to use. Cannot be NULL.
+		 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+		 * \param iv The iv that was used for encryption. Cannot be NULL.
+		 * \param iv_len The length of iv. Must be 12 or a std::invalid_argument is thrown.
+		 * \param aad The additional authenticated data. Can be NULL if aad_len is 0.
+		 * \param aad_len The length of aad.
+		 * \param out The output buffer. Must be at least len bytes long. May be equal to in.
+		 * \param in The input buffer.
+		 * \param len The length of in.
+		 * \param tag The authentication tag. Cannot be NULL.
+		 * \param tag_len The length of tag. Must be between 12 and 16 bytes or a std::invalid_argument is thrown.
+		 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+		 * \return true if the tag matches. If the tag does not match, false is returned and out is zeroed.
+		 */
+		bool parallel_decrypt(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* out, const void* in, size_t len, const void* tag, size_t tag_len, unsigned int threads_count = 0);
+	}
+}
+
+#endif
+
+#endif /* CRYPTOPLUS_CIPHER_PARALLEL_CIPHER_HPP */
@@ -0,0 +1,156 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file sector_cipher.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A XTS sector cipher class.
+ */
+
+#ifndef CRYPTOPLUS_CIPHER_SECTOR_CIPHER_HPP
+#define CRYPTOPLUS_CIPHER_SECTOR_CIPHER_HPP
+
+#include "cipher_context.hpp"
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+
+#include <vector>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		/**
+		 * \brief A sector cipher class.
+		 *
+		 * sector_cipher encrypts and decrypts runs of fixed-size sectors with a XTS algorithm (AES-128-XTS or AES-256-XTS), as done by disk encryption software: each sector is a XTS data unit whose tweak is its sector number, encoded as a 16 bytes little-endian integer (IEEE 1619).
+		 *
+		 * The key schedules are computed once, on construction: processing a sector only changes the tweak. Large runs of sectors are spread across several threads, each one with its own cipher_context.
+		 *
+		 * A sector_cipher can be used by only one thread at a time. sector_cipher is noncopyable by design.
+		 */
+		class sector_cipher : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief The default sector size.
+				 */
+				static const size_t default_sector_size;
+
+				/**
+				 * \brief Create a new sector_cipher.
+				 * \param algorithm The XTS cipher algorithm to use. If algorithm is not a XTS algorithm, a std::invalid_argument is thrown.
+				 * \param key The key to use. Cannot be NULL. Its two halves must differ.
+				 * \param key_len The length of key. Must match algorithm.key_length() or a std::runtime_error is thrown.
+				 * \param sector_size The sector size. Must be at least 16 bytes or a std::invalid_argument is thrown.
+				 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+				 */
+				sector_cipher(const cipher_algorithm& algorithm, const void* key, size_t key_len, size_t sector_size = default_sector_size, unsigned int threads_count = 0);
+
+				/**
+				 * \brief Get the algorithm.
+				 * \return The algorithm.
+				 */
+				cipher_algorithm algorithm() const;
+
+				/**
+				 * \brief Get the sector size.
+				 * \return The sector size.
+				 */
+				size_t sector_size() const;
+
+				/**
+				 * \brief Encrypt a run of sectors.
+				 * \param sector The number of the first sector.
+				 * \param out The output buffer. Must be at least len bytes long. May be equal to in.
+				 * \param in The input buffer.
+				 * \param len The length of in. Must be a multiple of sector_size() or a std::invalid_argument is thrown.
+				 */
+				void encrypt(boost::uint64_t sector, void* out, const void* in, size_t len);
+
+				/**
+				 * \brief Decrypt a run of sectors.
+				 * \param sector The number of the first sector.
+				 * \param out The output buffer. Must be at least len bytes long. May be equal to in.
+				 * \param in The input buffer.
+				 * \param len The length of in. Must be a multiple of sector_size() or a std::invalid_argument is thrown.
+				 */
+				void decrypt(boost::uint64_t sector, void* out, const void* in, size_t len);
+
+			private:
+
+				typedef std::vector<boost::shared_ptr<cipher_context> > context_list;
+
+				void process(context_list& contexts, boost::uint64_t sector, void* out, const void* in, size_t len);
+
+				cipher_algorithm m_algorithm;
+				size_t m_sector_size;
+				context_list m_encrypt_contexts;
+				context_list m_decrypt_contexts;
+		};
+
+		inline cipher_algorithm sector_cipher::algorithm() const
+		{
+			return m_algorithm;
+		}
+
+		inline size_t sector_cipher::sector_size() const
+		{
+			return m_sector_size;
+		}
+
+		inline void sector_cipher::encrypt(boost::uint64_t sector, void* out, const void* in, size_t len)
+		{
+			process(m_encrypt_contexts, sector, out, in, len);
+		}
+
+		inline void sector_cipher::decrypt(boost::uint64_t sector, void* out, const void* in, size_t len)
+		{
+			process(m_decrypt_contexts, sector, out, in, len);
+		}
+	}
+}
+
+#endif
+
+#endif /* CRYPTOPLUS_CIPHER_SECTOR_CIPHER_HPP */
@@ -61,6 +61,22 @@ namespace cryptoplus
 			OpenSSL_add_all_algorithms();
 		}
 
+		/**
+		 * \brief A function wrapper to call EVP_cleanup, which is a macro since OpenSSL 1.1.
+		 */
+		inline void _EVP_cleanup()
+		{
+			EVP_cleanup();
+		}
+
+		/**
+		 * \brief A function wrapper to call CRYPTO_cleanup_all_ex_data, which is a macro since OpenSSL 1.1.
+		 */
+		inline void _CRYPTO_cleanup_all_ex_data()
+		{
+			CRYPTO_cleanup_all_ex_data();
+		}
+
 		/**
 		 * \brief A function that does nothing.
 		 */
@@ -74,14 +90,14 @@ namespace cryptoplus
 	 *
 	 * Only one instance of this class should be created. When an instance exists, the library can proceed to name resolutions.
 	 */
-	typedef initializer<_OpenSSL_add_all_algorithms, EVP_cleanup> algorithms_initializer;
+	typedef initializer<_OpenSSL_add_all_algorithms, _EVP_cleanup> algorithms_initializer;
 
 	/**
 	 * \brief The crypto initializer.
 	 *
 	 * Only one instance of this class should be created. When an instance exists, it will prevent memory leaks related to the libcrypto's internals.
 	 */
-	typedef initializer<_null_function, CRYPTO_cleanup_all_ex_data> crypto_initializer;
+	typedef initializer<_null_function, _CRYPTO_cleanup_all_ex_data> crypto_initializer;
 }
 
 #endif /* CRYPTOPLUS_CRYPTOPLUS_HPP */
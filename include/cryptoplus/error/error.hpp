@@ -234,7 +234,13 @@ namespace cryptoplus
 		}
 		inline int get_function_error(error_type err)
 		{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+			static_cast<void>(err);
+
+			return 0;
+#else
 			return ERR_GET_FUNC(err);
+#endif
 		}
 		inline int get_reason_error(error_type err)
 		{
@@ -54,12 +54,31 @@ namespace cryptoplus
 {
 	namespace error
 	{
+		namespace
+		{
+			/**
+			 * \brief A function wrapper to call ERR_load_crypto_strings, which is a macro since OpenSSL 1.1.
+			 */
+			inline void _ERR_load_crypto_strings()
+			{
+				ERR_load_crypto_strings();
+			}
+
+			/**
+			 * \brief A function wrapper to call ERR_free_strings, which is a macro since OpenSSL 1.1.
+			 */
+			inline void _ERR_free_strings()
+			{
+				ERR_free_strings();
+			}
+		}
+
 		/**
 		 * \brief A error string initializer.
 		 *
 		 * Only one instance of this class should be created. When an instance exists, the library can provide more informative error strings.
 		 */
-		typedef initializer<ERR_load_crypto_strings, ERR_free_strings> error_strings_initializer;
+		typedef initializer<_ERR_load_crypto_strings, _ERR_free_strings> error_strings_initializer;
 
 		/**
 		 * \brief Get the error string associated with a specified error.
@@ -0,0 +1,158 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file algorithm_tags.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Compile-time message digest algorithm tags.
+ */
+
+#ifndef CRYPTOPLUS_HASH_ALGORITHM_TAGS_HPP
+#define CRYPTOPLUS_HASH_ALGORITHM_TAGS_HPP
+
+#include "message_digest_algorithm.hpp"
+
+#include <openssl/evp.h>
+
+#include <boost/array.hpp>
+
+#include <cstddef>
+
+namespace cryptoplus
+{
+	namespace hash
+	{
+		/**
+		 * \brief The base class of the message digest algorithm tags.
+		 * \tparam ResultSize The size of the generated digest message.
+		 * \tparam BlockSize The block size.
+		 *
+		 * A message digest algorithm tag gives the sizes of a message digest algorithm as integral constant expressions, so that they can be used to size arrays. Its raw() static method returns the EVP_MD directly, without any lookup by name.
+		 *
+		 * Tags can be given to the message_digest_context::initialize() and message_digest_context::finalize() overloads that work with fixed-size boost::array digests.
+		 */
+		template <size_t ResultSize, size_t BlockSize>
+		struct message_digest_algorithm_tag
+		{
+			/**
+			 * \brief The size of the generated digest message.
+			 */
+			static const size_t result_size = ResultSize;
+
+			/**
+			 * \brief The block size.
+			 */
+			static const size_t block_size = BlockSize;
+
+			/**
+			 * \brief The digest type.
+			 */
+			typedef boost::array<unsigned char, ResultSize> digest_type;
+		};
+
+		template <size_t ResultSize, size_t BlockSize>
+		const size_t message_digest_algorithm_tag<ResultSize, BlockSize>::result_size;
+
+		template <size_t ResultSize, size_t BlockSize>
+		const size_t message_digest_algorithm_tag<ResultSize, BlockSize>::block_size;
+
+		/**
+		 * \brief Get the message_digest_algorithm of a tag.
+		 * \param tag The tag.
+		 * \return The message_digest_algorithm.
+		 */
+		template <typename Algorithm>
+		message_digest_algorithm get_message_digest_algorithm(Algorithm tag);
+
+		/**
+		 * \brief The MD5 algorithm tag.
+		 */
+		struct md5 : message_digest_algorithm_tag<16, 64>
+		{
+			static const EVP_MD* raw() { return EVP_md5(); } /**< \brief Get the EVP_MD. */
+		};
+
+		/**
+		 * \brief The SHA1 algorithm tag.
+		 */
+		struct sha1 : message_digest_algorithm_tag<20, 64>
+		{
+			static const EVP_MD* raw() { return EVP_sha1(); } /**< \brief Get the EVP_MD. */
+		};
+
+		/**
+		 * \brief The SHA224 algorithm tag.
+		 */
+		struct sha224 : message_digest_algorithm_tag<28, 64>
+		{
+			static const EVP_MD* raw() { return EVP_sha224(); } /**< \brief Get the EVP_MD. */
+		};
+
+		/**
+		 * \brief The SHA256 algorithm tag.
+		 */
+		struct sha256 : message_digest_algorithm_tag<32, 64>
+		{
+			static const EVP_MD* raw() { return EVP_sha256(); } /**< \brief Get the EVP_MD. */
+		};
+
+		/**
+		 * \brief The SHA384 algorithm tag.
+		 */
+		struct sha384 : message_digest_algorithm_tag<48, 128>
+		{
+			static const EVP_MD* raw() { return EVP_sha384(); } /**< \brief Get the EVP_MD. */
+		};
+
+		/**
+		 * \brief The SHA512 algorithm tag.
+		 */
+		struct sha512 : message_digest_algorithm_tag<64, 128>
+		{
+			static const EVP_MD* raw() { return EVP_sha512(); } /**< \brief Get the EVP_MD. */
+		};
+
+		template <typename Algorithm>
+		inline message_digest_algorithm get_message_digest_algorithm(Algorithm)
+		{
+			return message_digest_algorithm(Algorithm::raw());
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_HASH_ALGORITHM_TAGS_HPP */
@@ -46,6 +46,7 @@
 #define CRYPTOPLUS_HASH_HMAC_HPP
 
 #include "message_digest_algorithm.hpp"
+#include "hmac_key.hpp"
 
 #include <openssl/hmac.h>
 
@@ -82,6 +83,29 @@ namespace cryptoplus
 		template <typename T>
 		std::vector<T> hmac(const void* key, size_t key_len, const void* data, size_t len, const message_digest_algorithm& algorithm, ENGINE* impl = NULL);
 
+		/**
+		 * \brief Compute a HMAC for the given buffer, using a precomputed key.
+		 * \param out The output buffer. Must be at least key.algorithm().result_size() bytes long.
+		 * \param out_len The output buffer length.
+		 * \param data The buffer. Can be NULL only if len is 0.
+		 * \param len The buffer length.
+		 * \param key The precomputed key. It is only read, so several threads can use the same key at once.
+		 * \return The count of bytes written to out. Should be equal to key.algorithm().result_size().
+		 *
+		 * The result is the same as the one of the other hmac() overloads, but neither the key nor the pads are hashed again.
+		 */
+		size_t hmac(void* out, size_t out_len, const void* data, size_t len, const hmac_key& key);
+
+		/**
+		 * \brief Compute a HMAC for the given buffer, using a precomputed key.
+		 * \param data The buffer. Can be NULL only if len is 0.
+		 * \param len The buffer length.
+		 * \param key The precomputed key. It is only read, so several threads can use the same key at once.
+		 * \return The hmac.
+		 */
+		template <typename T>
+		std::vector<T> hmac(const void* data, size_t len, const hmac_key& key);
+
 		template <typename T>
 		inline std::vector<T> hmac(const void* key, size_t key_len, const void* data, size_t len, const message_digest_algorithm& algorithm, ENGINE* impl)
 		{
@@ -91,6 +115,16 @@ namespace cryptoplus
 
 			return result;
 		}
+
+		template <typename T>
+		inline std::vector<T> hmac(const void* data, size_t len, const hmac_key& key)
+		{
+			std::vector<T> result(key.algorithm().result_size());
+
+			hmac(&result[0], result.size(), data, len, key);
+
+			return result;
+		}
 	}
 }
 
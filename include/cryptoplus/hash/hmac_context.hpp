@@ -66,6 +66,8 @@ namespace cryptoplus
 		 *
 		 * The list of the available hash methods depends on the version of OpenSSL and can be found on the man page of EVP_DigestInit().
 		 *
+		 * Since OpenSSL 3, the HMAC is computed through the EVP_MAC interface: the HMAC implementation is fetched once for the whole process and the digest is only given to the provider when it changes, so that reinitializing a hmac_context does not fetch anything.
+		 *
 		 * A hmac_context is non-copyable by design.
 		 */
 		class hmac_context : public boost::noncopyable
@@ -80,7 +82,7 @@ namespace cryptoplus
 				/**
 				 * \brief Destroy a hmac_context.
 				 *
-				 * Calls HMAC_CTX_cleanup() on the internal HMAC_CTX.
+				 * Frees the internal context.
 				 */
 				~hmac_context();
 
@@ -89,7 +91,7 @@ namespace cryptoplus
 				 * \param key The key to use. If key is NULL, the previously used key is taken.
 				 * \param key_len The key length. If key is NULL, key_len is not used.
 				 * \param algorithm The message digest algorithm to use. If algorithm is NULL, then the previously specified algorithm is reused.
-				 * \param impl The engine to use. Default is NULL which indicates that no engine should be used.
+				 * \param impl The engine to use. Default is NULL which indicates that no engine should be used. Since OpenSSL 3, engines cannot be used and a std::invalid_argument is thrown if impl is not NULL.
 				 *
 				 * The list of the available hash methods depends on the version of OpenSSL and can be found on the man page of EVP_DigestInit().
 				 */
@@ -124,7 +126,11 @@ namespace cryptoplus
 				 * \return The underlying context.
 				 * \warning This method is provided for compatibility issues only. Its use is greatly discouraged.
 				 */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+				EVP_MAC_CTX& raw();
+#else
 				HMAC_CTX& raw();
+#endif
 
 				/**
 				 * \brief Get the associated message digest algorithm.
@@ -134,25 +140,22 @@ namespace cryptoplus
 
 			private:
 
-				HMAC_CTX m_ctx;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+				EVP_MAC_CTX* m_ctx;
+				message_digest_algorithm m_algorithm;
+#else
+				HMAC_CTX* m_ctx;
+#endif
 		};
 
-		inline hmac_context::hmac_context()
-		{
-			HMAC_CTX_init(&m_ctx);
-		}
-
-		inline hmac_context::~hmac_context()
-		{
-			HMAC_CTX_cleanup(&m_ctx);
-		}
-
 		inline void hmac_context::update(const void* data, size_t len)
 		{
-#if OPENSSL_VERSION_NUMBER < 0x01000000
-			HMAC_Update(&m_ctx, static_cast<const unsigned char*>(data), static_cast<int>(len));
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+			error::throw_error_if_not(EVP_MAC_update(m_ctx, static_cast<const unsigned char*>(data), len) != 0);
+#elif OPENSSL_VERSION_NUMBER < 0x01000000
+			HMAC_Update(m_ctx, static_cast<const unsigned char*>(data), static_cast<int>(len));
 #else
-			error::throw_error_if_not(HMAC_Update(&m_ctx, static_cast<const unsigned char*>(data), static_cast<int>(len)) != 0);
+			error::throw_error_if_not(HMAC_Update(m_ctx, static_cast<const unsigned char*>(data), static_cast<int>(len)) != 0);
 #endif
 		}
 
@@ -166,16 +169,32 @@ namespace cryptoplus
 			return result;
 		}
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		inline EVP_MAC_CTX& hmac_context::raw()
+		{
+			return *m_ctx;
+		}
+
+		inline message_digest_algorithm hmac_context::algorithm() const
+		{
+			return m_algorithm;
+		}
+#else
 		inline HMAC_CTX& hmac_context::raw()
 		{
-			return m_ctx;
+			return *m_ctx;
 		}
 
 		inline message_digest_algorithm hmac_context::algorithm() const
 		{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+			return message_digest_algorithm(HMAC_CTX_get_md(m_ctx));
+#else
 			//WARNING: Here we directly use the undocumented HMAC_CTX.md field. This is unlikely to change, but if it ever does, we'll have to find a better way of doing things nicely.
-			return message_digest_algorithm(m_ctx.md);
+			return message_digest_algorithm(m_ctx->md);
+#endif
 		}
+#endif
 	}
 }
 
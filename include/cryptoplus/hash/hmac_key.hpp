@@ -0,0 +1,121 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file hmac_key.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A precomputed HMAC key class.
+ */
+
+#ifndef CRYPTOPLUS_HASH_HMAC_KEY_HPP
+#define CRYPTOPLUS_HASH_HMAC_KEY_HPP
+
+#include "message_digest_algorithm.hpp"
+#include "message_digest_context.hpp"
+
+#include <boost/noncopyable.hpp>
+
+namespace cryptoplus
+{
+	namespace hash
+	{
+		/**
+		 * \brief A precomputed HMAC key class.
+		 *
+		 * A HMAC is H((K ^ opad) || H((K ^ ipad) || data)). hmac_key hashes K ^ ipad and K ^ opad once, on construction, and keeps the two resulting digest states: computing the HMAC of a message then only copies these states instead of hashing the key and the pads again. See the hmac() overloads that take a hmac_key.
+		 *
+		 * Once constructed, a hmac_key is never modified, so it can be shared by several threads at once.
+		 *
+		 * A hmac_key is non-copyable by design.
+		 */
+		class hmac_key : public boost::noncopyable
+		{
+			public:
+
+				/**
+				 * \brief Create a new hmac_key.
+				 * \param key The key to use. Can be NULL only if key_len is 0.
+				 * \param key_len The key length.
+				 * \param algorithm The message digest algorithm to use.
+				 * \param impl The engine to use. The NULL default value indicate that no engine should be used.
+				 */
+				hmac_key(const void* key, size_t key_len, const message_digest_algorithm& algorithm, ENGINE* impl = NULL);
+
+				/**
+				 * \brief Get the message digest algorithm.
+				 * \return The message digest algorithm.
+				 */
+				message_digest_algorithm algorithm() const;
+
+				/**
+				 * \brief Get the inner digest state.
+				 * \return The digest state after K ^ ipad was hashed.
+				 */
+				const message_digest_context& inner() const;
+
+				/**
+				 * \brief Get the outer digest state.
+				 * \return The digest state after K ^ opad was hashed.
+				 */
+				const message_digest_context& outer() const;
+
+			private:
+
+				message_digest_algorithm m_algorithm;
+				message_digest_context m_inner;
+				message_digest_context m_outer;
+		};
+
+		inline message_digest_algorithm hmac_key::algorithm() const
+		{
+			return m_algorithm;
+		}
+
+		inline const message_digest_context& hmac_key::inner() const
+		{
+			return m_inner;
+		}
+
+		inline const message_digest_context& hmac_key::outer() const
+		{
+			return m_outer;
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_HASH_HMAC_KEY_HPP */
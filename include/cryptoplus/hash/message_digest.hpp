@@ -45,6 +45,8 @@
 #ifndef CRYPTOPLUS_HASH_MESSAGE_DIGEST_HPP
 #define CRYPTOPLUS_HASH_MESSAGE_DIGEST_HPP
 
+#include "../error/cryptographic_exception.hpp"
+#include "../buffer.hpp"
 #include "message_digest_algorithm.hpp"
 
 #include <openssl/evp.h>
@@ -78,6 +80,53 @@ namespace cryptoplus
 		template <typename T>
 		std::vector<T> message_digest(const void* data, size_t len, const message_digest_algorithm& algorithm, ENGINE* impl = NULL);
 
+		/**
+		 * \brief Compute a message digest for the given buffer, using a message digest algorithm tag.
+		 * \param data The buffer.
+		 * \param len The buffer length.
+		 * \param tag The message digest algorithm tag (for instance: sha256()). See algorithm_tags.hpp.
+		 * \param impl The engine to use. The NULL default value indicate that no engine should be used.
+		 * \return The message digest, in a fixed-size array.
+		 */
+		template <typename Algorithm>
+		typename Algorithm::digest_type message_digest(const void* data, size_t len, Algorithm tag, ENGINE* impl = NULL);
+
+		/**
+		 * \brief Compute the message digests of several buffers at once.
+		 * \param algorithm The message digest algorithm to use.
+		 * \param inputs The buffers to hash. The data of a buffer can be NULL if its size is 0.
+		 * \param outputs The output buffers, one per input buffer. Each one must be at least algorithm.result_size() bytes long.
+		 * \param count The count of input buffers.
+		 *
+		 * The digest of each buffer is the same as the one message_digest() gives.
+		 *
+		 * With SHA-1 and SHA-256, on x86 processors that support AVX2 but not the SHA extensions, eight buffers are hashed at once, each one in its own lane of the vector registers. Otherwise, the buffers are hashed one after the other with a single context, which still saves the setup of a context per buffer.
+		 */
+		void message_digest_batch(const message_digest_algorithm& algorithm, const const_buffer* inputs, const mutable_buffer* outputs, size_t count);
+
+		/// \cond PRIVATE
+		namespace detail
+		{
+			/**
+			 * \brief The ways message_digest_batch() can hash its buffers.
+			 */
+			enum batch_mode
+			{
+				batch_auto, /**< \brief Pick the fastest way for the processor. */
+				batch_one_by_one, /**< \brief Always hash the buffers one after the other. */
+				batch_multi_buffer /**< \brief Use the AVX2 lanes for SHA-1 and SHA-256 whenever AVX2 is supported, even with the SHA extensions. */
+			};
+
+			/**
+			 * \brief Change the way message_digest_batch() hashes its buffers.
+			 * \param mode The mode.
+			 * \return false if mode is batch_multi_buffer and the processor does not support AVX2. The mode is then left unchanged.
+			 * \warning This is meant for tests, so that every code path can be checked on one host. A batch that already started keeps the mode it started with.
+			 */
+			bool set_batch_mode(batch_mode mode);
+		}
+		/// \endcond
+
 		template <typename T>
 		inline std::vector<T> message_digest(const void* data, size_t len, const message_digest_algorithm& algorithm, ENGINE* impl)
 		{
@@ -87,6 +136,16 @@ namespace cryptoplus
 
 			return result;
 		}
+
+		template <typename Algorithm>
+		inline typename Algorithm::digest_type message_digest(const void* data, size_t len, Algorithm, ENGINE* impl)
+		{
+			typename Algorithm::digest_type result;
+
+			error::throw_error_if_not(EVP_Digest(data, len, result.data(), NULL, message_digest_algorithm(Algorithm::raw()).raw(), impl) != 0);
+
+			return result;
+		}
 	}
 }
 
@@ -63,6 +63,8 @@ namespace cryptoplus
 				/**
 				 * \brief Create a new message_digest_algorithm from a const EVP_MD pointer.
 				 * \param md The raw const EVP_MD pointer. If md is NULL, the behavior is undefined.
+				 *
+				 * Since OpenSSL 3, a legacy EVP_MD (as returned by EVP_sha256() for instance) is fetched from the providers on every context initialization that uses it. To avoid that, the algorithm is fetched once from the default library context and the fetched handle is cached for the lifetime of the process: raw() then returns the fetched handle. If the algorithm cannot be fetched, md is kept as is.
 				 */
 				message_digest_algorithm(const EVP_MD* md);
 
@@ -115,10 +117,12 @@ namespace cryptoplus
 				const EVP_MD* m_md;
 		};
 
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
 		inline message_digest_algorithm::message_digest_algorithm(const EVP_MD* md) :
 			m_md(md)
 		{
 		}
+#endif
 
 		inline const EVP_MD* message_digest_algorithm::raw() const
 		{
@@ -52,8 +52,10 @@
 #include <openssl/evp.h>
 
 #include <boost/noncopyable.hpp>
+#include <boost/utility/enable_if.hpp>
 
 #include <vector>
+#include <cassert>
 
 namespace cryptoplus
 {
@@ -80,7 +82,7 @@ namespace cryptoplus
 				/**
 				 * \brief Destroy a message_digest_context.
 				 *
-				 * Calls EVP_MD_CTX_cleanup() on the internal EVP_MD_CTX.
+				 * Calls EVP_MD_CTX_free() on the internal EVP_MD_CTX.
 				 */
 				~message_digest_context();
 
@@ -93,6 +95,16 @@ namespace cryptoplus
 				 */
 				void initialize(const message_digest_algorithm& algorithm, ENGINE* impl = NULL);
 
+				/**
+				 * \brief Initialize the message_digest_context from a message digest algorithm tag.
+				 * \param tag The message digest algorithm tag (for instance: sha256()). See algorithm_tags.hpp.
+				 * \param impl The engine to use. Default is NULL which indicates that no engine should be used.
+				 *
+				 * The EVP_MD is taken directly from the tag: no lookup by name takes place.
+				 */
+				template <typename Algorithm>
+				typename boost::enable_if_c<(Algorithm::result_size > 0)>::type initialize(Algorithm tag, ENGINE* impl = NULL);
+
 				/**
 				 * \brief Initialize the message_digest_context for signing.
 				 * \param algorithm The message digest algorithm to use.
@@ -151,6 +163,18 @@ namespace cryptoplus
 				template <typename T>
 				std::vector<T> finalize();
 
+				/**
+				 * \brief Finalize the message_digest_context and get the resulting digest in a fixed-size array.
+				 * \param tag The message digest algorithm tag that was used to initialize the message_digest_context.
+				 * \return The resulting digest.
+				 *
+				 * No memory is allocated and no runtime size check is done.
+				 *
+				 * After a call to finalize() no more call to update() can be made unless initialize() is called again first.
+				 */
+				template <typename Algorithm>
+				typename Algorithm::digest_type finalize(Algorithm tag);
+
 				/**
 				 * \brief Finalize the message_digest_context and get the resulting signature.
 				 * \param sig The resulting signature. Cannot be NULL. Must be at least pkey->size() bytes long.
@@ -206,47 +230,67 @@ namespace cryptoplus
 
 			private:
 
-				EVP_MD_CTX m_ctx;
+				EVP_MD_CTX* m_ctx;
 		};
 
-		inline message_digest_context::message_digest_context()
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		inline message_digest_context::message_digest_context() :
+			m_ctx(EVP_MD_CTX_new())
 		{
-			EVP_MD_CTX_init(&m_ctx);
+			error::throw_error_if_not(m_ctx != NULL);
 		}
 
 		inline message_digest_context::~message_digest_context()
 		{
-			EVP_MD_CTX_cleanup(&m_ctx);
+			EVP_MD_CTX_free(m_ctx);
+		}
+#else
+		inline message_digest_context::message_digest_context() :
+			m_ctx(EVP_MD_CTX_create())
+		{
+			error::throw_error_if_not(m_ctx != NULL);
 		}
 
+		inline message_digest_context::~message_digest_context()
+		{
+			EVP_MD_CTX_destroy(m_ctx);
+		}
+#endif
+
 		inline void message_digest_context::initialize(const message_digest_algorithm& _algorithm, ENGINE* impl)
 		{
-			error::throw_error_if_not(EVP_DigestInit_ex(&m_ctx, _algorithm.raw(), impl) != 0);
+			error::throw_error_if_not(EVP_DigestInit_ex(m_ctx, _algorithm.raw(), impl) != 0);
+		}
+
+		template <typename Algorithm>
+		inline typename boost::enable_if_c<(Algorithm::result_size > 0)>::type message_digest_context::initialize(Algorithm, ENGINE* impl)
+		{
+			error::throw_error_if_not(EVP_DigestInit_ex(m_ctx, message_digest_algorithm(Algorithm::raw()).raw(), impl) != 0);
 		}
 
 		inline void message_digest_context::sign_initialize(const message_digest_algorithm& _algorithm, ENGINE* impl)
 		{
-			error::throw_error_if_not(EVP_SignInit_ex(&m_ctx, _algorithm.raw(), impl) != 0);
+			error::throw_error_if_not(EVP_SignInit_ex(m_ctx, _algorithm.raw(), impl) != 0);
 		}
 
 		inline void message_digest_context::verify_initialize(const message_digest_algorithm& _algorithm, ENGINE* impl)
 		{
-			error::throw_error_if_not(EVP_VerifyInit_ex(&m_ctx, _algorithm.raw(), impl) != 0);
+			error::throw_error_if_not(EVP_VerifyInit_ex(m_ctx, _algorithm.raw(), impl) != 0);
 		}
 
 		inline void message_digest_context::update(const void* data, size_t len)
 		{
-			error::throw_error_if_not(EVP_DigestUpdate(&m_ctx, data, len) != 0);
+			error::throw_error_if_not(EVP_DigestUpdate(m_ctx, data, len) != 0);
 		}
 
 		inline void message_digest_context::sign_update(const void* data, size_t len)
 		{
-			error::throw_error_if_not(EVP_SignUpdate(&m_ctx, data, len) != 0);
+			error::throw_error_if_not(EVP_SignUpdate(m_ctx, data, len) != 0);
 		}
 
 		inline void message_digest_context::verify_update(const void* data, size_t len)
 		{
-			error::throw_error_if_not(EVP_VerifyUpdate(&m_ctx, data, len) != 0);
+			error::throw_error_if_not(EVP_VerifyUpdate(m_ctx, data, len) != 0);
 		}
 
 		template <typename T>
@@ -259,6 +303,18 @@ namespace cryptoplus
 			return result;
 		}
 
+		template <typename Algorithm>
+		inline typename Algorithm::digest_type message_digest_context::finalize(Algorithm)
+		{
+			typename Algorithm::digest_type result;
+
+			assert(algorithm().result_size() == result.size());
+
+			error::throw_error_if_not(EVP_DigestFinal_ex(m_ctx, result.data(), NULL) != 0);
+
+			return result;
+		}
+
 		template <typename T>
 		inline std::vector<T> message_digest_context::sign_finalize(pkey::pkey& pkey)
 		{
@@ -271,17 +327,17 @@ namespace cryptoplus
 
 		inline void message_digest_context::copy(const message_digest_context& ctx)
 		{
-			error::throw_error_if_not(EVP_MD_CTX_copy_ex(&m_ctx, &ctx.m_ctx) != 0);
+			error::throw_error_if_not(EVP_MD_CTX_copy_ex(m_ctx, ctx.m_ctx) != 0);
 		}
 
 		inline EVP_MD_CTX& message_digest_context::raw()
 		{
-			return m_ctx;
+			return *m_ctx;
 		}
 
 		inline message_digest_algorithm message_digest_context::algorithm() const
 		{
-			return message_digest_algorithm(EVP_MD_CTX_md(&m_ctx));
+			return message_digest_algorithm(EVP_MD_CTX_md(m_ctx));
 		}
 	}
 }
@@ -0,0 +1,169 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file tree_digest.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A Merkle tree digest class.
+ */
+
+#ifndef CRYPTOPLUS_HASH_TREE_DIGEST_HPP
+#define CRYPTOPLUS_HASH_TREE_DIGEST_HPP
+
+#include "message_digest_algorithm.hpp"
+
+#include <vector>
+
+namespace cryptoplus
+{
+	namespace hash
+	{
+		/**
+		 * \brief A Merkle tree digest class.
+		 *
+		 * tree_digest computes the root of a Merkle tree over a buffer. The leaves are hashed in parallel, so large buffers are hashed on several cores at once.
+		 *
+		 * The tree is the one of RFC 6962, section 2.1, so that any implementation of it can compute and verify the roots:
+		 * - the buffer is split into leaves of leaf_size bytes. The last leaf is shorter if the buffer length is not a multiple of leaf_size. An empty buffer has no leaves;
+		 * - the hash of a leaf is H(0x00 || leaf);
+		 * - the hash of an inner node is H(0x01 || left || right);
+		 * - for n > 1 leaves, the left subtree holds the first k leaves, where k is the largest power of two smaller than n, and the right subtree holds the remaining n - k leaves;
+		 * - the root of a tree without leaves is H(), the digest of the empty string.
+		 *
+		 * The inclusion proofs are the audit paths of RFC 6962, section 2.1.1: the sibling hashes from the leaf up to the root.
+		 */
+		class tree_digest
+		{
+			public:
+
+				/**
+				 * \brief An inclusion proof type.
+				 */
+				typedef std::vector<std::vector<unsigned char> > proof_type;
+
+				/**
+				 * \brief The default leaf size.
+				 */
+				static const size_t default_leaf_size;
+
+				/**
+				 * \brief Verify an inclusion proof.
+				 * \param algorithm The message digest algorithm of the tree.
+				 * \param root The root of the tree.
+				 * \param root_len The length of root.
+				 * \param leaf The leaf.
+				 * \param leaf_len The length of leaf.
+				 * \param leaf_index The index of the leaf.
+				 * \param leaves_count The count of leaves of the tree.
+				 * \param proof The inclusion proof, as returned by inclusion_proof().
+				 * \return true if proof proves that leaf is the leaf at leaf_index in the tree of root, false otherwise.
+				 */
+				static bool verify_inclusion_proof(const message_digest_algorithm& algorithm, const void* root, size_t root_len, const void* leaf, size_t leaf_len, size_t leaf_index, size_t leaves_count, const proof_type& proof);
+
+				/**
+				 * \brief Compute the tree of a buffer.
+				 * \param data The buffer. Can be NULL only if len is 0.
+				 * \param len The length of data.
+				 * \param algorithm The message digest algorithm to use.
+				 * \param leaf_size The leaf size. If 0, a std::invalid_argument is thrown.
+				 * \param threads_count The maximum count of threads to use. If 0, default_threads_count() is used.
+				 */
+				tree_digest(const void* data, size_t len, const message_digest_algorithm& algorithm, size_t leaf_size = default_leaf_size, unsigned int threads_count = 0);
+
+				/**
+				 * \brief Get the algorithm.
+				 * \return The algorithm.
+				 */
+				message_digest_algorithm algorithm() const;
+
+				/**
+				 * \brief Get the leaf size.
+				 * \return The leaf size.
+				 */
+				size_t leaf_size() const;
+
+				/**
+				 * \brief Get the count of leaves.
+				 * \return The count of leaves.
+				 */
+				size_t leaves_count() const;
+
+				/**
+				 * \brief Get the root.
+				 * \return The root. Its size is algorithm().result_size().
+				 */
+				const std::vector<unsigned char>& root() const;
+
+				/**
+				 * \brief Get the inclusion proof of a leaf.
+				 * \param leaf_index The index of the leaf. Must be lower than leaves_count() or a std::out_of_range is thrown.
+				 * \return The inclusion proof.
+				 */
+				proof_type inclusion_proof(size_t leaf_index) const;
+
+			private:
+
+				message_digest_algorithm m_algorithm;
+				size_t m_leaf_size;
+				std::vector<std::vector<unsigned char> > m_levels;
+				std::vector<unsigned char> m_root;
+		};
+
+		inline message_digest_algorithm tree_digest::algorithm() const
+		{
+			return m_algorithm;
+		}
+
+		inline size_t tree_digest::leaf_size() const
+		{
+			return m_leaf_size;
+		}
+
+		inline size_t tree_digest::leaves_count() const
+		{
+			return m_levels.empty() ? 0 : m_levels.front().size() / m_algorithm.result_size();
+		}
+
+		inline const std::vector<unsigned char>& tree_digest::root() const
+		{
+			return m_root;
+		}
+	}
+}
+
+#endif /* CRYPTOPLUS_HASH_TREE_DIGEST_HPP */
@@ -147,8 +147,6 @@ namespace cryptoplus
 	template <typename T, typename U> void operator==(const nullable<T>& lhs,const nullable<U>& rhs)
 	{
 		lhs.this_type_does_not_support_comparisons();
-
-		return false;
 	}
 
 	/**
@@ -160,8 +158,6 @@ namespace cryptoplus
 	template <typename T, typename U> void operator!=(const nullable<T>& lhs,const nullable<U>& rhs)
 	{
 		lhs.this_type_does_not_support_comparisons();
-
-		return false;
 	}
 }
 
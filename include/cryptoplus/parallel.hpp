@@ -0,0 +1,216 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file parallel.hpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Parallel execution helpers.
+ */
+
+#ifndef CRYPTOPLUS_PARALLEL_HPP
+#define CRYPTOPLUS_PARALLEL_HPP
+
+#include "error/cryptographic_exception.hpp"
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <string>
+#include <stdexcept>
+
+namespace cryptoplus
+{
+	/**
+	 * \brief Get the default count of threads to use for parallel operations.
+	 * \return The count of hardware threads, or 1 if it cannot be determined.
+	 */
+	unsigned int default_threads_count();
+
+	/**
+	 * \brief Call a function for each index of a range, using several threads.
+	 * \param count The count of indexes. function is called with every index in [0, count).
+	 * \param threads_count The maximum count of threads to use, including the calling thread. If 0, default_threads_count() is used.
+	 * \param function The function to call. Must be callable as function(size_t). It is called concurrently from several threads and must be thread-safe for distinct indexes.
+	 *
+	 * The calling thread takes part in the work and the call returns once every index was processed.
+	 *
+	 * If function throws for one index, the other indexes are still processed and the exception is then rethrown in the calling thread: a cryptographic_exception keeps its error code, any other std::exception is rethrown as a std::runtime_error with the same message.
+	 *
+	 * \warning With OpenSSL versions prior to 1.1.0, the application must have set the OpenSSL locking callbacks (see CRYPTO_set_locking_callback()) before any parallel operation takes place.
+	 */
+	template <typename Function>
+	void parallel_for(size_t count, unsigned int threads_count, Function function);
+
+	/// \cond PRIVATE
+	namespace detail
+	{
+		class parallel_failure
+		{
+			public:
+
+				parallel_failure() : m_failed(false), m_err(0) {}
+
+				void set(error::error_type err, const std::string& what)
+				{
+					boost::mutex::scoped_lock lock(m_mutex);
+
+					if (!m_failed)
+					{
+						m_failed = true;
+						m_err = err;
+						m_what = what;
+					}
+				}
+
+				void rethrow() const
+				{
+					if (m_failed)
+					{
+						if (m_err != 0)
+						{
+							throw error::cryptographic_exception(m_err);
+						}
+
+						throw std::runtime_error(m_what);
+					}
+				}
+
+			private:
+
+				boost::mutex m_mutex;
+				bool m_failed;
+				error::error_type m_err;
+				std::string m_what;
+		};
+
+		template <typename Function>
+		class parallel_worker
+		{
+			public:
+
+				parallel_worker(size_t first, size_t count, size_t stride, Function& function, parallel_failure& failure) :
+					m_first(first), m_count(count), m_stride(stride), m_function(function), m_failure(failure)
+				{
+				}
+
+				void operator()()
+				{
+					for (size_t index = m_first; index < m_count; index += m_stride)
+					{
+						try
+						{
+							m_function(index);
+						}
+						catch (error::cryptographic_exception& ex)
+						{
+							m_failure.set(ex.err(), ex.what());
+						}
+						catch (std::exception& ex)
+						{
+							m_failure.set(0, ex.what());
+						}
+					}
+				}
+
+			private:
+
+				size_t m_first;
+				size_t m_count;
+				size_t m_stride;
+				Function& m_function;
+				parallel_failure& m_failure;
+		};
+	}
+	/// \endcond
+
+	inline unsigned int default_threads_count()
+	{
+		const unsigned int result = boost::thread::hardware_concurrency();
+
+		return (result > 0) ? result : 1;
+	}
+
+	template <typename Function>
+	inline void parallel_for(size_t count, unsigned int threads_count, Function function)
+	{
+		if (threads_count == 0)
+		{
+			threads_count = default_threads_count();
+		}
+
+		if (threads_count > count)
+		{
+			threads_count = static_cast<unsigned int>(count);
+		}
+
+		if (threads_count <= 1)
+		{
+			for (size_t index = 0; index < count; ++index)
+			{
+				function(index);
+			}
+
+			return;
+		}
+
+		detail::parallel_failure failure;
+		boost::thread_group threads;
+
+		try
+		{
+			for (unsigned int i = 1; i < threads_count; ++i)
+			{
+				threads.create_thread(detail::parallel_worker<Function>(i, count, threads_count, function, failure));
+			}
+		}
+		catch (...)
+		{
+			threads.join_all();
+
+			throw;
+		}
+
+		detail::parallel_worker<Function>(0, count, threads_count, function, failure)();
+
+		threads.join_all();
+
+		failure.rethrow();
+	}
+}
+
+#endif /* CRYPTOPLUS_PARALLEL_HPP */
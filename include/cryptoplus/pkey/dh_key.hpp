@@ -284,11 +284,27 @@ namespace cryptoplus
 		}
 		inline bn::bignum dh_key::private_key() const
 		{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+			const BIGNUM* priv_key = NULL;
+
+			DH_get0_key(raw(), NULL, &priv_key);
+
+			return const_cast<BIGNUM*>(priv_key);
+#else
 			return raw()->priv_key;
+#endif
 		}
 		inline bn::bignum dh_key::public_key() const
 		{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+			const BIGNUM* pub_key = NULL;
+
+			DH_get0_key(raw(), &pub_key, NULL);
+
+			return const_cast<BIGNUM*>(pub_key);
+#else
 			return raw()->pub_key;
+#endif
 		}
 		inline size_t dh_key::size() const
 		{
@@ -561,7 +561,11 @@ namespace cryptoplus
 		}
 		inline int pkey::type() const
 		{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+			return EVP_PKEY_base_id(ptr().get());
+#else
 			return EVP_PKEY_type(ptr()->type);
+#endif
 		}
 		inline bool pkey::is_rsa() const
 		{
@@ -179,6 +179,7 @@ namespace cryptoplus
 		 */
 		size_t write_seed_file(const std::string& file);
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
 		/**
 		 * \brief Query the entropy gathering daemon for 255 bytes.
 		 * \param path The EGD socket path.
@@ -202,6 +203,7 @@ namespace cryptoplus
 		 * \return The count of bytes read.
 		 */
 		size_t egd_query(const std::string& path, void* buf, size_t cnt);
+#endif
 
 		/**
 		 * \brief Clean up the PRNG.
@@ -303,6 +305,7 @@ namespace cryptoplus
 			return result;
 		}
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
 		inline size_t egd_query(const std::string& path)
 		{
 			int result = RAND_egd(path.c_str());
@@ -329,6 +332,7 @@ namespace cryptoplus
 
 			return result;
 		}
+#endif
 
 		inline void cleanup()
 		{
@@ -59,6 +59,9 @@
 #include <openssl/x509.h>
 #include <openssl/pem.h>
 
+#include <iterator>
+#include <cstddef>
+
 namespace cryptoplus
 {
 	namespace x509
@@ -89,10 +92,35 @@ namespace cryptoplus
 				/**
 				 * \brief An iterator class.
 				 */
-				class iterator : public std::iterator<std::random_access_iterator_tag, wrapped_value_type>
+				class iterator
 				{
 					public:
 
+						/**
+						 * \brief The iterator category.
+						 */
+						typedef std::random_access_iterator_tag iterator_category;
+
+						/**
+						 * \brief The value type.
+						 */
+						typedef wrapped_value_type value_type;
+
+						/**
+						 * \brief The difference type.
+						 */
+						typedef std::ptrdiff_t difference_type;
+
+						/**
+						 * \brief The pointer type.
+						 */
+						typedef value_type* pointer;
+
+						/**
+						 * \brief The reference type.
+						 */
+						typedef value_type& reference;
+
 						/**
 						 * \brief Create an empty iterator.
 						 */
@@ -0,0 +1,101 @@
+/**
+ * \file aead.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief An AEAD cipher sample file.
+ */
+
+#include <cryptoplus/cryptoplus.hpp>
+#include <cryptoplus/cipher/cipher_context.hpp>
+#include <cryptoplus/random/random.hpp>
+#include <cryptoplus/error/error_strings.hpp>
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+template <typename T>
+std::string to_hex(const T& begin, const T& end)
+{
+	std::ostringstream oss;
+
+	for (T i = begin; i != end; ++i)
+	{
+		oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(*i);
+	}
+
+	return oss.str();
+}
+
+void aead(const std::string& name, size_t iv_len, size_t tag_len)
+{
+	try
+	{
+		cryptoplus::cipher::cipher_algorithm algorithm(name);
+
+		const std::string aad = "header";
+		const std::string message = "some secret message";
+		std::vector<unsigned char> buf(message.begin(), message.end());
+		std::vector<unsigned char> key = cryptoplus::random::get_random_bytes<unsigned char>(algorithm.key_length());
+		std::vector<unsigned char> iv = cryptoplus::random::get_random_bytes<unsigned char>(iv_len);
+		std::vector<unsigned char> tag(tag_len);
+
+		std::cout << "Cipher: " << name << std::endl;
+		std::cout << "Key: " << to_hex(key.begin(), key.end()) << std::endl;
+		std::cout << "IV: " << to_hex(iv.begin(), iv.end()) << std::endl;
+		std::cout << "AAD: " << aad << std::endl;
+		std::cout << "Message: " << message << std::endl;
+
+		cryptoplus::cipher::cipher_context ctx;
+		cryptoplus::cipher::cipher_context dctx;
+
+		ctx.aead_initialize(algorithm, cryptoplus::cipher::cipher_context::encrypt, &key[0], key.size(), iv.size(), tag.size());
+		dctx.aead_initialize(algorithm, cryptoplus::cipher::cipher_context::decrypt, &key[0], key.size(), iv.size(), tag.size());
+		ctx.aead_encrypt(&buf[0], buf.size(), &iv[0], iv.size(), aad.c_str(), aad.size(), &tag[0], tag.size());
+
+		std::cout << "Ciphertext: " << to_hex(buf.begin(), buf.end()) << std::endl;
+		std::cout << "Tag: " << to_hex(tag.begin(), tag.end()) << std::endl;
+
+		if (dctx.aead_decrypt(&buf[0], buf.size(), &iv[0], iv.size(), aad.c_str(), aad.size(), &tag[0], tag.size()))
+		{
+			std::cout << "Decrypted: " << std::string(buf.begin(), buf.end()) << std::endl;
+		}
+		else
+		{
+			std::cout << "Authentication failed" << std::endl;
+		}
+
+		ctx.aead_encrypt(&buf[0], buf.size(), &iv[0], iv.size(), aad.c_str(), aad.size(), &tag[0], tag.size());
+		buf[0] ^= 0x01;
+
+		std::cout << "Tampered ciphertext is " << (dctx.aead_decrypt(&buf[0], buf.size(), &iv[0], iv.size(), aad.c_str(), aad.size(), &tag[0], tag.size()) ? "accepted (THIS IS A BUG)" : "rejected") << std::endl;
+	}
+	catch (std::exception& ex)
+	{
+		std::cerr << name << ": " << ex.what() << std::endl;
+	}
+
+	std::cout << std::endl;
+}
+
+int main()
+{
+	cryptoplus::crypto_initializer crypto_initializer;
+	cryptoplus::algorithms_initializer algorithms_initializer;
+	cryptoplus::error::error_strings_initializer error_strings_initializer;
+
+	std::cout << "AEAD sample" << std::endl;
+	std::cout << "===========" << std::endl;
+	std::cout << std::endl;
+
+	aead("id-aes128-GCM", 12, 16);
+	aead("id-aes256-GCM", 12, 16);
+	aead("id-aes128-CCM", 12, 16);
+	aead("id-aes256-CCM", 13, 8);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	aead("ChaCha20-Poly1305", 12, 16);
+#endif
+
+	return EXIT_SUCCESS;
+}
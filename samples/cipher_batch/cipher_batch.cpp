@@ -0,0 +1,120 @@
+/**
+ * \file cipher_batch.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief A cipher batch benchmark sample file.
+ */
+
+#include <cryptoplus/cryptoplus.hpp>
+#include <cryptoplus/cipher/cipher_context.hpp>
+#include <cryptoplus/random/random.hpp>
+#include <cryptoplus/error/error_strings.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const size_t packets_count = 20000;
+	const unsigned int rounds = 10;
+
+	double packets_per_second(const boost::posix_time::time_duration& duration)
+	{
+		return static_cast<double>(packets_count) * rounds * 1000000.0 / static_cast<double>(duration.total_microseconds());
+	}
+}
+
+void cipher_batch(const std::string& name, size_t packet_size)
+{
+	using cryptoplus::cipher::cipher_algorithm;
+	using cryptoplus::cipher::cipher_context;
+
+	try
+	{
+		cipher_algorithm algorithm(name);
+
+		const std::vector<unsigned char> key = cryptoplus::random::get_random_bytes<unsigned char>(algorithm.key_length());
+		const std::vector<unsigned char> ivs = cryptoplus::random::get_random_bytes<unsigned char>(algorithm.iv_length() * packets_count);
+		const std::vector<unsigned char> input = cryptoplus::random::get_random_bytes<unsigned char>(packet_size * packets_count);
+
+		const size_t out_packet_size = packet_size + algorithm.block_size();
+		std::vector<unsigned char> loop_output(out_packet_size * packets_count);
+		std::vector<unsigned char> batch_output(out_packet_size * packets_count);
+
+		// The per-packet loop, as it has to be done without process_packets().
+		cipher_context ctx;
+
+		boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+		for (unsigned int round = 0; round < rounds; ++round)
+		{
+			for (size_t i = 0; i < packets_count; ++i)
+			{
+				unsigned char* const out = &loop_output[i * out_packet_size];
+
+				ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &ivs[i * algorithm.iv_length()], algorithm.iv_length());
+				const size_t cnt = ctx.update(out, out_packet_size, &input[i * packet_size], packet_size);
+				ctx.finalize(out + cnt, out_packet_size - cnt);
+			}
+		}
+
+		const boost::posix_time::time_duration loop_duration = boost::posix_time::microsec_clock::universal_time() - start;
+
+		// The batched version.
+		std::vector<cipher_context::packet> packets(packets_count);
+
+		for (size_t i = 0; i < packets_count; ++i)
+		{
+			packets[i].iv = &ivs[i * algorithm.iv_length()];
+			packets[i].in = &input[i * packet_size];
+			packets[i].in_len = packet_size;
+			packets[i].out = &batch_output[i * out_packet_size];
+			packets[i].out_len = out_packet_size;
+		}
+
+		start = boost::posix_time::microsec_clock::universal_time();
+
+		for (unsigned int round = 0; round < rounds; ++round)
+		{
+			ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &ivs[0], algorithm.iv_length());
+			ctx.process_packets(&packets[0], packets.size());
+		}
+
+		const boost::posix_time::time_duration batch_duration = boost::posix_time::microsec_clock::universal_time() - start;
+
+		std::cout << std::setw(12) << std::left << name << std::setw(8) << std::right << packet_size << " bytes: ";
+		std::cout << std::fixed << std::setprecision(0);
+		std::cout << "loop: " << std::setw(10) << packets_per_second(loop_duration) << " packets/s, ";
+		std::cout << "batch: " << std::setw(10) << packets_per_second(batch_duration) << " packets/s";
+		std::cout << (loop_output == batch_output ? "" : " (MISMATCH)") << std::endl;
+	}
+	catch (cryptoplus::error::cryptographic_exception& ex)
+	{
+		std::cerr << name << ": " << ex.what() << std::endl;
+	}
+}
+
+int main()
+{
+	cryptoplus::crypto_initializer crypto_initializer;
+	cryptoplus::algorithms_initializer algorithms_initializer;
+	cryptoplus::error::error_strings_initializer error_strings_initializer;
+
+	std::cout << "Cipher batch sample" << std::endl;
+	std::cout << "===================" << std::endl;
+	std::cout << std::endl;
+
+	const size_t packet_sizes[] = { 64, 512, 1400 };
+
+	for (size_t i = 0; i < sizeof(packet_sizes) / sizeof(packet_sizes[0]); ++i)
+	{
+		cipher_batch("AES-128-CBC", packet_sizes[i]);
+		cipher_batch("AES-256-CBC", packet_sizes[i]);
+		cipher_batch("AES-128-CTR", packet_sizes[i]);
+	}
+
+	return EXIT_SUCCESS;
+}
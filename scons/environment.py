@@ -60,6 +60,9 @@ class Environment(SConsEnvironment):
 
         self['CXXFLAGS'] += ['-Wall', '-Wextra', '-Werror', '-pedantic', '-Wredundant-decls', '-O3', '-Wno-uninitialized', '-Wno-long-long', '-Wshadow']
 
+        # The library wraps the legacy low-level APIs (RSA, DSA, DH, HMAC_CTX...) on purpose
+        self['CXXFLAGS'].append('-DOPENSSL_SUPPRESS_DEPRECATED')
+
         # Members
         if self['arch'] == '32':
             self.__libdir = 'lib'
@@ -92,6 +95,12 @@ class Environment(SConsEnvironment):
 
                 self['LIBPATH'].append(os.path.join(self['boost_path'], 'lib'))
 
+        # The Boost libraries to link with
+        if sys.platform == 'win32':
+            self['boost_libs'] = ['boost_%s-%s-%s' % (lib, self['boost_lib_suffix'], self['boost_version']) for lib in ['thread', 'system']]
+        else:
+            self['boost_libs'] = ['boost_thread', 'boost_system']
+
     def Libraries(self, module, major, minor, source, **kw):
 
         shared_source = self.SharedObject(source, **kw)
@@ -0,0 +1,232 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file authenticated_cipher.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief An encrypt-then-MAC authenticated cipher class.
+ */
+
+#include "cipher/authenticated_cipher.hpp"
+
+#include <openssl/crypto.h>
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			void check_tag_length(const hash::message_digest_algorithm& mac_algorithm, size_t tag_len)
+			{
+				if ((tag_len == 0) || (tag_len > mac_algorithm.result_size()))
+				{
+					throw std::invalid_argument("tag_len");
+				}
+			}
+		}
+
+		// Small enough for the input and the output of a chunk to stay in the L1 cache, large enough to amortize the calls.
+		const size_t authenticated_cipher::chunk_size = 4096;
+
+		authenticated_cipher::authenticated_cipher(const cipher_algorithm& _algorithm, const void* key, size_t key_len, const hash::message_digest_algorithm& _mac_algorithm, const void* mac_key, size_t mac_key_len) :
+			m_algorithm(_algorithm),
+			m_mac_algorithm(_mac_algorithm)
+		{
+			assert(key);
+			assert(mac_key);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+			if (m_algorithm.is_aead())
+			{
+				throw std::invalid_argument("algorithm");
+			}
+#endif
+
+			if (mac_key_len == 0)
+			{
+				throw std::invalid_argument("mac_key_len");
+			}
+
+			// The ivs are given with each message.
+			m_encrypt_context.initialize(m_algorithm, cipher_context::encrypt, key, key_len, NULL, m_algorithm.iv_length());
+			m_decrypt_context.initialize(m_algorithm, cipher_context::decrypt, key, key_len, NULL, m_algorithm.iv_length());
+			m_hmac_context.initialize(mac_key, mac_key_len, &m_mac_algorithm);
+		}
+
+		size_t authenticated_cipher::encrypt(void* out, size_t out_len, const void* in, size_t in_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* tag, size_t tag_len)
+		{
+			assert(out);
+			assert(in || (in_len == 0));
+			assert(tag);
+			assert(out_len >= in_len + m_algorithm.block_size());
+
+			check_tag_length(m_mac_algorithm, tag_len);
+
+			if (iv_len != m_algorithm.iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			EVP_CIPHER_CTX& ctx = m_encrypt_context.raw();
+			unsigned char* const cout = static_cast<unsigned char*>(out);
+			const unsigned char* const cin = static_cast<const unsigned char*>(in);
+			size_t result = 0;
+			int len = 0;
+
+			error::throw_error_if_not(EVP_CipherInit_ex(&ctx, NULL, NULL, NULL, static_cast<const unsigned char*>(iv), -1) != 0);
+			start_mac(iv, iv_len, aad, aad_len);
+
+			// Each chunk of ciphertext is authenticated while it is still hot in the cache.
+			for (size_t offset = 0; offset < in_len; offset += chunk_size)
+			{
+				const size_t cnt = std::min(chunk_size, in_len - offset);
+
+				error::throw_error_if_not(EVP_CipherUpdate(&ctx, cout + result, &len, cin + offset, static_cast<int>(cnt)) != 0);
+				m_hmac_context.update(cout + result, static_cast<size_t>(len));
+
+				result += static_cast<size_t>(len);
+			}
+
+			error::throw_error_if_not(EVP_CipherFinal_ex(&ctx, cout + result, &len) != 0);
+			m_hmac_context.update(cout + result, static_cast<size_t>(len));
+
+			result += static_cast<size_t>(len);
+
+			unsigned char mac[EVP_MAX_MD_SIZE];
+
+			finish_mac(mac, aad_len);
+
+			std::copy(mac, mac + tag_len, static_cast<unsigned char*>(tag));
+
+			static_cast<void>(out_len);
+
+			return result;
+		}
+
+		bool authenticated_cipher::decrypt(void* out, size_t out_len, const void* in, size_t in_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, const void* tag, size_t tag_len, size_t* len)
+		{
+			assert(out);
+			assert(in || (in_len == 0));
+			assert(tag);
+			assert(len);
+			assert(out_len >= in_len + m_algorithm.block_size());
+
+			check_tag_length(m_mac_algorithm, tag_len);
+
+			if (iv_len != m_algorithm.iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			EVP_CIPHER_CTX& ctx = m_decrypt_context.raw();
+			unsigned char* const cout = static_cast<unsigned char*>(out);
+			const unsigned char* const cin = static_cast<const unsigned char*>(in);
+			size_t result = 0;
+			int ilen = 0;
+
+			error::throw_error_if_not(EVP_CipherInit_ex(&ctx, NULL, NULL, NULL, static_cast<const unsigned char*>(iv), -1) != 0);
+			start_mac(iv, iv_len, aad, aad_len);
+
+			// Each chunk of ciphertext is authenticated then decrypted while it is still hot in the cache.
+			for (size_t offset = 0; offset < in_len; offset += chunk_size)
+			{
+				const size_t cnt = std::min(chunk_size, in_len - offset);
+
+				m_hmac_context.update(cin + offset, cnt);
+				error::throw_error_if_not(EVP_CipherUpdate(&ctx, cout + result, &ilen, cin + offset, static_cast<int>(cnt)) != 0);
+
+				result += static_cast<size_t>(ilen);
+			}
+
+			unsigned char mac[EVP_MAX_MD_SIZE];
+
+			finish_mac(mac, aad_len);
+
+			if (CRYPTO_memcmp(mac, tag, tag_len) != 0)
+			{
+				// With padding, the cipher may have written a held-back block past result: cleanse all it could have written.
+				OPENSSL_cleanse(out, std::min(out_len, in_len + m_algorithm.block_size()));
+
+				return false;
+			}
+
+			error::throw_error_if_not(EVP_CipherFinal_ex(&ctx, cout + result, &ilen) != 0);
+
+			*len = result + static_cast<size_t>(ilen);
+
+			return true;
+		}
+
+		void authenticated_cipher::start_mac(const void* iv, size_t iv_len, const void* aad, size_t aad_len)
+		{
+			// The HMAC key is kept: only the inner and outer states are reset.
+			m_hmac_context.initialize(NULL, 0, NULL);
+
+			if (aad_len > 0)
+			{
+				m_hmac_context.update(aad, aad_len);
+			}
+
+			if (iv_len > 0)
+			{
+				m_hmac_context.update(iv, iv_len);
+			}
+		}
+
+		void authenticated_cipher::finish_mac(unsigned char* mac, size_t aad_len)
+		{
+			unsigned char aad_bits[8];
+			boost::uint64_t value = static_cast<boost::uint64_t>(aad_len) * 8;
+
+			for (size_t i = sizeof(aad_bits); i-- > 0; value >>= 8)
+			{
+				aad_bits[i] = static_cast<unsigned char>(value & 0xff);
+			}
+
+			m_hmac_context.update(aad_bits, sizeof(aad_bits));
+			m_hmac_context.finalize(mac, EVP_MAX_MD_SIZE);
+		}
+	}
+}
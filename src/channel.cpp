@@ -0,0 +1,505 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file channel.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A secure datagram channel class.
+ */
+
+#include "cipher/channel.hpp"
+
+#include "hash/hmac_context.hpp"
+
+#include <openssl/crypto.h>
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			const size_t bits_per_word = 32;
+			const size_t sequence_size = 8;
+			const size_t aead_tag_size = 16;
+
+			void write_sequence(unsigned char* buf, boost::uint64_t sequence)
+			{
+				for (size_t i = 0; i < sequence_size; ++i)
+				{
+					buf[i] = static_cast<unsigned char>((sequence >> (8 * (sequence_size - 1 - i))) & 0xff);
+				}
+			}
+
+			boost::uint64_t read_sequence(const unsigned char* buf)
+			{
+				boost::uint64_t result = 0;
+
+				for (size_t i = 0; i < sequence_size; ++i)
+				{
+					result = (result << 8) | buf[i];
+				}
+
+				return result;
+			}
+
+			// Each word holds the block number of its sequence numbers in its high half and their bits in its low half.
+			boost::uint32_t word_block(boost::uint64_t word)
+			{
+				return static_cast<boost::uint32_t>(word >> 32);
+			}
+
+			boost::uint64_t make_word(boost::uint32_t block, boost::uint64_t bits)
+			{
+				return (static_cast<boost::uint64_t>(block) << 32) | bits;
+			}
+
+			// Compare two block numbers, taking wrapping into account.
+			bool is_newer_block(boost::uint32_t block, boost::uint32_t reference)
+			{
+				return (static_cast<boost::uint32_t>(block - reference) - 1) < 0x7fffffff;
+			}
+		}
+
+		replay_window::replay_window(size_t _size) :
+			m_size((_size + bits_per_word - 1) / bits_per_word * bits_per_word),
+			m_words_count(m_size / bits_per_word + 1),
+			m_words(),
+			m_highest(0)
+		{
+			if (_size == 0)
+			{
+				throw std::invalid_argument("size");
+			}
+
+			// The extra word holds the block being filled while the oldest one is still within the window.
+			m_words.reset(new boost::atomic<boost::uint64_t>[m_words_count]);
+
+			for (size_t i = 0; i < m_words_count; ++i)
+			{
+				m_words[i].store(0, boost::memory_order_relaxed);
+			}
+
+			boost::atomic_thread_fence(boost::memory_order_release);
+		}
+
+		bool replay_window::is_too_old(boost::uint64_t sequence) const
+		{
+			const boost::uint64_t _highest = highest();
+
+			return (_highest >= m_size) && (sequence <= _highest - m_size);
+		}
+
+		bool replay_window::check(boost::uint64_t sequence) const
+		{
+			if (is_too_old(sequence))
+			{
+				return false;
+			}
+
+			const boost::uint32_t block = static_cast<boost::uint32_t>(sequence / bits_per_word);
+			const boost::uint64_t bit = static_cast<boost::uint64_t>(1) << (sequence % bits_per_word);
+			const boost::uint64_t word = m_words[(sequence / bits_per_word) % m_words_count].load(boost::memory_order_acquire);
+
+			if (word_block(word) == block)
+			{
+				return ((word & bit) == 0);
+			}
+
+			return is_newer_block(block, word_block(word));
+		}
+
+		bool replay_window::accept(boost::uint64_t sequence)
+		{
+			if (is_too_old(sequence))
+			{
+				return false;
+			}
+
+			const boost::uint32_t block = static_cast<boost::uint32_t>(sequence / bits_per_word);
+			const boost::uint64_t bit = static_cast<boost::uint64_t>(1) << (sequence % bits_per_word);
+			boost::atomic<boost::uint64_t>& word = m_words[(sequence / bits_per_word) % m_words_count];
+			boost::uint64_t current = word.load(boost::memory_order_acquire);
+			boost::uint64_t next;
+
+			do
+			{
+				if (word_block(current) == block)
+				{
+					if ((current & bit) != 0)
+					{
+						return false;
+					}
+
+					next = current | bit;
+				}
+				else if (is_newer_block(block, word_block(current)))
+				{
+					// The word holds sequence numbers that left the window: recycle it.
+					next = make_word(block, bit);
+				}
+				else
+				{
+					return false;
+				}
+			}
+			while (!word.compare_exchange_weak(current, next, boost::memory_order_acq_rel, boost::memory_order_acquire));
+
+			boost::uint64_t _highest = m_highest.load(boost::memory_order_relaxed);
+
+			while ((sequence > _highest) && !m_highest.compare_exchange_weak(_highest, sequence, boost::memory_order_relaxed))
+			{
+			}
+
+			return true;
+		}
+
+		class channel::state : public boost::noncopyable
+		{
+			public:
+
+				cipher_context encrypt_context;
+				cipher_context decrypt_context;
+				hash::hmac_context hmac;
+		};
+
+		class channel::state_guard : public boost::noncopyable
+		{
+			public:
+
+				explicit state_guard(channel& _channel) :
+					m_channel(_channel),
+					m_state(_channel.acquire_state())
+				{
+				}
+
+				~state_guard()
+				{
+					m_channel.release_state(m_state);
+				}
+
+				state* operator->() const
+				{
+					return m_state;
+				}
+
+			private:
+
+				channel& m_channel;
+				state* m_state;
+		};
+
+		const size_t channel::header_size = sequence_size;
+
+		const size_t channel::default_window_size = 2048;
+
+		channel::channel(const cipher_algorithm& _algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t window_size) :
+			m_algorithm(_algorithm),
+			m_mac_algorithm(static_cast<const EVP_MD*>(NULL)),
+			m_key(static_cast<const unsigned char*>(key), static_cast<const unsigned char*>(key) + key_len),
+			m_iv(static_cast<const unsigned char*>(iv), static_cast<const unsigned char*>(iv) + iv_len),
+			m_tag_size(aead_tag_size),
+			m_sequence(0),
+			m_window(window_size),
+			m_free_states(0)
+		{
+			assert(key);
+			assert(iv);
+
+			if (!m_algorithm.is_aead())
+			{
+				throw std::invalid_argument("algorithm");
+			}
+
+			if ((iv_len < sequence_size) || (iv_len > EVP_MAX_IV_LENGTH))
+			{
+				throw std::invalid_argument("iv_len");
+			}
+
+			// Check the key and warm the pool up.
+			release_state(acquire_state());
+		}
+
+		channel::channel(const cipher_algorithm& _algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, const hash::message_digest_algorithm& mac_algorithm, const void* mac_key, size_t mac_key_len, size_t window_size) :
+			m_algorithm(_algorithm),
+			m_mac_algorithm(mac_algorithm),
+			m_key(static_cast<const unsigned char*>(key), static_cast<const unsigned char*>(key) + key_len),
+			m_iv(static_cast<const unsigned char*>(iv), static_cast<const unsigned char*>(iv) + iv_len),
+			m_mac_key(static_cast<const unsigned char*>(mac_key), static_cast<const unsigned char*>(mac_key) + mac_key_len),
+			m_tag_size(mac_algorithm.result_size()),
+			m_sequence(0),
+			m_window(window_size),
+			m_free_states(0)
+		{
+			assert(key);
+			assert(iv);
+			assert(mac_key);
+
+			if (m_algorithm.mode() != EVP_CIPH_CTR_MODE)
+			{
+				throw std::invalid_argument("algorithm");
+			}
+
+			if (iv_len != m_algorithm.iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			if (mac_key_len == 0)
+			{
+				throw std::invalid_argument("mac_key_len");
+			}
+
+			// Check the key and warm the pool up.
+			release_state(acquire_state());
+		}
+
+		channel::~channel()
+		{
+			OPENSSL_cleanse(&m_key[0], m_key.size());
+
+			if (!m_mac_key.empty())
+			{
+				OPENSSL_cleanse(&m_mac_key[0], m_mac_key.size());
+			}
+		}
+
+		size_t channel::seal(void* out, size_t out_len, const void* in, size_t in_len)
+		{
+			assert(out);
+			assert(in || (in_len == 0));
+
+			if (out_len < in_len + overhead())
+			{
+				throw std::runtime_error("out_len");
+			}
+
+			const boost::uint64_t sequence = next_sequence();
+			unsigned char* const cout = static_cast<unsigned char*>(out);
+			unsigned char* const data = cout + header_size;
+			unsigned char nonce[EVP_MAX_IV_LENGTH];
+
+			// in may overlap the header: move it first.
+			if (in_len > 0)
+			{
+				std::memmove(data, in, in_len);
+			}
+
+			write_sequence(cout, sequence);
+			get_nonce(nonce, sequence);
+
+			state_guard guard(*this);
+
+			if (m_algorithm.is_aead())
+			{
+				guard->encrypt_context.aead_encrypt(data, in_len, nonce, m_iv.size(), cout, header_size, data + in_len, m_tag_size);
+			}
+			else
+			{
+				guard->encrypt_context.set_iv(nonce, m_iv.size());
+				guard->encrypt_context.update_in_place(data, in_len);
+
+				// The HMAC key is kept: only the inner and outer states are reset.
+				guard->hmac.initialize(NULL, 0, NULL);
+				guard->hmac.update(cout, header_size + in_len);
+				guard->hmac.finalize(data + in_len, m_tag_size);
+			}
+
+			return in_len + overhead();
+		}
+
+		channel::open_result channel::open(void* out, size_t out_len, const void* in, size_t in_len, size_t* len)
+		{
+			assert(out);
+			assert(in || (in_len == 0));
+			assert(len);
+
+			if (in_len < overhead())
+			{
+				return malformed;
+			}
+
+			const size_t data_len = in_len - overhead();
+
+			// The datagram comes from the network: it may be larger than anything the caller expects.
+			if (out_len < data_len)
+			{
+				return malformed;
+			}
+
+			const unsigned char* const cin = static_cast<const unsigned char*>(in);
+			unsigned char* const cout = static_cast<unsigned char*>(out);
+			unsigned char header[sequence_size];
+			unsigned char tag[EVP_MAX_MD_SIZE];
+			unsigned char nonce[EVP_MAX_IV_LENGTH];
+
+			// out may overlap in: keep a copy of the header and of the tag.
+			std::memcpy(header, cin, header_size);
+			std::memcpy(tag, cin + header_size + data_len, m_tag_size);
+
+			const boost::uint64_t sequence = read_sequence(header);
+
+			if (!m_window.check(sequence))
+			{
+				return replayed;
+			}
+
+			get_nonce(nonce, sequence);
+
+			state_guard guard(*this);
+
+			if (m_algorithm.is_aead())
+			{
+				std::memmove(cout, cin + header_size, data_len);
+
+				if (!guard->decrypt_context.aead_decrypt(cout, data_len, nonce, m_iv.size(), header, header_size, tag, m_tag_size))
+				{
+					return forged;
+				}
+			}
+			else
+			{
+				unsigned char mac[EVP_MAX_MD_SIZE];
+
+				guard->hmac.initialize(NULL, 0, NULL);
+				guard->hmac.update(cin, header_size + data_len);
+				guard->hmac.finalize(mac, sizeof(mac));
+
+				if (CRYPTO_memcmp(mac, tag, m_tag_size) != 0)
+				{
+					return forged;
+				}
+
+				std::memmove(cout, cin + header_size, data_len);
+
+				guard->decrypt_context.set_iv(nonce, m_iv.size());
+				guard->decrypt_context.update_in_place(cout, data_len);
+			}
+
+			// Another thread may have accepted the same datagram in the meantime.
+			if (!m_window.accept(sequence))
+			{
+				OPENSSL_cleanse(cout, data_len);
+
+				return replayed;
+			}
+
+			*len = data_len;
+
+			return opened;
+		}
+
+		channel::state* channel::acquire_state()
+		{
+			state* result = NULL;
+
+			if (m_free_states.pop(result))
+			{
+				return result;
+			}
+
+			boost::shared_ptr<state> new_state(new state());
+
+			if (m_algorithm.is_aead())
+			{
+				new_state->encrypt_context.aead_initialize(m_algorithm, cipher_context::encrypt, &m_key[0], m_key.size(), m_iv.size(), m_tag_size);
+				new_state->decrypt_context.aead_initialize(m_algorithm, cipher_context::decrypt, &m_key[0], m_key.size(), m_iv.size(), m_tag_size);
+			}
+			else
+			{
+				new_state->encrypt_context.initialize(m_algorithm, cipher_context::encrypt, &m_key[0], m_key.size(), &m_iv[0], m_iv.size());
+				new_state->decrypt_context.initialize(m_algorithm, cipher_context::decrypt, &m_key[0], m_key.size(), &m_iv[0], m_iv.size());
+				new_state->hmac.initialize(&m_mac_key[0], m_mac_key.size(), &m_mac_algorithm);
+			}
+
+			boost::mutex::scoped_lock lock(m_states_mutex);
+
+			// Make sure release_state() never has to allocate.
+			m_free_states.reserve(1);
+			m_states.push_back(new_state);
+
+			return new_state.get();
+		}
+
+		void channel::release_state(state* _state)
+		{
+			m_free_states.push(_state);
+		}
+
+		boost::uint64_t channel::next_sequence()
+		{
+			boost::uint64_t result = m_sequence.load(boost::memory_order_relaxed);
+
+			do
+			{
+				if (result == std::numeric_limits<boost::uint64_t>::max())
+				{
+					throw std::runtime_error("The sequence numbers are exhausted");
+				}
+			}
+			while (!m_sequence.compare_exchange_weak(result, result + 1, boost::memory_order_relaxed));
+
+			return result;
+		}
+
+		void channel::get_nonce(unsigned char* nonce, boost::uint64_t sequence) const
+		{
+			unsigned char buf[sequence_size];
+
+			write_sequence(buf, sequence);
+			std::memcpy(nonce, &m_iv[0], m_iv.size());
+
+			// Counter mode increments the last bytes of the iv: the sequence number must stay out of their way.
+			const size_t offset = m_algorithm.is_aead() ? m_iv.size() - sequence_size : 0;
+
+			for (size_t i = 0; i < sequence_size; ++i)
+			{
+				nonce[offset + i] ^= buf[i];
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,530 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file chunked_container.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A chunked, random-access authenticated encrypted container format.
+ */
+
+#include "cipher/chunked_container.hpp"
+
+#include "random/random.hpp"
+#include "parallel.hpp"
+
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			const unsigned char magic[4] = { 'C', 'P', 'X', 'C' };
+			const unsigned char version = 1;
+
+			const size_t header_size = 24;
+			const size_t nonce_prefix_size = 8;
+			const size_t nonce_size = 12;
+			const size_t tag_size = 16;
+			const size_t index_size = 12;
+
+			const unsigned char chunk_flag = 0;
+			const unsigned char last_chunk_flag = 1;
+			const unsigned char index_flag = 2;
+
+			const boost::uint64_t index_chunk = 0xffffffff;
+
+			void store_uint32(unsigned char* buf, boost::uint32_t value)
+			{
+				for (size_t i = 4; i-- > 0; value >>= 8)
+				{
+					buf[i] = static_cast<unsigned char>(value & 0xff);
+				}
+			}
+
+			void store_uint64(unsigned char* buf, boost::uint64_t value)
+			{
+				for (size_t i = 8; i-- > 0; value >>= 8)
+				{
+					buf[i] = static_cast<unsigned char>(value & 0xff);
+				}
+			}
+
+			boost::uint32_t load_uint32(const unsigned char* buf)
+			{
+				boost::uint32_t result = 0;
+
+				for (size_t i = 0; i < 4; ++i)
+				{
+					result = (result << 8) | buf[i];
+				}
+
+				return result;
+			}
+
+			boost::uint64_t load_uint64(const unsigned char* buf)
+			{
+				boost::uint64_t result = 0;
+
+				for (size_t i = 0; i < 8; ++i)
+				{
+					result = (result << 8) | buf[i];
+				}
+
+				return result;
+			}
+
+			/*
+			 * The nonce and the additional authenticated data of a chunk.
+			 */
+			struct chunk_parameters
+			{
+				unsigned char nonce[nonce_size];
+				unsigned char aad[header_size + 1];
+
+				chunk_parameters(const std::vector<unsigned char>& header, boost::uint64_t index, unsigned char flag)
+				{
+					assert(header.size() == header_size);
+
+					std::memcpy(nonce, &header[header_size - nonce_prefix_size], nonce_prefix_size);
+					store_uint32(nonce + nonce_prefix_size, static_cast<boost::uint32_t>(index));
+
+					std::memcpy(aad, &header[0], header_size);
+					aad[header_size] = flag;
+				}
+			};
+
+			class chunk_sealer
+			{
+				public:
+
+					chunk_sealer(const std::vector<unsigned char>& header, std::vector<boost::shared_ptr<cipher_context> >& contexts, unsigned char* batch, size_t chunk_size, size_t pending, boost::uint64_t first_index, bool final) :
+						m_header(header), m_contexts(contexts), m_batch(batch), m_chunk_size(chunk_size), m_pending(pending), m_first_index(first_index), m_final(final)
+					{
+					}
+
+					void operator()(size_t slot)
+					{
+						const size_t offset = slot * m_chunk_size;
+						const size_t len = std::min(m_chunk_size, m_pending - offset);
+						const bool last = m_final && (offset + len == m_pending);
+						unsigned char* const chunk = m_batch + slot * (m_chunk_size + tag_size);
+
+						const chunk_parameters parameters(m_header, m_first_index + slot, last ? last_chunk_flag : chunk_flag);
+
+						// The tag goes right after the ciphertext, so that the records of a batch are contiguous.
+						m_contexts[slot]->aead_encrypt(chunk, len, parameters.nonce, nonce_size, parameters.aad, sizeof(parameters.aad), chunk + len, tag_size);
+					}
+
+				private:
+
+					const std::vector<unsigned char>& m_header;
+					std::vector<boost::shared_ptr<cipher_context> >& m_contexts;
+					unsigned char* m_batch;
+					size_t m_chunk_size;
+					size_t m_pending;
+					boost::uint64_t m_first_index;
+					bool m_final;
+			};
+
+			void check_chunk_size(size_t chunk_size)
+			{
+				if ((chunk_size == 0) || (chunk_size > chunked_writer::maximum_chunk_size))
+				{
+					throw std::invalid_argument("chunk_size");
+				}
+			}
+
+			long get_file_offset(boost::uint64_t offset)
+			{
+				if (offset > static_cast<boost::uint64_t>(std::numeric_limits<long>::max()))
+				{
+					throw std::runtime_error("The container is too large for this platform");
+				}
+
+				return static_cast<long>(offset);
+			}
+
+			ptrdiff_t get_bio_offset(boost::uint64_t offset)
+			{
+				if (offset > static_cast<boost::uint64_t>(std::numeric_limits<ptrdiff_t>::max()))
+				{
+					throw std::runtime_error("The container is too large for this platform");
+				}
+
+				return static_cast<ptrdiff_t>(offset);
+			}
+		}
+
+		const size_t chunked_writer::default_chunk_size = 64 * 1024;
+
+		// CCM with 12 bytes nonces cannot seal more than 2^24 - 1 bytes at once.
+		const size_t chunked_writer::maximum_chunk_size = 8 * 1024 * 1024;
+
+		chunked_writer::chunked_writer(file _file, const cipher_algorithm& algorithm, const void* key, size_t key_len, size_t chunk_size, unsigned int threads_count) :
+			m_file(_file)
+		{
+			assert(m_file);
+
+			initialize(algorithm, key, key_len, chunk_size, threads_count);
+		}
+
+		chunked_writer::chunked_writer(bio::bio_ptr bio, const cipher_algorithm& algorithm, const void* key, size_t key_len, size_t chunk_size, unsigned int threads_count) :
+			m_bio(bio)
+		{
+			assert(m_bio.raw());
+
+			initialize(algorithm, key, key_len, chunk_size, threads_count);
+		}
+
+		void chunked_writer::write(const void* buf, size_t buf_len)
+		{
+			assert(buf || (buf_len == 0));
+
+			const unsigned char* cbuf = static_cast<const unsigned char*>(buf);
+			const size_t batch_capacity = m_contexts.size() * m_chunk_size;
+
+			while (buf_len > 0)
+			{
+				// A full batch is only flushed once we know more data follows, since its last chunk might otherwise be the last one of the container.
+				if (m_pending == batch_capacity)
+				{
+					flush(false);
+				}
+
+				const size_t slot_offset = m_pending % m_chunk_size;
+				const size_t cnt = std::min(buf_len, m_chunk_size - slot_offset);
+
+				std::memcpy(&m_batch[(m_pending / m_chunk_size) * (m_chunk_size + tag_size) + slot_offset], cbuf, cnt);
+
+				m_pending += cnt;
+				m_size += cnt;
+				cbuf += cnt;
+				buf_len -= cnt;
+			}
+		}
+
+		void chunked_writer::finalize()
+		{
+			flush(true);
+
+			unsigned char index[index_size + tag_size];
+
+			store_uint64(index, m_size);
+			store_uint32(index + 8, static_cast<boost::uint32_t>(m_chunks_count));
+
+			const chunk_parameters parameters(m_header, index_chunk, index_flag);
+
+			m_contexts[0]->aead_encrypt(index, index_size, parameters.nonce, nonce_size, parameters.aad, sizeof(parameters.aad), index + index_size, tag_size);
+
+			write_raw(index, sizeof(index));
+
+			if (m_file)
+			{
+				if (std::fflush(m_file.raw()) != 0)
+				{
+					throw std::runtime_error("Unable to write to the file");
+				}
+			}
+			else
+			{
+				m_bio.flush();
+			}
+		}
+
+		void chunked_writer::initialize(const cipher_algorithm& algorithm, const void* key, size_t key_len, size_t chunk_size, unsigned int threads_count)
+		{
+			check_chunk_size(chunk_size);
+
+			if (threads_count == 0)
+			{
+				threads_count = default_threads_count();
+			}
+
+			m_chunk_size = chunk_size;
+			m_threads_count = threads_count;
+			m_pending = 0;
+			m_chunks_count = 0;
+			m_size = 0;
+
+			// One context per slot of a batch, so that no context is ever shared between threads.
+			m_contexts.resize(threads_count);
+
+			for (size_t i = 0; i < m_contexts.size(); ++i)
+			{
+				m_contexts[i].reset(new cipher_context());
+				m_contexts[i]->aead_initialize(algorithm, cipher_context::encrypt, key, key_len, nonce_size, tag_size);
+			}
+
+			m_batch.resize(m_contexts.size() * (m_chunk_size + tag_size));
+
+			m_header.resize(header_size);
+			std::memcpy(&m_header[0], magic, sizeof(magic));
+			m_header[4] = version;
+			m_header[5] = static_cast<unsigned char>(tag_size);
+			m_header[6] = 0;
+			m_header[7] = 0;
+			store_uint32(&m_header[8], static_cast<boost::uint32_t>(algorithm.type()));
+			store_uint32(&m_header[12], static_cast<boost::uint32_t>(m_chunk_size));
+			random::get_random_bytes(&m_header[header_size - nonce_prefix_size], nonce_prefix_size);
+
+			write_raw(&m_header[0], m_header.size());
+		}
+
+		void chunked_writer::flush(bool final)
+		{
+			if (m_pending == 0)
+			{
+				return;
+			}
+
+			const size_t chunks_count = (m_pending + m_chunk_size - 1) / m_chunk_size;
+
+			if (m_chunks_count + chunks_count >= index_chunk)
+			{
+				throw std::runtime_error("Too many chunks");
+			}
+
+			parallel_for(chunks_count, m_threads_count, chunk_sealer(m_header, m_contexts, &m_batch[0], m_chunk_size, m_pending, m_chunks_count, final));
+
+			write_raw(&m_batch[0], (chunks_count - 1) * (m_chunk_size + tag_size) + (m_pending - (chunks_count - 1) * m_chunk_size) + tag_size);
+
+			m_chunks_count += chunks_count;
+			m_pending = 0;
+		}
+
+		void chunked_writer::write_raw(const void* buf, size_t buf_len)
+		{
+			if (m_file)
+			{
+				if (std::fwrite(buf, 1, buf_len, m_file.raw()) != buf_len)
+				{
+					throw std::runtime_error("Unable to write to the file");
+				}
+			}
+			else
+			{
+				const unsigned char* cbuf = static_cast<const unsigned char*>(buf);
+
+				while (buf_len > 0)
+				{
+					const ptrdiff_t cnt = m_bio.write(cbuf, buf_len);
+
+					error::throw_error_if_not(cnt > 0);
+
+					cbuf += cnt;
+					buf_len -= static_cast<size_t>(cnt);
+				}
+			}
+		}
+
+		chunked_reader::chunked_reader(file _file, const void* key, size_t key_len) :
+			m_file(_file)
+		{
+			assert(m_file);
+
+			if (std::fseek(m_file.raw(), 0, SEEK_END) != 0)
+			{
+				throw std::runtime_error("Unable to seek the file");
+			}
+
+			const long container_size = std::ftell(m_file.raw());
+
+			if (container_size < 0)
+			{
+				throw std::runtime_error("Unable to seek the file");
+			}
+
+			initialize(static_cast<boost::uint64_t>(container_size), key, key_len);
+		}
+
+		chunked_reader::chunked_reader(bio::bio_ptr bio, boost::uint64_t container_size, const void* key, size_t key_len) :
+			m_bio(bio)
+		{
+			assert(m_bio.raw());
+
+			initialize(container_size, key, key_len);
+		}
+
+		size_t chunked_reader::read(boost::uint64_t offset, void* buf, size_t buf_len)
+		{
+			assert(buf || (buf_len == 0));
+
+			unsigned char* cbuf = static_cast<unsigned char*>(buf);
+			size_t result = 0;
+
+			while ((result < buf_len) && (offset < m_size))
+			{
+				const boost::uint64_t index = offset / m_chunk_size;
+				const size_t chunk_offset = static_cast<size_t>(offset % m_chunk_size);
+				const size_t chunk_len = static_cast<size_t>(std::min(static_cast<boost::uint64_t>(m_chunk_size), m_size - index * m_chunk_size));
+
+				load_chunk(index);
+
+				const size_t cnt = std::min(buf_len - result, chunk_len - chunk_offset);
+
+				std::memcpy(cbuf + result, &m_chunk[chunk_offset], cnt);
+
+				result += cnt;
+				offset += cnt;
+			}
+
+			return result;
+		}
+
+		void chunked_reader::initialize(boost::uint64_t container_size, const void* key, size_t key_len)
+		{
+			const std::runtime_error invalid_container("Invalid container");
+
+			if (container_size < header_size + index_size + tag_size)
+			{
+				throw invalid_container;
+			}
+
+			m_header.resize(header_size);
+			read_raw(0, &m_header[0], m_header.size());
+
+			if ((std::memcmp(&m_header[0], magic, sizeof(magic)) != 0) || (m_header[4] != version) || (m_header[5] != tag_size))
+			{
+				throw invalid_container;
+			}
+
+			const cipher_algorithm _algorithm(static_cast<int>(load_uint32(&m_header[8])));
+
+			m_chunk_size = load_uint32(&m_header[12]);
+
+			if ((m_chunk_size == 0) || (m_chunk_size > chunked_writer::maximum_chunk_size))
+			{
+				throw invalid_container;
+			}
+
+			m_context.aead_initialize(_algorithm, cipher_context::decrypt, key, key_len, nonce_size, tag_size);
+
+			unsigned char index[index_size + tag_size];
+			read_raw(container_size - sizeof(index), index, sizeof(index));
+
+			const chunk_parameters parameters(m_header, index_chunk, index_flag);
+
+			if (!m_context.aead_decrypt(index, index_size, parameters.nonce, nonce_size, parameters.aad, sizeof(parameters.aad), index + index_size, tag_size))
+			{
+				throw std::runtime_error("Index authentication failed");
+			}
+
+			m_size = load_uint64(index);
+			m_chunks_count = load_uint32(index + 8);
+
+			// The index must match the actual layout of the container.
+			if ((m_chunks_count != (m_size + m_chunk_size - 1) / m_chunk_size) || (container_size != header_size + m_size + m_chunks_count * tag_size + sizeof(index)))
+			{
+				throw invalid_container;
+			}
+
+			m_chunk.resize(m_chunk_size + tag_size);
+			m_loaded_chunk = index_chunk;
+		}
+
+		void chunked_reader::read_raw(boost::uint64_t offset, void* buf, size_t buf_len)
+		{
+			if (m_file)
+			{
+				if ((std::fseek(m_file.raw(), get_file_offset(offset), SEEK_SET) != 0) || (std::fread(buf, 1, buf_len, m_file.raw()) != buf_len))
+				{
+					throw std::runtime_error("Unable to read from the file");
+				}
+			}
+			else
+			{
+				if (m_bio.seek(get_bio_offset(offset)) < 0)
+				{
+					throw std::runtime_error("Unable to seek the BIO");
+				}
+
+				unsigned char* cbuf = static_cast<unsigned char*>(buf);
+
+				while (buf_len > 0)
+				{
+					const ptrdiff_t cnt = m_bio.read(cbuf, buf_len);
+
+					error::throw_error_if_not(cnt > 0);
+
+					cbuf += cnt;
+					buf_len -= static_cast<size_t>(cnt);
+				}
+			}
+		}
+
+		void chunked_reader::load_chunk(boost::uint64_t index)
+		{
+			assert(index < m_chunks_count);
+
+			if (index == m_loaded_chunk)
+			{
+				return;
+			}
+
+			const size_t len = static_cast<size_t>(std::min(static_cast<boost::uint64_t>(m_chunk_size), m_size - index * m_chunk_size));
+			const bool last = (index + 1 == m_chunks_count);
+
+			read_raw(header_size + index * (m_chunk_size + tag_size), &m_chunk[0], len + tag_size);
+
+			const chunk_parameters parameters(m_header, index, last ? last_chunk_flag : chunk_flag);
+
+			// On failure, aead_decrypt() zeroes the chunk.
+			m_loaded_chunk = index_chunk;
+
+			if (!m_context.aead_decrypt(&m_chunk[0], len, parameters.nonce, nonce_size, parameters.aad, sizeof(parameters.aad), &m_chunk[len], tag_size))
+			{
+				throw std::runtime_error("Chunk authentication failed");
+			}
+
+			m_loaded_chunk = index;
+		}
+	}
+}
+
+#endif
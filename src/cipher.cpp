@@ -0,0 +1,143 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Cipher helper functions.
+ */
+
+#include "cipher/cipher.hpp"
+
+#include "cipher/cipher_context.hpp"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <cassert>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			typedef std::pair<const EVP_CIPHER*, ENGINE*> context_index;
+			typedef std::map<context_index, boost::shared_ptr<cipher_context> > context_pool;
+
+			boost::thread_specific_ptr<context_pool> context_pools;
+
+			size_t process(void* out, size_t out_len, const void* in, size_t in_len, const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl)
+			{
+				assert(key);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+				if (algorithm.is_aead())
+				{
+					throw std::invalid_argument("algorithm");
+				}
+#endif
+
+				if (key_len != algorithm.key_length())
+				{
+					throw std::runtime_error("key_len");
+				}
+
+				if (iv_len != algorithm.iv_length())
+				{
+					throw std::runtime_error("iv_len");
+				}
+
+				context_pool* pool = context_pools.get();
+
+				if (!pool)
+				{
+					pool = new context_pool();
+					context_pools.reset(pool);
+				}
+
+				const context_index index(algorithm.raw(), impl);
+
+				try
+				{
+					boost::shared_ptr<cipher_context>& ctx = (*pool)[index];
+
+					if (!ctx)
+					{
+						ctx.reset(new cipher_context());
+						ctx->initialize(algorithm, direction, key, key_len, iv, iv_len, impl);
+					}
+					else
+					{
+						// The algorithm is already set: this keeps the context memory instead of freeing and allocating it again.
+						error::throw_error_if_not(EVP_CipherInit_ex(&ctx->raw(), NULL, NULL, static_cast<const unsigned char*>(key), static_cast<const unsigned char*>(iv), static_cast<int>(direction)) != 0);
+					}
+
+					const size_t cnt = ctx->update(out, out_len, in, in_len);
+
+					return cnt + ctx->finalize(static_cast<unsigned char*>(out) + cnt, out_len - cnt);
+				}
+				catch (...)
+				{
+					// The context may be left in any state: don't reuse it.
+					pool->erase(index);
+
+					throw;
+				}
+			}
+		}
+
+		size_t encrypt(void* out, size_t out_len, const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl)
+		{
+			return process(out, out_len, in, in_len, algorithm, cipher_context::encrypt, key, key_len, iv, iv_len, impl);
+		}
+
+		size_t decrypt(void* out, size_t out_len, const void* in, size_t in_len, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, ENGINE* impl)
+		{
+			return process(out, out_len, in, in_len, algorithm, cipher_context::decrypt, key, key_len, iv, iv_len, impl);
+		}
+
+		void clear_context_pool()
+		{
+			context_pools.reset();
+		}
+	}
+}
@@ -44,6 +44,15 @@
 
 #include "cipher/cipher_algorithm.hpp"
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/err.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+
+#include <map>
+#endif
+
 #include <stdexcept>
 #include <cassert>
 
@@ -51,11 +60,115 @@ namespace cryptoplus
 {
 	namespace cipher
 	{
+		namespace
+		{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+			// The algorithms fetched so far. Once published in by_nid, an entry is only read: every thread then finds it without locking.
+			struct fetched_ciphers_cache
+			{
+				typedef std::map<const EVP_CIPHER*, const EVP_CIPHER*> map_type;
+
+				// Higher than any NID OpenSSL 3 defines: an algorithm with a greater NID is only looked up under the mutex.
+				static const int nid_table_size = 2048;
+
+				boost::mutex mutex;
+				map_type fetched;
+				boost::atomic<const map_type::value_type*> by_nid[nid_table_size];
+
+				fetched_ciphers_cache()
+				{
+					for (int nid = 0; nid < nid_table_size; ++nid)
+					{
+						by_nid[nid].store(NULL, boost::memory_order_relaxed);
+					}
+				}
+			};
+
+			fetched_ciphers_cache& get_fetched_ciphers()
+			{
+				// A function-local static is built on first use, even from the constructor of another static object.
+				static fetched_ciphers_cache cache;
+
+				return cache;
+			}
+
+			const EVP_CIPHER* fetch(const EVP_CIPHER* cipher)
+			{
+				// Already fetched handles are taken as is, without locking.
+				if (!cipher || EVP_CIPHER_get0_provider(cipher))
+				{
+					return cipher;
+				}
+
+				fetched_ciphers_cache& cache = get_fetched_ciphers();
+				const int nid = EVP_CIPHER_get_nid(cipher);
+				const bool in_table = (nid > 0) && (nid < fetched_ciphers_cache::nid_table_size);
+
+				if (in_table)
+				{
+					const fetched_ciphers_cache::map_type::value_type* entry = cache.by_nid[nid].load(boost::memory_order_acquire);
+
+					// Another legacy pointer with the same NID (from an engine, for instance) goes through the map.
+					if (entry && (entry->first == cipher))
+					{
+						return entry->second;
+					}
+				}
+
+				boost::mutex::scoped_lock lock(cache.mutex);
+
+				fetched_ciphers_cache::map_type::iterator it = cache.fetched.find(cipher);
+
+				if (it == cache.fetched.end())
+				{
+					ERR_set_mark();
+
+					const EVP_CIPHER* fetched = EVP_CIPHER_fetch(NULL, EVP_CIPHER_get0_name(cipher), NULL);
+
+					if (!fetched)
+					{
+						// The algorithm is not provided (it may come from an engine): the legacy one is used instead.
+						ERR_pop_to_mark();
+
+						fetched = cipher;
+					}
+					else
+					{
+						ERR_clear_last_mark();
+					}
+
+					// The reference is never released: the handle is meant to outlive every context that uses it.
+					it = cache.fetched.insert(std::make_pair(cipher, fetched)).first;
+				}
+
+				// The map never erases its nodes, so the entry address stays valid.
+				if (in_table && !cache.by_nid[nid].load(boost::memory_order_relaxed))
+				{
+					cache.by_nid[nid].store(&*it, boost::memory_order_release);
+				}
+
+				return it->second;
+			}
+#else
+			const EVP_CIPHER* fetch(const EVP_CIPHER* cipher)
+			{
+				return cipher;
+			}
+#endif
+		}
+
 		const size_t cipher_algorithm::max_key_length = EVP_MAX_KEY_LENGTH;
 		const size_t cipher_algorithm::max_iv_length = EVP_MAX_IV_LENGTH;
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		cipher_algorithm::cipher_algorithm(const EVP_CIPHER* cipher) :
+			m_cipher(fetch(cipher))
+		{
+		}
+#endif
+
 		cipher_algorithm::cipher_algorithm(int _type) :
-			m_cipher(EVP_get_cipherbynid(_type))
+			m_cipher(fetch(EVP_get_cipherbynid(_type)))
 		{
 			if (!m_cipher)
 			{
@@ -64,7 +177,7 @@ namespace cryptoplus
 		}
 
 		cipher_algorithm::cipher_algorithm(const std::string& _name) :
-			m_cipher(EVP_get_cipherbyname(_name.c_str()))
+			m_cipher(fetch(EVP_get_cipherbyname(_name.c_str())))
 		{
 			if (!m_cipher)
 			{
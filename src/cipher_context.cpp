@@ -43,11 +43,17 @@
  */
 
 #include "cipher/cipher_context.hpp"
+#include "cipher/nonce_generator.hpp"
 
 #include "pkey/pkey.hpp"
 #include "random/random.hpp"
+#include "parallel.hpp"
 
+#include <openssl/crypto.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 namespace cryptoplus
 {
@@ -58,6 +64,20 @@ namespace cryptoplus
 			typedef int (*update_function)(EVP_CIPHER_CTX*, unsigned char*, int*, const unsigned char*, int);
 			typedef int (*finalize_function)(EVP_CIPHER_CTX*, unsigned char*, int*);
 
+			// Generated nonces are only safe as the iv of an AEAD algorithm: a counter block would overlap the next nonce and a CBC iv would be predictable.
+			void check_nonce_based(const cipher_algorithm& algorithm)
+			{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+				if (algorithm.is_aead())
+				{
+					return;
+				}
+#else
+				static_cast<void>(algorithm);
+#endif
+				throw std::invalid_argument("algorithm");
+			}
+
 			int _EVP_SealUpdate(EVP_CIPHER_CTX* ctx, unsigned char* out, int* outl, const unsigned char* in, int inl)
 			{
 				return EVP_SealUpdate(ctx, out, outl, in, inl);
@@ -81,6 +101,123 @@ namespace cryptoplus
 				return iout_len;
 			}
 
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+			bool is_tag_length_needed_first(unsigned long mode)
+			{
+#ifdef EVP_CIPH_OCB_MODE
+				return (mode == EVP_CIPH_CCM_MODE) || (mode == EVP_CIPH_OCB_MODE);
+#else
+				return (mode == EVP_CIPH_CCM_MODE);
+#endif
+			}
+#endif
+
+			/*
+			 * Walks through a sequence of output buffers.
+			 */
+			class output_cursor
+			{
+				public:
+
+					output_cursor(const mutable_buffer* buffers, size_t buffers_count) :
+						m_current(buffers), m_end(buffers + buffers_count), m_offset(0), m_written(0)
+					{
+					}
+
+					unsigned char* data()
+					{
+						return static_cast<unsigned char*>(m_current->data) + m_offset;
+					}
+
+					size_t room()
+					{
+						while ((m_current != m_end) && (m_offset == m_current->size))
+						{
+							++m_current;
+							m_offset = 0;
+						}
+
+						return (m_current != m_end) ? m_current->size - m_offset : 0;
+					}
+
+					void advance(size_t len)
+					{
+						assert(len <= room());
+
+						m_offset += len;
+						m_written += len;
+					}
+
+					void write(const unsigned char* buf, size_t len)
+					{
+						while (len > 0)
+						{
+							const size_t cnt = std::min(len, room());
+
+							if (cnt == 0)
+							{
+								throw std::logic_error("The output buffers are too small");
+							}
+
+							std::memcpy(data(), buf, cnt);
+							advance(cnt);
+							buf += cnt;
+							len -= cnt;
+						}
+					}
+
+					size_t written() const
+					{
+						return m_written;
+					}
+
+				private:
+
+					const mutable_buffer* m_current;
+					const mutable_buffer* m_end;
+					size_t m_offset;
+					size_t m_written;
+			};
+
+			/*
+			 * Encrypts the session key of an envelope for one recipient.
+			 */
+			class seal_key_encrypter
+			{
+				public:
+
+					seal_key_encrypter(const unsigned char* key, size_t key_len, const pkey::pkey* pkeys, unsigned char* arena, size_t* ek_len) :
+						m_key(key), m_key_len(key_len), m_pkeys(pkeys), m_arena(arena), m_ek_len(ek_len)
+					{
+					}
+
+					void operator()(size_t index)
+					{
+						const pkey::pkey& pkey = m_pkeys[index];
+
+						// Before the call, m_ek_len holds the offsets of the keys within the arena.
+						unsigned char* const ek = m_arena + m_ek_len[index];
+
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+						const int len = EVP_PKEY_encrypt_old(ek, m_key, static_cast<int>(m_key_len), const_cast<EVP_PKEY*>(pkey.raw()));
+#else
+						const int len = EVP_PKEY_encrypt(ek, m_key, static_cast<int>(m_key_len), const_cast<EVP_PKEY*>(pkey.raw()));
+#endif
+
+						error::throw_error_if_not(len > 0);
+
+						m_ek_len[index] = static_cast<size_t>(len);
+					}
+
+				private:
+
+					const unsigned char* m_key;
+					size_t m_key_len;
+					const pkey::pkey* m_pkeys;
+					unsigned char* m_arena;
+					size_t* m_ek_len;
+			};
+
 			size_t generic_finalize(cipher_context& ctx, finalize_function finalize_func, void* out, size_t out_len)
 			{
 				assert(out);
@@ -108,12 +245,122 @@ namespace cryptoplus
 				throw std::runtime_error("iv_len");
 			}
 
-			error::throw_error_if_not(EVP_CipherInit_ex(&m_ctx, _algorithm.raw(), impl, static_cast<const unsigned char*>(key), static_cast<const unsigned char*>(iv), static_cast<int>(direction)) != 0);
+			error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, _algorithm.raw(), impl, static_cast<const unsigned char*>(key), static_cast<const unsigned char*>(iv), static_cast<int>(direction)) != 0);
+		}
+
+		void cipher_context::set_iv(const void* iv, size_t iv_len)
+		{
+			assert(iv);
+
+			if (iv_len != algorithm().iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, NULL, NULL, NULL, static_cast<const unsigned char*>(iv), -1) != 0);
+		}
+
+		void cipher_context::initialize(const cipher_algorithm& _algorithm, cipher_context::cipher_direction direction, const void* key, size_t key_len, nonce_generator& generator, void* iv, size_t iv_len, ENGINE* impl)
+		{
+			assert(iv);
+
+			check_nonce_based(_algorithm);
+
+			if (iv_len != _algorithm.iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			generator.generate(iv, iv_len);
+
+			initialize(_algorithm, direction, key, key_len, iv, iv_len, impl);
+		}
+
+		void cipher_context::set_iv(nonce_generator& generator, void* iv, size_t iv_len)
+		{
+			assert(iv);
+
+			check_nonce_based(algorithm());
+
+			if (iv_len != algorithm().iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			generator.generate(iv, iv_len);
+
+			set_iv(static_cast<const void*>(iv), iv_len);
 		}
 
 		std::vector<unsigned char> cipher_context::seal_initialize(const cipher_algorithm& _algorithm, void* iv, size_t iv_len, pkey::pkey pkey)
 		{
-			return seal_initialize(_algorithm, iv, iv_len, &pkey, &pkey + sizeof(&pkey))[0];
+			return seal_initialize(_algorithm, iv, iv_len, &pkey, &pkey + 1)[0];
+		}
+
+		size_t cipher_context::get_seal_arena_size(const pkey::pkey* pkeys, size_t pkeys_count)
+		{
+			assert(pkeys || (pkeys_count == 0));
+
+			size_t result = 0;
+
+			for (const pkey::pkey* pkey = pkeys; pkey != pkeys + pkeys_count; ++pkey)
+			{
+				result += pkey->size();
+			}
+
+			return result;
+		}
+
+		void cipher_context::seal_initialize(const cipher_algorithm& _algorithm, void* iv, size_t iv_len, const pkey::pkey* pkeys, size_t pkeys_count, void* arena, size_t arena_len, size_t* ek_len, unsigned int threads_count)
+		{
+			assert(pkeys || (pkeys_count == 0));
+			assert(arena || (arena_len == 0));
+			assert(ek_len || (pkeys_count == 0));
+
+			if (iv && (iv_len != _algorithm.iv_length()))
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			if (arena_len < get_seal_arena_size(pkeys, pkeys_count))
+			{
+				throw std::runtime_error("arena_len");
+			}
+
+			// This is what EVP_SealInit() does, except that the public key operations are run in parallel.
+			unsigned char key[EVP_MAX_KEY_LENGTH];
+
+			error::throw_error_if_not(EVP_EncryptInit_ex(m_ctx, _algorithm.raw(), NULL, NULL, NULL) != 0);
+
+			try
+			{
+				error::throw_error_if_not(EVP_CIPHER_CTX_rand_key(m_ctx, key) > 0);
+
+				if (iv && (iv_len > 0))
+				{
+					random::get_random_bytes(iv, iv_len);
+				}
+
+				error::throw_error_if_not(EVP_EncryptInit_ex(m_ctx, NULL, NULL, key, static_cast<const unsigned char*>(iv)) != 0);
+
+				size_t offset = 0;
+
+				for (size_t i = 0; i < pkeys_count; ++i)
+				{
+					ek_len[i] = offset;
+					offset += pkeys[i].size();
+				}
+
+				parallel_for(pkeys_count, threads_count, seal_key_encrypter(key, static_cast<size_t>(EVP_CIPHER_CTX_key_length(m_ctx)), pkeys, static_cast<unsigned char*>(arena), ek_len));
+			}
+			catch (...)
+			{
+				OPENSSL_cleanse(key, sizeof(key));
+
+				throw;
+			}
+
+			OPENSSL_cleanse(key, sizeof(key));
 		}
 
 		void cipher_context::open_initialize(const cipher_algorithm& _algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, pkey::pkey pkey)
@@ -130,9 +377,159 @@ namespace cryptoplus
 				throw std::runtime_error("iv_len");
 			}
 
-			error::throw_error_if_not(EVP_OpenInit(&m_ctx, _algorithm.raw(), static_cast<const unsigned char*>(key), static_cast<int>(key_len), static_cast<const unsigned char*>(iv), pkey.raw()) != 0);
+			error::throw_error_if_not(EVP_OpenInit(m_ctx, _algorithm.raw(), static_cast<const unsigned char*>(key), static_cast<int>(key_len), static_cast<const unsigned char*>(iv), pkey.raw()) != 0);
+		}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+		void cipher_context::aead_initialize(const cipher_algorithm& _algorithm, cipher_context::cipher_direction direction, const void* key, size_t key_len, size_t iv_len, size_t tag_len, ENGINE* impl)
+		{
+			assert(key);
+
+			if (!_algorithm.is_aead())
+			{
+				throw std::invalid_argument("algorithm");
+			}
+
+			if (key_len != _algorithm.key_length())
+			{
+				throw std::runtime_error("key_len");
+			}
+
+			// The iv and tag lengths must be known before the key is set, so we initialize in two steps.
+			error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, _algorithm.raw(), impl, NULL, NULL, static_cast<int>(direction)) != 0);
+
+			if (iv_len != _algorithm.iv_length())
+			{
+				ctrl_set(EVP_CTRL_GCM_SET_IVLEN, static_cast<int>(iv_len));
+			}
+
+			if (is_tag_length_needed_first(_algorithm.mode()))
+			{
+				ctrl_set(EVP_CTRL_CCM_SET_TAG, static_cast<int>(tag_len));
+			}
+
+			error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, NULL, NULL, static_cast<const unsigned char*>(key), NULL, -1) != 0);
+
+			m_aead_iv_len = iv_len;
+			m_aead_tag_len = tag_len;
+		}
+
+		void cipher_context::aead_encrypt(void* buf, size_t buf_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* tag, size_t tag_len)
+		{
+			assert(buf);
+			assert(iv);
+			assert(aad || (aad_len == 0));
+			assert(tag);
+
+			// The lengths were set once and for all by aead_initialize().
+			if (iv_len != m_aead_iv_len)
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			if (tag_len != m_aead_tag_len)
+			{
+				throw std::runtime_error("tag_len");
+			}
+
+			unsigned char* const cbuf = static_cast<unsigned char*>(buf);
+			const bool is_ccm = (EVP_CIPHER_CTX_mode(m_ctx) == EVP_CIPH_CCM_MODE);
+			int len = 0;
+
+			error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, NULL, NULL, NULL, static_cast<const unsigned char*>(iv), -1) != 0);
+
+			if (is_ccm)
+			{
+				// CCM needs to know the total length of the data before anything else.
+				error::throw_error_if_not(EVP_CipherUpdate(m_ctx, NULL, &len, NULL, static_cast<int>(buf_len)) != 0);
+			}
+
+			if (aad_len > 0)
+			{
+				error::throw_error_if_not(EVP_CipherUpdate(m_ctx, NULL, &len, static_cast<const unsigned char*>(aad), static_cast<int>(aad_len)) != 0);
+			}
+
+			error::throw_error_if_not(EVP_CipherUpdate(m_ctx, cbuf, &len, cbuf, static_cast<int>(buf_len)) != 0);
+
+			if (!is_ccm)
+			{
+				// AEAD modes never output anything on finalization.
+				error::throw_error_if_not(EVP_CipherFinal_ex(m_ctx, cbuf + len, &len) != 0);
+			}
+
+			error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(m_ctx, EVP_CTRL_GCM_GET_TAG, static_cast<int>(tag_len), tag) != 0);
 		}
 
+		void cipher_context::aead_encrypt(void* buf, size_t buf_len, nonce_generator& generator, void* iv, size_t iv_len, const void* aad, size_t aad_len, void* tag, size_t tag_len)
+		{
+			assert(iv);
+
+			generator.generate(iv, iv_len);
+
+			aead_encrypt(buf, buf_len, static_cast<const void*>(iv), iv_len, aad, aad_len, tag, tag_len);
+		}
+
+		bool cipher_context::aead_decrypt(void* buf, size_t buf_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, const void* tag, size_t tag_len)
+		{
+			assert(buf);
+			assert(iv);
+			assert(aad || (aad_len == 0));
+			assert(tag);
+
+			// The lengths were set once and for all by aead_initialize().
+			if (iv_len != m_aead_iv_len)
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			if (tag_len != m_aead_tag_len)
+			{
+				throw std::runtime_error("tag_len");
+			}
+
+			unsigned char* const cbuf = static_cast<unsigned char*>(buf);
+			const bool is_ccm = (EVP_CIPHER_CTX_mode(m_ctx) == EVP_CIPH_CCM_MODE);
+			int len = 0;
+
+			error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, NULL, NULL, NULL, static_cast<const unsigned char*>(iv), -1) != 0);
+
+			bool result;
+
+			if (is_ccm)
+			{
+				// CCM checks the tag while decrypting, so it must be given first.
+				error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(m_ctx, EVP_CTRL_CCM_SET_TAG, static_cast<int>(tag_len), const_cast<void*>(tag)) != 0);
+				error::throw_error_if_not(EVP_CipherUpdate(m_ctx, NULL, &len, NULL, static_cast<int>(buf_len)) != 0);
+
+				if (aad_len > 0)
+				{
+					error::throw_error_if_not(EVP_CipherUpdate(m_ctx, NULL, &len, static_cast<const unsigned char*>(aad), static_cast<int>(aad_len)) != 0);
+				}
+
+				result = (EVP_CipherUpdate(m_ctx, cbuf, &len, cbuf, static_cast<int>(buf_len)) > 0);
+			}
+			else
+			{
+				if (aad_len > 0)
+				{
+					error::throw_error_if_not(EVP_CipherUpdate(m_ctx, NULL, &len, static_cast<const unsigned char*>(aad), static_cast<int>(aad_len)) != 0);
+				}
+
+				error::throw_error_if_not(EVP_CipherUpdate(m_ctx, cbuf, &len, cbuf, static_cast<int>(buf_len)) != 0);
+				error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(m_ctx, EVP_CTRL_GCM_SET_TAG, static_cast<int>(tag_len), const_cast<void*>(tag)) != 0);
+
+				result = (EVP_CipherFinal_ex(m_ctx, cbuf + len, &len) > 0);
+			}
+
+			if (!result)
+			{
+				OPENSSL_cleanse(buf, buf_len);
+			}
+
+			return result;
+		}
+#endif
+
 		size_t cipher_context::add_iso_10126_padding(void* buf, size_t buf_len, size_t max_buf_len) const
 		{
 			assert(buf);
@@ -181,6 +578,95 @@ namespace cryptoplus
 			return generic_update(*this, EVP_CipherUpdate, out, out_len, in, in_len);
 		}
 
+		size_t cipher_context::update(const mutable_buffer* out, size_t out_count, const const_buffer* in, size_t in_count)
+		{
+			assert(out || (out_count == 0));
+			assert(in || (in_count == 0));
+
+			const size_t block_size = algorithm().block_size();
+
+			// The maximum count of bytes an update can output beyond its input length. Ciphers with a block size of 1 never buffer anything.
+			const size_t slack = (block_size > 1) ? block_size : 0;
+
+			// Big enough for any output produced by an update of block_size bytes, even when decrypting with padding enabled.
+			unsigned char stage[2 * EVP_MAX_BLOCK_LENGTH];
+
+			output_cursor cursor(out, out_count);
+
+			for (const const_buffer* buf = in; buf != in + in_count; ++buf)
+			{
+				const unsigned char* data = static_cast<const unsigned char*>(buf->data);
+				size_t len = buf->size;
+
+				while (len > 0)
+				{
+					const size_t room = cursor.room();
+					int iout_len = 0;
+
+					if (room > slack)
+					{
+						// Enough room: cipher directly into the output fragment.
+						const size_t cnt = std::min(len, room - slack);
+
+						error::throw_error_if_not(EVP_CipherUpdate(m_ctx, cursor.data(), &iout_len, data, static_cast<int>(cnt)) != 0);
+
+						cursor.advance(iout_len);
+						data += cnt;
+						len -= cnt;
+					}
+					else
+					{
+						// The output may straddle fragments: go through the stage buffer, one block at a time.
+						const size_t cnt = std::min(len, block_size);
+
+						error::throw_error_if_not(EVP_CipherUpdate(m_ctx, stage, &iout_len, data, static_cast<int>(cnt)) != 0);
+
+						cursor.write(stage, iout_len);
+						data += cnt;
+						len -= cnt;
+					}
+				}
+			}
+
+			OPENSSL_cleanse(stage, sizeof(stage));
+
+			return cursor.written();
+		}
+
+		void cipher_context::update_in_place(void* buf, size_t buf_len)
+		{
+			assert(buf || (buf_len == 0));
+
+			const size_t block_size = algorithm().block_size();
+
+#ifdef EVP_CIPH_WRAP_MODE
+			if (algorithm().mode() == EVP_CIPH_WRAP_MODE)
+			{
+				throw std::logic_error("Key wrapping modes cannot cipher in place");
+			}
+#endif
+
+			if (block_size > 1)
+			{
+				if (!EVP_CIPHER_CTX_test_flags(m_ctx, EVP_CIPH_NO_PADDING))
+				{
+					throw std::logic_error("Padding must be disabled to cipher in place with a block algorithm");
+				}
+
+				if (buf_len % block_size != 0)
+				{
+					throw std::logic_error("buf_len should be a multiple of algorithm().block_size()");
+				}
+			}
+
+			unsigned char* const cbuf = static_cast<unsigned char*>(buf);
+			int iout_len = 0;
+
+			error::throw_error_if_not(EVP_CipherUpdate(m_ctx, cbuf, &iout_len, cbuf, static_cast<int>(buf_len)) != 0);
+
+			assert(static_cast<size_t>(iout_len) == buf_len);
+		}
+
 		size_t cipher_context::seal_update(void* out, size_t out_len, const void* in, size_t in_len)
 		{
 			return generic_update(*this, _EVP_SealUpdate, out, out_len, in, in_len);
@@ -191,11 +677,57 @@ namespace cryptoplus
 			return generic_update(*this, _EVP_OpenUpdate, out, out_len, in, in_len);
 		}
 
+		void cipher_context::process_packets(packet* packets, size_t packets_count)
+		{
+			assert(packets || (packets_count == 0));
+
+			// The algorithm is the same for the whole batch: get its block size once.
+			const size_t block_size = algorithm().block_size();
+			static_cast<void>(block_size);
+
+			for (packet* p = packets; p != packets + packets_count; ++p)
+			{
+				assert(p->out);
+				assert(p->in || (p->in_len == 0));
+				assert(p->out_len >= p->in_len + block_size);
+
+				unsigned char* const out = static_cast<unsigned char*>(p->out);
+				int iout_len = static_cast<int>(p->out_len);
+
+				// Only the iv is changed: the key schedule computed by initialize() is kept.
+				error::throw_error_if_not(EVP_CipherInit_ex(m_ctx, NULL, NULL, NULL, static_cast<const unsigned char*>(p->iv), -1) != 0);
+				error::throw_error_if_not(EVP_CipherUpdate(m_ctx, out, &iout_len, static_cast<const unsigned char*>(p->in), static_cast<int>(p->in_len)) != 0);
+
+				p->result_len = iout_len;
+				iout_len = static_cast<int>(p->out_len - p->result_len);
+
+				error::throw_error_if_not(EVP_CipherFinal_ex(m_ctx, out + p->result_len, &iout_len) != 0);
+
+				p->result_len += iout_len;
+			}
+		}
+
 		size_t cipher_context::finalize(void* out, size_t out_len)
 		{
 			return generic_finalize(*this, EVP_CipherFinal, out, out_len);
 		}
 
+		size_t cipher_context::finalize(const mutable_buffer* out, size_t out_count)
+		{
+			assert(out || (out_count == 0));
+
+			unsigned char stage[EVP_MAX_BLOCK_LENGTH];
+
+			const size_t cnt = finalize(stage, sizeof(stage));
+
+			output_cursor cursor(out, out_count);
+			cursor.write(stage, cnt);
+
+			OPENSSL_cleanse(stage, sizeof(stage));
+
+			return cursor.written();
+		}
+
 		size_t cipher_context::seal_finalize(void* out, size_t out_len)
 		{
 			return generic_finalize(*this, EVP_SealFinal, out, out_len);
@@ -0,0 +1,184 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher_context_cache.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A keyed cipher context cache class.
+ */
+
+#include "cipher/cipher_context_cache.hpp"
+
+#include <cassert>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		void cipher_context_cache::insert(const std::string& key_id, const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, const void* key, size_t key_len, ENGINE* impl)
+		{
+			assert(direction != cipher_context::unchanged);
+
+			// The key schedule is computed outside of the lock.
+			entry_type entry;
+			entry.index = index_type(key_id, direction);
+			entry.ctx.reset(new cipher_context());
+			entry.ctx->initialize(algorithm, direction, key, key_len, NULL, algorithm.iv_length(), impl);
+
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			entry_map::iterator it = m_index.find(entry.index);
+
+			if (it != m_index.end())
+			{
+				m_entries.erase(it->second);
+				m_index.erase(it);
+			}
+			else if (m_entries.size() >= m_capacity)
+			{
+				m_index.erase(m_entries.back().index);
+				m_entries.pop_back();
+				++m_evictions;
+			}
+
+			m_entries.push_front(entry);
+			m_index[entry.index] = m_entries.begin();
+		}
+
+		bool cipher_context_cache::get(const std::string& key_id, cipher_context::cipher_direction direction, cipher_context& ctx, const void* iv, size_t iv_len)
+		{
+			boost::shared_ptr<cipher_context> keyed_ctx;
+
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				entry_map::iterator it = m_index.find(index_type(key_id, direction));
+
+				if (it == m_index.end())
+				{
+					++m_misses;
+
+					return false;
+				}
+
+				++m_hits;
+
+				// Mark the entry as the most recently used.
+				m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+				keyed_ctx = it->second->ctx;
+			}
+
+			// The keyed context is never modified once inserted, so it can be copied without holding the lock: the shared pointer keeps it alive even if it gets evicted meanwhile.
+			ctx.copy(*keyed_ctx);
+
+			if (iv)
+			{
+				ctx.set_iv(iv, iv_len);
+			}
+
+			return true;
+		}
+
+		bool cipher_context_cache::erase(const std::string& key_id, cipher_context::cipher_direction direction)
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			entry_map::iterator it = m_index.find(index_type(key_id, direction));
+
+			if (it == m_index.end())
+			{
+				return false;
+			}
+
+			m_entries.erase(it->second);
+			m_index.erase(it);
+
+			return true;
+		}
+
+		void cipher_context_cache::clear()
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			m_index.clear();
+			m_entries.clear();
+		}
+
+		size_t cipher_context_cache::size() const
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			return m_entries.size();
+		}
+
+		unsigned long cipher_context_cache::hits() const
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			return m_hits;
+		}
+
+		unsigned long cipher_context_cache::misses() const
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			return m_misses;
+		}
+
+		unsigned long cipher_context_cache::evictions() const
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			return m_evictions;
+		}
+
+		void cipher_context_cache::reset_statistics()
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+
+			m_hits = 0;
+			m_misses = 0;
+			m_evictions = 0;
+		}
+	}
+}
+
+#endif
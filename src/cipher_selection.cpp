@@ -0,0 +1,249 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher_selection.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Runtime cipher algorithm selection functions.
+ */
+
+#include "cipher/cipher_selection.hpp"
+
+#include "cipher/cipher_context.hpp"
+#include "random/random.hpp"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			// Throughput hardly changes past this size: larger messages only make the measurement longer.
+			const size_t maximum_measured_size = 1024 * 1024;
+
+			const boost::int64_t round_duration = 2000;
+			const unsigned int rounds_count = 3;
+
+			typedef std::pair<std::vector<const EVP_CIPHER*>, size_t> cache_key;
+
+			boost::mutex cache_mutex;
+			std::map<cache_key, const EVP_CIPHER*> cache;
+
+			class candidate_measure
+			{
+				public:
+
+					candidate_measure(const cipher_algorithm& algorithm, size_t size) :
+						m_algorithm(algorithm),
+						m_key(random::get_random_bytes<unsigned char>(algorithm.key_length())),
+						m_iv(random::get_random_bytes<unsigned char>(algorithm.iv_length())),
+						m_buffer(size + 2 * algorithm.block_size()),
+						m_size(size)
+					{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+						if (m_algorithm.is_aead())
+						{
+							m_ctx.aead_initialize(m_algorithm, cipher_context::encrypt, key(), m_key.size(), m_iv.size(), sizeof(m_tag));
+
+							return;
+						}
+#endif
+						m_ctx.initialize(m_algorithm, cipher_context::encrypt, key(), m_key.size(), iv(), m_iv.size());
+					}
+
+					// Get the throughput, in bytes per microsecond, over one round.
+					double operator()()
+					{
+						boost::uint64_t messages_count = 0;
+						const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+						boost::int64_t elapsed = 0;
+
+						do
+						{
+							cipher_message();
+							++messages_count;
+							elapsed = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds();
+						}
+						while (elapsed < round_duration);
+
+						return static_cast<double>(messages_count) * static_cast<double>(m_size) / static_cast<double>(elapsed);
+					}
+
+				private:
+
+					const unsigned char* key() const
+					{
+						return m_key.empty() ? NULL : &m_key[0];
+					}
+
+					const unsigned char* iv() const
+					{
+						return m_iv.empty() ? NULL : &m_iv[0];
+					}
+
+					void cipher_message()
+					{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+						if (m_algorithm.is_aead())
+						{
+							m_ctx.aead_encrypt(&m_buffer[0], m_size, iv(), m_iv.size(), NULL, 0, m_tag, sizeof(m_tag));
+
+							return;
+						}
+#endif
+						// Only the iv is set again: the key schedule is kept, as it would be by a real user.
+						error::throw_error_if_not(EVP_CipherInit_ex(&m_ctx.raw(), NULL, NULL, NULL, iv(), -1) != 0);
+
+						const size_t cnt = m_ctx.update(&m_buffer[0], m_buffer.size(), &m_buffer[0], m_size);
+						m_ctx.finalize(&m_buffer[0] + cnt, m_buffer.size() - cnt);
+					}
+
+					cipher_algorithm m_algorithm;
+					std::vector<unsigned char> m_key;
+					std::vector<unsigned char> m_iv;
+					std::vector<unsigned char> m_buffer;
+					size_t m_size;
+					unsigned char m_tag[16];
+					cipher_context m_ctx;
+			};
+		}
+
+		cipher_algorithm select_fastest(const cipher_algorithm* candidates, size_t candidates_count, size_t typical_size)
+		{
+			assert(candidates || (candidates_count == 0));
+
+			if (typical_size == 0)
+			{
+				throw std::invalid_argument("typical_size");
+			}
+
+			cache_key key;
+			key.second = typical_size;
+
+			for (const cipher_algorithm* candidate = candidates; candidate != candidates + candidates_count; ++candidate)
+			{
+				key.first.push_back(candidate->raw());
+			}
+
+			// The lock is held during the measurement so that concurrent measurements don't skew each other.
+			boost::mutex::scoped_lock lock(cache_mutex);
+
+			const std::map<cache_key, const EVP_CIPHER*>::const_iterator it = cache.find(key);
+
+			if (it != cache.end())
+			{
+				return it->second;
+			}
+
+			const size_t size = std::min(typical_size, maximum_measured_size);
+
+			std::vector<boost::shared_ptr<candidate_measure> > measures;
+			std::vector<double> throughputs;
+
+			for (const cipher_algorithm* candidate = candidates; candidate != candidates + candidates_count; ++candidate)
+			{
+				boost::shared_ptr<candidate_measure> measure;
+
+				try
+				{
+					measure.reset(new candidate_measure(*candidate, size));
+
+					// Also warms the caches up.
+					(*measure)();
+				}
+				catch (std::exception&)
+				{
+					measure.reset();
+				}
+
+				measures.push_back(measure);
+				throughputs.push_back(0.0);
+			}
+
+			// Rounds are interleaved so that a transient load hits all the candidates alike.
+			for (unsigned int round = 0; round < rounds_count; ++round)
+			{
+				for (size_t i = 0; i < measures.size(); ++i)
+				{
+					if (measures[i])
+					{
+						throughputs[i] = std::max(throughputs[i], (*measures[i])());
+					}
+				}
+			}
+
+			const size_t best = std::max_element(throughputs.begin(), throughputs.end()) - throughputs.begin();
+
+			if ((best == throughputs.size()) || !measures[best])
+			{
+				throw std::invalid_argument("candidates");
+			}
+
+			cache[key] = candidates[best].raw();
+
+			return candidates[best];
+		}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+		cipher_algorithm select_fastest_aead(size_t typical_size)
+		{
+			const cipher_algorithm candidates[] =
+			{
+				EVP_aes_128_gcm(),
+				EVP_aes_256_gcm(),
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+				EVP_chacha20_poly1305(),
+#endif
+			};
+
+			return select_fastest(candidates, sizeof(candidates) / sizeof(candidates[0]), typical_size);
+		}
+#endif
+	}
+}
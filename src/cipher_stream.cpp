@@ -44,14 +44,102 @@
 
 #include "cipher/cipher_stream.hpp"
 
+#include "bio/bio_ptr.hpp"
+
+#include <openssl/crypto.h>
+
 #include <cassert>
+#include <cstdio>
+#include <stdexcept>
 
 namespace cryptoplus
 {
 	namespace cipher
 	{
+		namespace
+		{
+			class bio_writer
+			{
+				public:
+
+					explicit bio_writer(bio::bio_ptr bio) : m_bio(bio) {}
+
+					void operator()(const void* buf, size_t buf_len)
+					{
+						const unsigned char* cbuf = static_cast<const unsigned char*>(buf);
+
+						while (buf_len > 0)
+						{
+							const ptrdiff_t cnt = m_bio.write(cbuf, buf_len);
+
+							error::throw_error_if_not(cnt > 0);
+
+							cbuf += cnt;
+							buf_len -= static_cast<size_t>(cnt);
+						}
+					}
+
+				private:
+
+					bio::bio_ptr m_bio;
+			};
+
+			class file_writer
+			{
+				public:
+
+					explicit file_writer(file _file) : m_file(_file) {}
+
+					void operator()(const void* buf, size_t buf_len)
+					{
+						if (std::fwrite(buf, 1, buf_len, m_file.raw()) != buf_len)
+						{
+							throw std::runtime_error("Unable to write to the file");
+						}
+					}
+
+				private:
+
+					file m_file;
+			};
+		}
+
+		cipher_stream::sink_type cipher_stream::bio_sink(bio::bio_ptr bio)
+		{
+			return bio_writer(bio);
+		}
+
+		cipher_stream::sink_type cipher_stream::file_sink(file _file)
+		{
+			return file_writer(_file);
+		}
+
 		cipher_stream& cipher_stream::append(const void* buf, size_t buf_len)
 		{
+			if (m_sink)
+			{
+				const size_t block_size = algorithm().block_size();
+				const unsigned char* cbuf = static_cast<const unsigned char*>(buf);
+
+				while (buf_len > 0)
+				{
+					// We always keep room for one block, so that any chunk we pass to update() fits.
+					if (m_buffer.size() - m_offset <= block_size)
+					{
+						flush();
+					}
+
+					const size_t cnt = std::min(buf_len, m_buffer.size() - m_offset - block_size);
+
+					m_offset += update(&m_buffer[0] + m_offset, m_buffer.size() - m_offset, cbuf, cnt);
+
+					cbuf += cnt;
+					buf_len -= cnt;
+				}
+
+				return *this;
+			}
+
 			size_t out_len = m_buffer.size() - m_offset;
 
 			if (out_len < algorithm().block_size() + buf_len)
@@ -67,6 +155,22 @@ namespace cryptoplus
 
 		void cipher_stream::finalize()
 		{
+			if (m_sink)
+			{
+				if (m_buffer.size() - m_offset < algorithm().block_size())
+				{
+					flush();
+				}
+
+				m_offset += finalize(&m_buffer[0] + m_offset, m_buffer.size() - m_offset);
+
+				flush();
+
+				OPENSSL_cleanse(&m_buffer[0], m_buffer.size());
+
+				return;
+			}
+
 			size_t out_len = m_buffer.size() - m_offset;
 
 			if (out_len < algorithm().block_size())
@@ -79,6 +183,15 @@ namespace cryptoplus
 
 			m_offset = 0;
 		}
+
+		void cipher_stream::flush()
+		{
+			if (m_offset > 0)
+			{
+				m_sink(&m_buffer[0], m_offset);
+
+				m_offset = 0;
+			}
+		}
 	}
 }
-
@@ -0,0 +1,191 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher_streambuf.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Cipher stream buffer classes.
+ */
+
+#include "cipher/cipher_streambuf.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			size_t get_aligned_size(size_t buffer_size)
+			{
+				// EVP_MAX_BLOCK_LENGTH is a multiple of every block size.
+				const size_t result = (buffer_size + EVP_MAX_BLOCK_LENGTH - 1) / EVP_MAX_BLOCK_LENGTH * EVP_MAX_BLOCK_LENGTH;
+
+				return (result > 0) ? result : EVP_MAX_BLOCK_LENGTH;
+			}
+		}
+
+		const size_t cipher_ostreambuf::default_buffer_size = 64 * 1024;
+
+		cipher_ostreambuf::cipher_ostreambuf(std::streambuf* destination, size_t buffer_size) :
+			m_destination(destination),
+			m_input(get_aligned_size(buffer_size)),
+			m_output(m_input.size() + EVP_MAX_BLOCK_LENGTH)
+		{
+			assert(m_destination);
+
+			setp(&m_input[0], &m_input[0] + m_input.size());
+		}
+
+		void cipher_ostreambuf::finalize()
+		{
+			if (sync() != 0)
+			{
+				throw std::runtime_error("Unable to write to the destination");
+			}
+
+			write_output(m_context.finalize(&m_output[0], m_output.size()));
+
+			if (m_destination->pubsync() != 0)
+			{
+				throw std::runtime_error("Unable to write to the destination");
+			}
+		}
+
+		cipher_ostreambuf::int_type cipher_ostreambuf::overflow(int_type c)
+		{
+			cipher_input(pbase(), pptr() - pbase());
+			setp(&m_input[0], &m_input[0] + m_input.size());
+
+			if (!traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+
+			return traits_type::not_eof(c);
+		}
+
+		std::streamsize cipher_ostreambuf::xsputn(const char_type* s, std::streamsize n)
+		{
+			const size_t len = static_cast<size_t>(n);
+
+			if (len < m_input.size())
+			{
+				return std::streambuf::xsputn(s, n);
+			}
+
+			// Large writes bypass the internal input buffer.
+			cipher_input(pbase(), pptr() - pbase());
+			setp(&m_input[0], &m_input[0] + m_input.size());
+
+			for (size_t offset = 0; offset < len; offset += m_input.size())
+			{
+				cipher_input(s + offset, std::min(m_input.size(), len - offset));
+			}
+
+			return n;
+		}
+
+		int cipher_ostreambuf::sync()
+		{
+			cipher_input(pbase(), pptr() - pbase());
+			setp(&m_input[0], &m_input[0] + m_input.size());
+
+			return m_destination->pubsync();
+		}
+
+		void cipher_ostreambuf::cipher_input(const void* buf, size_t buf_len)
+		{
+			if (buf_len > 0)
+			{
+				write_output(m_context.update(&m_output[0], m_output.size(), buf, buf_len));
+			}
+		}
+
+		void cipher_ostreambuf::write_output(size_t len)
+		{
+			const std::streamsize slen = static_cast<std::streamsize>(len);
+
+			if (m_destination->sputn(reinterpret_cast<const char_type*>(&m_output[0]), slen) != slen)
+			{
+				throw std::runtime_error("Unable to write to the destination");
+			}
+		}
+
+		const size_t cipher_istreambuf::default_buffer_size = 64 * 1024;
+
+		cipher_istreambuf::cipher_istreambuf(std::streambuf* source, size_t buffer_size) :
+			m_source(source),
+			m_input(get_aligned_size(buffer_size)),
+			m_output(m_input.size() + EVP_MAX_BLOCK_LENGTH),
+			m_finalized(false)
+		{
+			assert(m_source);
+
+			setg(&m_output[0], &m_output[0], &m_output[0]);
+		}
+
+		cipher_istreambuf::int_type cipher_istreambuf::underflow()
+		{
+			size_t len = 0;
+
+			// The cipher_context may buffer a whole chunk without outputing anything, so we loop.
+			while ((len == 0) && !m_finalized)
+			{
+				const std::streamsize cnt = m_source->sgetn(&m_input[0], static_cast<std::streamsize>(m_input.size()));
+
+				if (cnt > 0)
+				{
+					len = m_context.update(&m_output[0], m_output.size(), &m_input[0], static_cast<size_t>(cnt));
+				}
+				else
+				{
+					m_finalized = true;
+					len = m_context.finalize(&m_output[0], m_output.size());
+				}
+			}
+
+			setg(&m_output[0], &m_output[0], &m_output[0] + len);
+
+			return (len > 0) ? traits_type::to_int_type(m_output[0]) : traits_type::eof();
+		}
+	}
+}
@@ -0,0 +1,349 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file file_cipher.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Pipelined file ciphering functions.
+ */
+
+#include "cipher/file_cipher.hpp"
+
+#include "cipher/cipher_context.hpp"
+#include "parallel.hpp"
+
+#include <openssl/crypto.h>
+
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			/*
+			 * A buffer that travels through the pipeline.
+			 */
+			struct slot
+			{
+				std::vector<unsigned char> input;
+				std::vector<unsigned char> output;
+				size_t input_len;
+				size_t output_len;
+				bool last;
+			};
+
+			typedef boost::lockfree::spsc_queue<slot*> slot_queue;
+
+			// How many times a stage polls its queue before it goes to sleep.
+			const unsigned int spin_count = 64;
+
+			class file_pipeline
+			{
+				public:
+
+					file_pipeline(file destination, file source, cipher_context& ctx, size_t buffer_size, size_t buffers_count) :
+						m_destination(destination),
+						m_source(source),
+						m_ctx(ctx),
+						m_slots(buffers_count),
+						m_free_slots(buffers_count),
+						m_read_slots(buffers_count),
+						m_written_slots(buffers_count),
+						m_aborted(false),
+						m_written(0)
+					{
+						for (std::vector<slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+						{
+							it->input.resize(buffer_size);
+							it->output.resize(buffer_size + EVP_MAX_BLOCK_LENGTH);
+							m_free_slots.push(&*it);
+						}
+					}
+
+					~file_pipeline()
+					{
+						for (std::vector<slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+						{
+							OPENSSL_cleanse(&it->input[0], it->input.size());
+							OPENSSL_cleanse(&it->output[0], it->output.size());
+						}
+					}
+
+					boost::uint64_t run()
+					{
+						boost::thread reader(&file_pipeline::guard, this, &file_pipeline::read);
+						boost::thread writer;
+
+						try
+						{
+							writer = boost::thread(&file_pipeline::guard, this, &file_pipeline::write);
+						}
+						catch (...)
+						{
+							abort();
+							reader.join();
+
+							throw;
+						}
+
+						guard(&file_pipeline::cipher);
+
+						reader.join();
+						writer.join();
+
+						m_failure.rethrow();
+
+						return m_written;
+					}
+
+				private:
+
+					typedef void (file_pipeline::*stage_type)();
+
+					void guard(stage_type stage)
+					{
+						try
+						{
+							(this->*stage)();
+						}
+						catch (error::cryptographic_exception& ex)
+						{
+							m_failure.set(ex.err(), ex.what());
+							abort();
+						}
+						catch (std::exception& ex)
+						{
+							m_failure.set(0, ex.what());
+							abort();
+						}
+					}
+
+					void abort()
+					{
+						m_aborted = true;
+
+						boost::mutex::scoped_lock lock(m_mutex);
+						m_condition.notify_all();
+					}
+
+					// Returns false if the pipeline was aborted.
+					bool pop(slot_queue& queue, slot*& value)
+					{
+						// The next buffer is often about to come: poll a little before going to sleep.
+						for (unsigned int i = 0; i < spin_count; ++i)
+						{
+							if (queue.pop(value))
+							{
+								return true;
+							}
+
+							if (m_aborted)
+							{
+								return false;
+							}
+
+							boost::this_thread::yield();
+						}
+
+						boost::mutex::scoped_lock lock(m_mutex);
+
+						while (!queue.pop(value))
+						{
+							if (m_aborted)
+							{
+								return false;
+							}
+
+							m_condition.wait(lock);
+						}
+
+						return true;
+					}
+
+					void push(slot_queue& queue, slot* value)
+					{
+						// Every queue can hold all the slots, so this never fails.
+						const bool pushed = queue.push(value);
+
+						assert(pushed);
+						static_cast<void>(pushed);
+
+						// Taking the lock ensures a stage cannot miss the notification between its last check and its wait.
+						boost::mutex::scoped_lock lock(m_mutex);
+						m_condition.notify_all();
+					}
+
+					void read()
+					{
+						slot* current = NULL;
+
+						do
+						{
+							if (!pop(m_free_slots, current))
+							{
+								return;
+							}
+
+							current->input_len = std::fread(&current->input[0], 1, current->input.size(), m_source.raw());
+
+							if (std::ferror(m_source.raw()))
+							{
+								throw std::runtime_error("Unable to read from the source file");
+							}
+
+							current->last = (current->input_len < current->input.size());
+
+							push(m_read_slots, current);
+						}
+						while (!current->last);
+					}
+
+					void cipher()
+					{
+						slot* current = NULL;
+
+						do
+						{
+							if (!pop(m_read_slots, current))
+							{
+								return;
+							}
+
+							current->output_len = (current->input_len > 0) ? m_ctx.update(&current->output[0], current->output.size(), &current->input[0], current->input_len) : 0;
+
+							if (current->last)
+							{
+								current->output_len += m_ctx.finalize(&current->output[current->output_len], current->output.size() - current->output_len);
+							}
+
+							push(m_written_slots, current);
+						}
+						while (!current->last);
+					}
+
+					void write()
+					{
+						slot* current = NULL;
+
+						do
+						{
+							if (!pop(m_written_slots, current))
+							{
+								return;
+							}
+
+							if (std::fwrite(&current->output[0], 1, current->output_len, m_destination.raw()) != current->output_len)
+							{
+								throw std::runtime_error("Unable to write to the destination file");
+							}
+
+							m_written += current->output_len;
+
+							push(m_free_slots, current);
+						}
+						while (!current->last);
+
+						if (std::fflush(m_destination.raw()) != 0)
+						{
+							throw std::runtime_error("Unable to write to the destination file");
+						}
+					}
+
+					file m_destination;
+					file m_source;
+					cipher_context& m_ctx;
+					std::vector<slot> m_slots;
+					slot_queue m_free_slots;
+					slot_queue m_read_slots;
+					slot_queue m_written_slots;
+					boost::atomic<bool> m_aborted;
+					boost::mutex m_mutex;
+					boost::condition_variable m_condition;
+					detail::parallel_failure m_failure;
+					boost::uint64_t m_written;
+			};
+
+			boost::uint64_t process_file(cipher_context::cipher_direction direction, file destination, file source, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t buffer_size, size_t buffers_count)
+			{
+				assert(destination);
+				assert(source);
+
+				if (buffer_size == 0)
+				{
+					throw std::invalid_argument("buffer_size");
+				}
+
+				if (buffers_count < 2)
+				{
+					throw std::invalid_argument("buffers_count");
+				}
+
+				cipher_context ctx;
+				ctx.initialize(algorithm, direction, key, key_len, iv, iv_len);
+
+				file_pipeline pipeline(destination, source, ctx, buffer_size, buffers_count);
+
+				return pipeline.run();
+			}
+		}
+
+		const size_t default_file_buffer_size = 1024 * 1024;
+		const size_t default_file_buffers_count = 8;
+
+		boost::uint64_t encrypt_file(file destination, file source, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t buffer_size, size_t buffers_count)
+		{
+			return process_file(cipher_context::encrypt, destination, source, algorithm, key, key_len, iv, iv_len, buffer_size, buffers_count);
+		}
+
+		boost::uint64_t decrypt_file(file destination, file source, const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t buffer_size, size_t buffers_count)
+		{
+			return process_file(cipher_context::decrypt, destination, source, algorithm, key, key_len, iv, iv_len, buffer_size, buffers_count);
+		}
+	}
+}
@@ -45,6 +45,8 @@
 #include "hash/hmac.hpp"
 #include "hash/hmac_context.hpp"
 
+#include <openssl/evp.h>
+
 #include <cassert>
 
 namespace cryptoplus
@@ -62,6 +64,26 @@ namespace cryptoplus
 			ctx.update(data, len);
 			return ctx.finalize(out, out_len);
 		}
+
+		size_t hmac(void* out, size_t out_len, const void* data, size_t len, const hmac_key& key)
+		{
+			assert(out);
+			assert(data || (len == 0));
+			assert(out_len >= key.algorithm().result_size());
+
+			unsigned char inner_digest[EVP_MAX_MD_SIZE];
+
+			message_digest_context ctx;
+
+			ctx.copy(key.inner());
+			ctx.update(data, len);
+			const size_t inner_digest_len = ctx.finalize(inner_digest, sizeof(inner_digest));
+
+			ctx.copy(key.outer());
+			ctx.update(inner_digest, inner_digest_len);
+
+			return ctx.finalize(out, out_len);
+		}
 	}
 }
 
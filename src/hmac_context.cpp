@@ -44,18 +44,121 @@
 
 #include "hash/hmac_context.hpp"
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <stdexcept>
+#endif
+
 #include <cassert>
 
 namespace cryptoplus
 {
 	namespace hash
 	{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		namespace
+		{
+			boost::mutex hmac_mutex;
+			EVP_MAC* hmac = NULL;
+
+			EVP_MAC* get_hmac()
+			{
+				boost::mutex::scoped_lock lock(hmac_mutex);
+
+				if (!hmac)
+				{
+					// The reference is never released: the handle is meant to outlive every context that uses it.
+					hmac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+
+					error::throw_error_if_not(hmac != NULL);
+				}
+
+				return hmac;
+			}
+		}
+
+		hmac_context::hmac_context() :
+			m_ctx(EVP_MAC_CTX_new(get_hmac())),
+			m_algorithm(static_cast<const EVP_MD*>(NULL))
+		{
+			error::throw_error_if_not(m_ctx != NULL);
+		}
+
+		hmac_context::~hmac_context()
+		{
+			EVP_MAC_CTX_free(m_ctx);
+		}
+
+		void hmac_context::initialize(const void* key, size_t key_len, const message_digest_algorithm* _algorithm, ENGINE* impl)
+		{
+			if (impl)
+			{
+				throw std::invalid_argument("impl");
+			}
+
+			OSSL_PARAM params[2];
+			OSSL_PARAM* param = params;
+
+			// Giving the digest makes the provider fetch it: only do so when it changes.
+			if (_algorithm && (_algorithm->raw() != m_algorithm.raw()))
+			{
+				*param++ = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>(EVP_MD_get0_name(_algorithm->raw())), 0);
+			}
+
+			*param = OSSL_PARAM_construct_end();
+
+			error::throw_error_if_not(EVP_MAC_init(m_ctx, static_cast<const unsigned char*>(key), key ? key_len : 0, params) != 0);
+
+			if (_algorithm)
+			{
+				m_algorithm = *_algorithm;
+			}
+		}
+
+		size_t hmac_context::finalize(void* md, size_t len)
+		{
+			assert(md);
+
+			size_t result = 0;
+
+			error::throw_error_if_not(EVP_MAC_final(m_ctx, static_cast<unsigned char*>(md), &result, len) != 0);
+
+			return result;
+		}
+#else
+		hmac_context::hmac_context() :
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+			m_ctx(HMAC_CTX_new())
+#else
+			m_ctx(static_cast<HMAC_CTX*>(OPENSSL_malloc(sizeof(HMAC_CTX))))
+#endif
+		{
+			error::throw_error_if_not(m_ctx != NULL);
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+			HMAC_CTX_init(m_ctx);
+#endif
+		}
+
+		hmac_context::~hmac_context()
+		{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+			HMAC_CTX_free(m_ctx);
+#else
+			HMAC_CTX_cleanup(m_ctx);
+			OPENSSL_free(m_ctx);
+#endif
+		}
+
 		void hmac_context::initialize(const void* key, size_t key_len, const message_digest_algorithm* _algorithm, ENGINE* impl)
 		{
 #if OPENSSL_VERSION_NUMBER < 0x01000000
-			HMAC_Init_ex(&m_ctx, key, static_cast<int>(key_len), _algorithm ? _algorithm->raw() : NULL, impl);
+			HMAC_Init_ex(m_ctx, key, static_cast<int>(key_len), _algorithm ? _algorithm->raw() : NULL, impl);
 #else
-			error::throw_error_if_not(HMAC_Init_ex(&m_ctx, key, static_cast<int>(key_len), _algorithm ? _algorithm->raw() : NULL, impl) != 0);
+			error::throw_error_if_not(HMAC_Init_ex(m_ctx, key, static_cast<int>(key_len), _algorithm ? _algorithm->raw() : NULL, impl) != 0);
 #endif
 		}
 
@@ -66,12 +169,12 @@ namespace cryptoplus
 			unsigned int ilen = static_cast<unsigned int>(len);
 
 #if OPENSSL_VERSION_NUMBER < 0x01000000
-			HMAC_Final(&m_ctx, static_cast<unsigned char*>(md), &ilen);
+			HMAC_Final(m_ctx, static_cast<unsigned char*>(md), &ilen);
 #else
-			error::throw_error_if_not(HMAC_Final(&m_ctx, static_cast<unsigned char*>(md), &ilen) != 0);
+			error::throw_error_if_not(HMAC_Final(m_ctx, static_cast<unsigned char*>(md), &ilen) != 0);
 #endif
 			return ilen;
 		}
+#endif
 	}
 }
-
@@ -0,0 +1,102 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file hmac_key.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A precomputed HMAC key class.
+ */
+
+#include "hash/hmac_key.hpp"
+
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace cryptoplus
+{
+	namespace hash
+	{
+		namespace
+		{
+			const unsigned char ipad = 0x36;
+			const unsigned char opad = 0x5c;
+		}
+
+		hmac_key::hmac_key(const void* key, size_t key_len, const message_digest_algorithm& _algorithm, ENGINE* impl) :
+			m_algorithm(_algorithm)
+		{
+			assert(key || (key_len == 0));
+
+			const size_t block_size = m_algorithm.block_size();
+			std::vector<unsigned char> block(block_size);
+
+			// Keys longer than a block are hashed first (RFC 2104).
+			if (key_len > block_size)
+			{
+				m_inner.initialize(m_algorithm, impl);
+				m_inner.update(key, key_len);
+				m_inner.finalize(&block[0], block.size());
+			}
+			else if (key_len > 0)
+			{
+				std::copy(static_cast<const unsigned char*>(key), static_cast<const unsigned char*>(key) + key_len, block.begin());
+			}
+
+			for (size_t i = 0; i < block_size; ++i)
+			{
+				block[i] ^= ipad;
+			}
+
+			m_inner.initialize(m_algorithm, impl);
+			m_inner.update(&block[0], block.size());
+
+			for (size_t i = 0; i < block_size; ++i)
+			{
+				block[i] ^= ipad ^ opad;
+			}
+
+			m_outer.initialize(m_algorithm, impl);
+			m_outer.update(&block[0], block.size());
+
+			OPENSSL_cleanse(&block[0], block.size());
+		}
+	}
+}
@@ -0,0 +1,261 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file key_wrap.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief AES key wrapping functions.
+ */
+
+#include "cipher/key_wrap.hpp"
+
+#include "cipher/cipher_context.hpp"
+#include "parallel.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			const size_t semiblock_size = 8;
+
+			// Batches shorter than this are not worth a thread.
+			const size_t minimum_entries_per_run = 256;
+
+			bool is_padded(const cipher_algorithm& algorithm)
+			{
+				switch (algorithm.type())
+				{
+					case NID_id_aes128_wrap_pad:
+					case NID_id_aes192_wrap_pad:
+					case NID_id_aes256_wrap_pad:
+						return true;
+					default:
+						return false;
+				}
+			}
+
+			void check_algorithm(const cipher_algorithm& algorithm)
+			{
+				if (algorithm.mode() != EVP_CIPH_WRAP_MODE)
+				{
+					throw std::invalid_argument("algorithm");
+				}
+			}
+
+			void check_entries(const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, const key_wrap_entry* entries, size_t entries_count)
+			{
+				assert(entries || (entries_count == 0));
+
+				const bool padded = is_padded(algorithm);
+				const size_t minimum_len = (direction == cipher_context::encrypt) ? (padded ? 1 : 2 * semiblock_size) : (padded ? 2 * semiblock_size : 3 * semiblock_size);
+
+				for (const key_wrap_entry* entry = entries; entry != entries + entries_count; ++entry)
+				{
+					assert(entry->in);
+					assert(entry->out);
+
+					if ((entry->in_len < minimum_len) || (entry->in_len > static_cast<size_t>(std::numeric_limits<int>::max()) - 2 * semiblock_size))
+					{
+						throw std::invalid_argument("in_len");
+					}
+
+					if (((direction == cipher_context::decrypt) || !padded) && (entry->in_len % semiblock_size != 0))
+					{
+						throw std::invalid_argument("in_len");
+					}
+
+					if (direction == cipher_context::encrypt)
+					{
+						assert(entry->out_len >= get_wrapped_key_size(algorithm, entry->in_len));
+					}
+					else
+					{
+						assert(entry->out_len >= entry->in_len - semiblock_size);
+					}
+				}
+			}
+
+			class key_wrap_worker
+			{
+				public:
+
+					key_wrap_worker(std::vector<boost::shared_ptr<cipher_context> >& contexts, cipher_context::cipher_direction direction, key_wrap_entry* entries, size_t entries_count, size_t entries_per_run) :
+						m_contexts(contexts), m_direction(direction), m_entries(entries), m_entries_count(entries_count), m_entries_per_run(entries_per_run)
+					{
+					}
+
+					void operator()(size_t run)
+					{
+						EVP_CIPHER_CTX& ctx = m_contexts[run]->raw();
+
+						key_wrap_entry* const first = m_entries + run * m_entries_per_run;
+						key_wrap_entry* const last = m_entries + std::min((run + 1) * m_entries_per_run, m_entries_count);
+
+						for (key_wrap_entry* entry = first; entry != last; ++entry)
+						{
+							int len = 0;
+
+							// Every update is a complete wrap or unwrap operation: the key schedule is kept.
+							if (EVP_CipherUpdate(&ctx, static_cast<unsigned char*>(entry->out), &len, static_cast<const unsigned char*>(entry->in), static_cast<int>(entry->in_len)) > 0)
+							{
+								entry->result_len = static_cast<size_t>(len);
+							}
+							else
+							{
+								error::throw_error_if_not(m_direction == cipher_context::decrypt);
+
+								// A failed integrity check is a regular outcome: don't leave it in the error queue.
+								ERR_clear_error();
+								OPENSSL_cleanse(entry->out, entry->in_len - semiblock_size);
+
+								entry->result_len = 0;
+							}
+						}
+					}
+
+				private:
+
+					std::vector<boost::shared_ptr<cipher_context> >& m_contexts;
+					cipher_context::cipher_direction m_direction;
+					key_wrap_entry* m_entries;
+					size_t m_entries_count;
+					size_t m_entries_per_run;
+			};
+
+			void process(const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, const void* kek, size_t kek_len, key_wrap_entry* entries, size_t entries_count, unsigned int threads_count)
+			{
+				check_algorithm(algorithm);
+				check_entries(algorithm, direction, entries, entries_count);
+
+				if (threads_count == 0)
+				{
+					threads_count = default_threads_count();
+				}
+
+				// One run per thread, unless the runs would get too small.
+				const size_t runs_count = std::max(std::min(static_cast<size_t>(threads_count), entries_count / minimum_entries_per_run), static_cast<size_t>(1));
+				const size_t entries_per_run = (entries_count + runs_count - 1) / runs_count;
+
+				std::vector<boost::shared_ptr<cipher_context> > contexts(runs_count);
+
+				for (size_t i = 0; i < runs_count; ++i)
+				{
+					contexts[i].reset(new cipher_context());
+
+					// OpenSSL refuses key wrap algorithms unless explicitly allowed.
+					EVP_CIPHER_CTX_set_flags(&contexts[i]->raw(), EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
+					contexts[i]->initialize(algorithm, direction, kek, kek_len, NULL, algorithm.iv_length());
+				}
+
+				if (entries_count > 0)
+				{
+					parallel_for(runs_count, static_cast<unsigned int>(runs_count), key_wrap_worker(contexts, direction, entries, entries_count, entries_per_run));
+				}
+			}
+		}
+
+		size_t get_wrapped_key_size(const cipher_algorithm& algorithm, size_t key_len)
+		{
+			check_algorithm(algorithm);
+
+			if (is_padded(algorithm))
+			{
+				return (key_len + semiblock_size - 1) / semiblock_size * semiblock_size + semiblock_size;
+			}
+
+			return key_len + semiblock_size;
+		}
+
+		size_t key_wrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, void* out, size_t out_len, const void* key, size_t key_len)
+		{
+			key_wrap_entry entry = { key, key_len, out, out_len, 0 };
+
+			process(algorithm, cipher_context::encrypt, kek, kek_len, &entry, 1, 1);
+
+			return entry.result_len;
+		}
+
+		size_t key_unwrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, void* out, size_t out_len, const void* wrapped_key, size_t wrapped_key_len)
+		{
+			key_wrap_entry entry = { wrapped_key, wrapped_key_len, out, out_len, 0 };
+
+			process(algorithm, cipher_context::decrypt, kek, kek_len, &entry, 1, 1);
+
+			return entry.result_len;
+		}
+
+		void key_wrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, key_wrap_entry* entries, size_t entries_count, unsigned int threads_count)
+		{
+			process(algorithm, cipher_context::encrypt, kek, kek_len, entries, entries_count, threads_count);
+		}
+
+		size_t key_unwrap(const cipher_algorithm& algorithm, const void* kek, size_t kek_len, key_wrap_entry* entries, size_t entries_count, unsigned int threads_count)
+		{
+			process(algorithm, cipher_context::decrypt, kek, kek_len, entries, entries_count, threads_count);
+
+			size_t result = 0;
+
+			for (const key_wrap_entry* entry = entries; entry != entries + entries_count; ++entry)
+			{
+				if (entry->result_len > 0)
+				{
+					++result;
+				}
+			}
+
+			return result;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file keystream_cipher.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A keystream precomputing cipher class.
+ */
+
+#include "cipher/keystream_cipher.hpp"
+
+#include <openssl/crypto.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			// The background thread publishes its keystream by segments of at most this size.
+			const size_t segment_size = 16384;
+
+			const size_t counter_block_size = 16;
+			const size_t chacha20_block_size = 64;
+
+			void add_to_counter(unsigned char* counter, boost::uint64_t blocks, bool little_endian)
+			{
+				unsigned int carry = 0;
+
+				for (size_t n = 0; n < counter_block_size; ++n)
+				{
+					const size_t i = little_endian ? n : counter_block_size - 1 - n;
+					const unsigned int sum = counter[i] + static_cast<unsigned int>(blocks & 0xff) + carry;
+
+					counter[i] = static_cast<unsigned char>(sum & 0xff);
+					carry = sum >> 8;
+					blocks >>= 8;
+				}
+			}
+
+			void xor_buffers(unsigned char* out, const unsigned char* in, const unsigned char* keystream, size_t len)
+			{
+				size_t i = 0;
+
+				// Word-sized steps: compilers turn this loop into vector instructions.
+				for (; i + sizeof(size_t) <= len; i += sizeof(size_t))
+				{
+					size_t data;
+					size_t key;
+
+					std::memcpy(&data, in + i, sizeof(data));
+					std::memcpy(&key, keystream + i, sizeof(key));
+
+					data ^= key;
+
+					std::memcpy(out + i, &data, sizeof(data));
+				}
+
+				for (; i < len; ++i)
+				{
+					out[i] = in[i] ^ keystream[i];
+				}
+			}
+		}
+
+		// Large enough to absorb bursts of full-sized datagrams, small enough to stay in the L2 cache.
+		const size_t keystream_cipher::default_buffer_size = 262144;
+
+		keystream_cipher::keystream_cipher(const cipher_algorithm& _algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, size_t buffer_size) :
+			m_algorithm(_algorithm),
+			m_keystream_block_size(counter_block_size),
+			m_buffer(buffer_size),
+			m_context_position(0),
+			m_produced(0),
+			m_consumed(0),
+			m_misses(0),
+			m_stopped(false),
+			m_producer_waiting(false)
+		{
+			assert(key);
+			assert(iv);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+			if (m_algorithm.type() == NID_chacha20)
+			{
+				m_keystream_block_size = chacha20_block_size;
+			}
+			else
+#endif
+			if ((m_algorithm.mode() != EVP_CIPH_CTR_MODE) || (m_algorithm.iv_length() != counter_block_size))
+			{
+				throw std::invalid_argument("algorithm");
+			}
+
+			if (buffer_size == 0)
+			{
+				throw std::invalid_argument("buffer_size");
+			}
+
+			if (iv_len != m_algorithm.iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			m_iv.assign(static_cast<const unsigned char*>(iv), static_cast<const unsigned char*>(iv) + iv_len);
+
+			m_context.initialize(m_algorithm, cipher_context::encrypt, key, key_len, iv, iv_len);
+			m_producer_context.initialize(m_algorithm, cipher_context::encrypt, key, key_len, iv, iv_len);
+
+			// Without a spare core, the background thread would only compete with the callers of update().
+			if (boost::thread::hardware_concurrency() > 1)
+			{
+				m_thread = boost::thread(&keystream_cipher::produce, this);
+			}
+		}
+
+		keystream_cipher::~keystream_cipher()
+		{
+			m_stopped = true;
+
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				m_condition.notify_one();
+			}
+
+			if (m_thread.joinable())
+			{
+				m_thread.join();
+			}
+
+			OPENSSL_cleanse(&m_buffer[0], m_buffer.size());
+		}
+
+		void keystream_cipher::update(void* out, const void* in, size_t len)
+		{
+			assert(out);
+			assert(in || (len == 0));
+
+			unsigned char* cout = static_cast<unsigned char*>(out);
+			const unsigned char* cin = static_cast<const unsigned char*>(in);
+
+			boost::uint64_t consumed = m_consumed.load(boost::memory_order_relaxed);
+			const boost::uint64_t produced = m_produced.load(boost::memory_order_acquire);
+
+			while ((len > 0) && (consumed < produced))
+			{
+				const size_t offset = static_cast<size_t>(consumed % m_buffer.size());
+				const size_t cnt = static_cast<size_t>(std::min<boost::uint64_t>(std::min(len, m_buffer.size() - offset), produced - consumed));
+
+				xor_buffers(cout, cin, &m_buffer[offset], cnt);
+
+				cout += cnt;
+				cin += cnt;
+				len -= cnt;
+				consumed += cnt;
+			}
+
+			if (len > 0)
+			{
+				// The ring buffer is exhausted: the background thread will skip what we cipher here.
+				if (m_context_position != consumed)
+				{
+					seek(m_context, consumed);
+				}
+
+				int ilen = 0;
+
+				error::throw_error_if_not(EVP_EncryptUpdate(&m_context.raw(), cout, &ilen, cin, static_cast<int>(len)) != 0);
+
+				consumed += len;
+				m_context_position = consumed;
+				m_misses += len;
+			}
+
+			m_consumed.store(consumed);
+
+			if (m_producer_waiting.load() && is_refill_needed(m_produced.load(), consumed))
+			{
+				boost::mutex::scoped_lock lock(m_mutex);
+
+				m_condition.notify_one();
+			}
+		}
+
+		void keystream_cipher::seek(cipher_context& ctx, boost::uint64_t position) const
+		{
+			unsigned char counter[counter_block_size];
+
+			std::copy(m_iv.begin(), m_iv.end(), counter);
+
+			// OpenSSL increments the ChaCha20 counter block in little endian order and the CTR one in big endian order.
+			add_to_counter(counter, position / m_keystream_block_size, m_keystream_block_size != counter_block_size);
+
+			ctx.set_iv(counter, sizeof(counter));
+
+			const size_t skip = static_cast<size_t>(position % m_keystream_block_size);
+
+			if (skip > 0)
+			{
+				unsigned char discard[chacha20_block_size] = {};
+
+				ctx.update_in_place(discard, skip);
+			}
+		}
+
+		void keystream_cipher::produce()
+		{
+			const size_t buffer_size = m_buffer.size();
+			boost::uint64_t position = 0;
+
+			try
+			{
+				while (!m_stopped)
+				{
+					const boost::uint64_t consumed = m_consumed.load(boost::memory_order_acquire);
+
+					if (position < consumed)
+					{
+						seek(m_producer_context, consumed);
+						position = consumed;
+					}
+
+					if (position - consumed == buffer_size)
+					{
+						boost::mutex::scoped_lock lock(m_mutex);
+
+						m_producer_waiting = true;
+
+						// Once the ring buffer is full, wait for it to be half empty before filling it again.
+						while (!m_stopped && !is_refill_needed(position, m_consumed.load()))
+						{
+							m_condition.wait(lock);
+						}
+
+						m_producer_waiting = false;
+
+						continue;
+					}
+
+					const size_t offset = static_cast<size_t>(position % buffer_size);
+					const size_t cnt = static_cast<size_t>(std::min<boost::uint64_t>(std::min(segment_size, buffer_size - offset), consumed + buffer_size - position));
+
+					std::memset(&m_buffer[offset], 0x00, cnt);
+					m_producer_context.update_in_place(&m_buffer[offset], cnt);
+
+					position += cnt;
+
+					m_produced.store(position, boost::memory_order_release);
+				}
+			}
+			catch (...)
+			{
+				// update() keeps working synchronously without the background thread.
+			}
+		}
+
+		bool keystream_cipher::is_refill_needed(boost::uint64_t produced, boost::uint64_t consumed) const
+		{
+			return (produced <= consumed + m_buffer.size() / 2);
+		}
+	}
+}
+
+#endif
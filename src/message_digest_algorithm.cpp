@@ -44,6 +44,15 @@
 
 #include "hash/message_digest_algorithm.hpp"
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/err.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+
+#include <map>
+#endif
+
 #include <stdexcept>
 #include <cassert>
 
@@ -51,8 +60,112 @@ namespace cryptoplus
 {
 	namespace hash
 	{
+		namespace
+		{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+			// The algorithms fetched so far. Once published in by_nid, an entry is only read: every thread then finds it without locking.
+			struct fetched_digests_cache
+			{
+				typedef std::map<const EVP_MD*, const EVP_MD*> map_type;
+
+				// Higher than any NID OpenSSL 3 defines: an algorithm with a greater NID is only looked up under the mutex.
+				static const int nid_table_size = 2048;
+
+				boost::mutex mutex;
+				map_type fetched;
+				boost::atomic<const map_type::value_type*> by_nid[nid_table_size];
+
+				fetched_digests_cache()
+				{
+					for (int nid = 0; nid < nid_table_size; ++nid)
+					{
+						by_nid[nid].store(NULL, boost::memory_order_relaxed);
+					}
+				}
+			};
+
+			fetched_digests_cache& get_fetched_digests()
+			{
+				// A function-local static is built on first use, even from the constructor of another static object.
+				static fetched_digests_cache cache;
+
+				return cache;
+			}
+
+			const EVP_MD* fetch(const EVP_MD* md)
+			{
+				// Already fetched handles are taken as is, without locking.
+				if (!md || EVP_MD_get0_provider(md))
+				{
+					return md;
+				}
+
+				fetched_digests_cache& cache = get_fetched_digests();
+				const int nid = EVP_MD_get_type(md);
+				const bool in_table = (nid > 0) && (nid < fetched_digests_cache::nid_table_size);
+
+				if (in_table)
+				{
+					const fetched_digests_cache::map_type::value_type* entry = cache.by_nid[nid].load(boost::memory_order_acquire);
+
+					// Another legacy pointer with the same NID (from an engine, for instance) goes through the map.
+					if (entry && (entry->first == md))
+					{
+						return entry->second;
+					}
+				}
+
+				boost::mutex::scoped_lock lock(cache.mutex);
+
+				fetched_digests_cache::map_type::iterator it = cache.fetched.find(md);
+
+				if (it == cache.fetched.end())
+				{
+					ERR_set_mark();
+
+					const EVP_MD* fetched = EVP_MD_fetch(NULL, EVP_MD_get0_name(md), NULL);
+
+					if (!fetched)
+					{
+						// The algorithm is not provided (it may come from an engine): the legacy one is used instead.
+						ERR_pop_to_mark();
+
+						fetched = md;
+					}
+					else
+					{
+						ERR_clear_last_mark();
+					}
+
+					// The reference is never released: the handle is meant to outlive every context that uses it.
+					it = cache.fetched.insert(std::make_pair(md, fetched)).first;
+				}
+
+				// The map never erases its nodes, so the entry address stays valid.
+				if (in_table && !cache.by_nid[nid].load(boost::memory_order_relaxed))
+				{
+					cache.by_nid[nid].store(&*it, boost::memory_order_release);
+				}
+
+				return it->second;
+			}
+#else
+			const EVP_MD* fetch(const EVP_MD* md)
+			{
+				return md;
+			}
+#endif
+		}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		message_digest_algorithm::message_digest_algorithm(const EVP_MD* md) :
+			m_md(fetch(md))
+		{
+		}
+#endif
+
 		message_digest_algorithm::message_digest_algorithm(int _type) :
-			m_md(EVP_get_digestbynid(_type))
+			m_md(fetch(EVP_get_digestbynid(_type)))
 		{
 			if (!m_md)
 			{
@@ -61,7 +174,7 @@ namespace cryptoplus
 		}
 
 		message_digest_algorithm::message_digest_algorithm(const std::string& _name) :
-			m_md(EVP_get_digestbyname(_name.c_str()))
+			m_md(fetch(EVP_get_digestbyname(_name.c_str())))
 		{
 			if (!m_md)
 			{
@@ -0,0 +1,562 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file message_digest_batch.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Multi-buffer message digest functions.
+ */
+
+#include "hash/message_digest.hpp"
+#include "hash/message_digest_context.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/atomic.hpp>
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MULTI_BUFFER_AVX2
+#define AVX2_TARGET __attribute__((target("avx2")))
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define MULTI_BUFFER_AVX2
+#define AVX2_TARGET
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace cryptoplus
+{
+	namespace hash
+	{
+		namespace
+		{
+			void digest_one_by_one(const message_digest_algorithm& algorithm, const const_buffer* inputs, const mutable_buffer* outputs, size_t count)
+			{
+				// A single context is reused: only its state is reset between two buffers.
+				message_digest_context ctx;
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					ctx.initialize(algorithm);
+					ctx.update(inputs[i].data, inputs[i].size);
+					ctx.finalize(outputs[i].data, outputs[i].size);
+				}
+			}
+
+#ifdef MULTI_BUFFER_AVX2
+			bool has_avx2(bool& sha_extensions)
+			{
+#ifdef _MSC_VER
+				int info[4];
+
+				__cpuid(info, 0);
+
+				if (info[0] < 7)
+				{
+					return false;
+				}
+
+				__cpuid(info, 1);
+
+				// The operating system must save the AVX registers (OSXSAVE and AVX).
+				if ((info[2] & 0x18000000) != 0x18000000)
+				{
+					return false;
+				}
+
+				if ((_xgetbv(0) & 0x06) != 0x06)
+				{
+					return false;
+				}
+
+				__cpuidex(info, 7, 0);
+
+				sha_extensions = ((info[1] & 0x20000000) != 0);
+
+				return ((info[1] & 0x20) != 0);
+#else
+				unsigned int eax = 0;
+				unsigned int ebx = 0;
+				unsigned int ecx = 0;
+				unsigned int edx = 0;
+
+				if (__get_cpuid_max(0, NULL) < 7)
+				{
+					return false;
+				}
+
+				__cpuid(1, eax, ebx, ecx, edx);
+
+				// The operating system must save the AVX registers (OSXSAVE and AVX).
+				if ((ecx & 0x18000000) != 0x18000000)
+				{
+					return false;
+				}
+
+				unsigned int xcr0 = 0;
+				unsigned int xcr0_high = 0;
+
+				__asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0_high) : "c" (0));
+
+				if ((xcr0 & 0x06) != 0x06)
+				{
+					return false;
+				}
+
+				__cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+				sha_extensions = ((ebx & 0x20000000) != 0);
+
+				return ((ebx & 0x20) != 0);
+#endif
+			}
+
+			bool sha_extensions_supported = false;
+			const bool avx2_supported = has_avx2(sha_extensions_supported);
+
+			// AVX2 must be there, but not the SHA extensions: hashing the messages one after the other with them is faster.
+			// Read once per batch: detail::set_batch_mode() may change it while other threads hash.
+			boost::atomic<bool> multi_buffer_enabled(avx2_supported && !sha_extensions_supported);
+
+			const size_t lanes_count = 8;
+			const size_t block_size = 64;
+
+			inline boost::uint32_t load_be32(const unsigned char* buf)
+			{
+				return (static_cast<boost::uint32_t>(buf[0]) << 24) | (static_cast<boost::uint32_t>(buf[1]) << 16) | (static_cast<boost::uint32_t>(buf[2]) << 8) | static_cast<boost::uint32_t>(buf[3]);
+			}
+
+			inline void store_be32(unsigned char* buf, boost::uint32_t value)
+			{
+				buf[0] = static_cast<unsigned char>(value >> 24);
+				buf[1] = static_cast<unsigned char>(value >> 16);
+				buf[2] = static_cast<unsigned char>(value >> 8);
+				buf[3] = static_cast<unsigned char>(value);
+			}
+
+			AVX2_TARGET inline __m256i rotl(__m256i x, int n)
+			{
+				return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+			}
+
+			AVX2_TARGET inline __m256i rotr(__m256i x, int n)
+			{
+				return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+			}
+
+			AVX2_TARGET inline __m256i add(__m256i x, __m256i y)
+			{
+				return _mm256_add_epi32(x, y);
+			}
+
+			AVX2_TARGET inline __m256i xor3(__m256i x, __m256i y, __m256i z)
+			{
+				return _mm256_xor_si256(_mm256_xor_si256(x, y), z);
+			}
+
+			struct sha1_core
+			{
+				static const size_t state_words = 5;
+				static const boost::uint32_t iv[state_words];
+
+				AVX2_TARGET static void compress(__m256i* state, __m256i* w)
+				{
+					__m256i a = state[0];
+					__m256i b = state[1];
+					__m256i c = state[2];
+					__m256i d = state[3];
+					__m256i e = state[4];
+
+					for (size_t t = 0; t < 80; ++t)
+					{
+						if (t >= 16)
+						{
+							w[t & 15] = rotl(_mm256_xor_si256(xor3(w[(t - 3) & 15], w[(t - 8) & 15], w[(t - 14) & 15]), w[t & 15]), 1);
+						}
+
+						__m256i f;
+						boost::uint32_t k;
+
+						if (t < 20)
+						{
+							f = _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+							k = 0x5a827999;
+						}
+						else if (t < 40)
+						{
+							f = xor3(b, c, d);
+							k = 0x6ed9eba1;
+						}
+						else if (t < 60)
+						{
+							f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+							k = 0x8f1bbcdc;
+						}
+						else
+						{
+							f = xor3(b, c, d);
+							k = 0xca62c1d6;
+						}
+
+						const __m256i temp = add(add(rotl(a, 5), f), add(add(e, _mm256_set1_epi32(static_cast<int>(k))), w[t & 15]));
+
+						e = d;
+						d = c;
+						c = rotl(b, 30);
+						b = a;
+						a = temp;
+					}
+
+					state[0] = add(state[0], a);
+					state[1] = add(state[1], b);
+					state[2] = add(state[2], c);
+					state[3] = add(state[3], d);
+					state[4] = add(state[4], e);
+				}
+			};
+
+			const boost::uint32_t sha1_core::iv[sha1_core::state_words] = {
+				0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+			};
+
+			struct sha256_core
+			{
+				static const size_t state_words = 8;
+				static const boost::uint32_t iv[state_words];
+				static const boost::uint32_t k[64];
+
+				AVX2_TARGET static void compress(__m256i* state, __m256i* w)
+				{
+					__m256i a = state[0];
+					__m256i b = state[1];
+					__m256i c = state[2];
+					__m256i d = state[3];
+					__m256i e = state[4];
+					__m256i f = state[5];
+					__m256i g = state[6];
+					__m256i h = state[7];
+
+					for (size_t t = 0; t < 64; ++t)
+					{
+						if (t >= 16)
+						{
+							const __m256i w2 = w[(t - 2) & 15];
+							const __m256i w15 = w[(t - 15) & 15];
+							const __m256i s0 = xor3(rotr(w15, 7), rotr(w15, 18), _mm256_srli_epi32(w15, 3));
+							const __m256i s1 = xor3(rotr(w2, 17), rotr(w2, 19), _mm256_srli_epi32(w2, 10));
+
+							w[t & 15] = add(add(w[t & 15], s0), add(w[(t - 7) & 15], s1));
+						}
+
+						const __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+						const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+						const __m256i t1 = add(add(h, xor3(rotr(e, 6), rotr(e, 11), rotr(e, 25))), add(add(ch, _mm256_set1_epi32(static_cast<int>(k[t]))), w[t & 15]));
+						const __m256i t2 = add(xor3(rotr(a, 2), rotr(a, 13), rotr(a, 22)), maj);
+
+						h = g;
+						g = f;
+						f = e;
+						e = add(d, t1);
+						d = c;
+						c = b;
+						b = a;
+						a = add(t1, t2);
+					}
+
+					state[0] = add(state[0], a);
+					state[1] = add(state[1], b);
+					state[2] = add(state[2], c);
+					state[3] = add(state[3], d);
+					state[4] = add(state[4], e);
+					state[5] = add(state[5], f);
+					state[6] = add(state[6], g);
+					state[7] = add(state[7], h);
+				}
+			};
+
+			const boost::uint32_t sha256_core::iv[sha256_core::state_words] = {
+				0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+			};
+
+			const boost::uint32_t sha256_core::k[64] = {
+				0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+				0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+				0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+				0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+				0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+				0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+				0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+				0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+			};
+
+			/*
+			 * A lane of the vector registers, and the message it is hashing.
+			 */
+			struct lane
+			{
+				size_t index;
+				const unsigned char* data;
+				size_t full_blocks;
+				unsigned char tail[2 * block_size];
+				size_t tail_offset;
+				size_t tail_blocks;
+				bool active;
+
+				void start(size_t _index, const const_buffer& input)
+				{
+					index = _index;
+					data = static_cast<const unsigned char*>(input.data);
+					full_blocks = input.size / block_size;
+
+					// The last bytes of the message, the 0x80 terminator, the padding and the bit length (as a 64-bits big-endian integer).
+					const size_t remaining = input.size % block_size;
+					tail_offset = 0;
+					tail_blocks = (remaining + 9 > block_size) ? 2 : 1;
+
+					std::memset(tail, 0x00, sizeof(tail));
+
+					if (remaining > 0)
+					{
+						std::memcpy(tail, data + full_blocks * block_size, remaining);
+					}
+
+					tail[remaining] = 0x80;
+
+					boost::uint64_t bits = static_cast<boost::uint64_t>(input.size) * 8;
+
+					for (size_t i = tail_blocks * block_size; i-- > tail_blocks * block_size - 8; bits >>= 8)
+					{
+						tail[i] = static_cast<unsigned char>(bits & 0xff);
+					}
+
+					active = true;
+				}
+
+				const unsigned char* next_block()
+				{
+					if (full_blocks > 0)
+					{
+						const unsigned char* const result = data;
+
+						data += block_size;
+						--full_blocks;
+
+						return result;
+					}
+
+					const unsigned char* const result = tail + tail_offset;
+
+					tail_offset += block_size;
+					--tail_blocks;
+
+					return result;
+				}
+
+				bool is_done() const
+				{
+					return (full_blocks == 0) && (tail_blocks == 0);
+				}
+			};
+
+			template <typename Core>
+			AVX2_TARGET void digest_multi_buffer(const const_buffer* inputs, const mutable_buffer* outputs, size_t count, size_t result_size)
+			{
+				static const unsigned char idle_block[block_size] = {};
+
+				lane lanes[lanes_count];
+				boost::uint32_t states[Core::state_words][lanes_count];
+				size_t next = 0;
+				size_t active_count = 0;
+
+				for (size_t l = 0; l < lanes_count; ++l)
+				{
+					lanes[l].active = false;
+
+					if (next < count)
+					{
+						lanes[l].start(next, inputs[next]);
+						++next;
+						++active_count;
+					}
+
+					for (size_t i = 0; i < Core::state_words; ++i)
+					{
+						states[i][l] = Core::iv[i];
+					}
+				}
+
+				while (active_count > 0)
+				{
+					const unsigned char* blocks[lanes_count];
+
+					for (size_t l = 0; l < lanes_count; ++l)
+					{
+						blocks[l] = lanes[l].active ? lanes[l].next_block() : idle_block;
+					}
+
+					// Lane l of w[i] holds the i-th big-endian word of the block of lane l.
+					__m256i w[16];
+
+					for (size_t i = 0; i < 16; ++i)
+					{
+						w[i] = _mm256_setr_epi32(
+							static_cast<int>(load_be32(blocks[0] + 4 * i)),
+							static_cast<int>(load_be32(blocks[1] + 4 * i)),
+							static_cast<int>(load_be32(blocks[2] + 4 * i)),
+							static_cast<int>(load_be32(blocks[3] + 4 * i)),
+							static_cast<int>(load_be32(blocks[4] + 4 * i)),
+							static_cast<int>(load_be32(blocks[5] + 4 * i)),
+							static_cast<int>(load_be32(blocks[6] + 4 * i)),
+							static_cast<int>(load_be32(blocks[7] + 4 * i))
+						);
+					}
+
+					__m256i state[Core::state_words];
+
+					for (size_t i = 0; i < Core::state_words; ++i)
+					{
+						state[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states[i]));
+					}
+
+					Core::compress(state, w);
+
+					for (size_t i = 0; i < Core::state_words; ++i)
+					{
+						_mm256_storeu_si256(reinterpret_cast<__m256i*>(states[i]), state[i]);
+					}
+
+					// The lanes that are done give their result and take the next message, if any.
+					for (size_t l = 0; l < lanes_count; ++l)
+					{
+						if (!lanes[l].active || !lanes[l].is_done())
+						{
+							continue;
+						}
+
+						unsigned char result[Core::state_words * 4];
+
+						for (size_t i = 0; i < Core::state_words; ++i)
+						{
+							store_be32(result + 4 * i, states[i][l]);
+							states[i][l] = Core::iv[i];
+						}
+
+						const mutable_buffer& output = outputs[lanes[l].index];
+
+						assert(output.size >= result_size);
+
+						std::memcpy(output.data, result, result_size);
+
+						lanes[l].active = false;
+
+						if (next < count)
+						{
+							lanes[l].start(next, inputs[next]);
+							++next;
+						}
+						else
+						{
+							--active_count;
+						}
+					}
+				}
+			}
+#endif
+		}
+
+		void message_digest_batch(const message_digest_algorithm& algorithm, const const_buffer* inputs, const mutable_buffer* outputs, size_t count)
+		{
+			assert(inputs || (count == 0));
+			assert(outputs || (count == 0));
+
+#ifdef MULTI_BUFFER_AVX2
+			// With a single message, most lanes would be idle.
+			if (multi_buffer_enabled.load(boost::memory_order_relaxed) && (count > 1))
+			{
+				switch (algorithm.type())
+				{
+					case NID_sha1:
+						digest_multi_buffer<sha1_core>(inputs, outputs, count, algorithm.result_size());
+						return;
+					case NID_sha256:
+						digest_multi_buffer<sha256_core>(inputs, outputs, count, algorithm.result_size());
+						return;
+					default:
+						break;
+				}
+			}
+#endif
+
+			digest_one_by_one(algorithm, inputs, outputs, count);
+		}
+
+		namespace detail
+		{
+			bool set_batch_mode(batch_mode mode)
+			{
+#ifdef MULTI_BUFFER_AVX2
+				switch (mode)
+				{
+					case batch_auto:
+						multi_buffer_enabled.store(avx2_supported && !sha_extensions_supported, boost::memory_order_relaxed);
+						return true;
+					case batch_one_by_one:
+						multi_buffer_enabled.store(false, boost::memory_order_relaxed);
+						return true;
+					case batch_multi_buffer:
+						if (!avx2_supported)
+						{
+							return false;
+						}
+
+						multi_buffer_enabled.store(true, boost::memory_order_relaxed);
+						return true;
+				}
+
+				return false;
+#else
+				return (mode != batch_multi_buffer);
+#endif
+			}
+		}
+	}
+}
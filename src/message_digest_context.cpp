@@ -58,7 +58,7 @@ namespace cryptoplus
 
 			unsigned int ilen = static_cast<unsigned int>(md_len);
 
-			error::throw_error_if_not(EVP_DigestFinal_ex(&m_ctx, static_cast<unsigned char*>(md), &ilen) != 0);
+			error::throw_error_if_not(EVP_DigestFinal_ex(m_ctx, static_cast<unsigned char*>(md), &ilen) != 0);
 
 			return ilen;
 		}
@@ -69,14 +69,14 @@ namespace cryptoplus
 
 			unsigned int ilen = static_cast<unsigned int>(sig_len);
 
-			error::throw_error_if_not(EVP_SignFinal(&m_ctx, static_cast<unsigned char*>(sig), &ilen, pkey.raw()) != 0);
+			error::throw_error_if_not(EVP_SignFinal(m_ctx, static_cast<unsigned char*>(sig), &ilen, pkey.raw()) != 0);
 
 			return ilen;
 		}
 
 		bool message_digest_context::verify_finalize(const void* sig, size_t sig_len, pkey::pkey& pkey)
 		{
-			int result = EVP_VerifyFinal(&m_ctx, static_cast<const unsigned char*>(sig), static_cast<unsigned int>(sig_len), pkey.raw());
+			int result = EVP_VerifyFinal(m_ctx, static_cast<const unsigned char*>(sig), static_cast<unsigned int>(sig_len), pkey.raw());
 
 			error::throw_error_if(result < 0);
 
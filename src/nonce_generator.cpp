@@ -0,0 +1,158 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file nonce_generator.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A per-thread nonce generator class.
+ */
+
+#include "cipher/nonce_generator.hpp"
+
+#include "random/random.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			// Identifies each nonce_generator, so that a thread never reuses the state of a destroyed one.
+			boost::atomic<boost::uint64_t> next_generator_id(1);
+		}
+
+		nonce_exhausted_error::nonce_exhausted_error() :
+			std::runtime_error("The nonces are exhausted: the key must be rotated")
+		{
+		}
+
+		const size_t nonce_generator::default_nonce_size = 12;
+
+		const boost::uint64_t nonce_generator::default_limit = std::numeric_limits<boost::uint64_t>::max();
+
+		nonce_generator::nonce_generator(size_t _nonce_size, boost::uint64_t limit) :
+			m_id(next_generator_id.fetch_add(1, boost::memory_order_relaxed)),
+			m_nonce_size(_nonce_size),
+			m_limit(limit),
+			m_threads_count(0)
+		{
+			if ((m_nonce_size < counter_size + 4) || (m_nonce_size > counter_size + maximum_prefix_size))
+			{
+				throw std::invalid_argument("nonce_size");
+			}
+
+			if (m_limit == 0)
+			{
+				throw std::invalid_argument("limit");
+			}
+
+			random::get_random_bytes(m_base, sizeof(m_base));
+		}
+
+		void nonce_generator::generate(void* nonce, size_t nonce_len)
+		{
+			assert(nonce);
+
+			if (nonce_len != m_nonce_size)
+			{
+				throw std::invalid_argument("nonce_len");
+			}
+
+			thread_state& state = get_thread_state();
+
+			if (state.counter >= m_limit)
+			{
+				throw nonce_exhausted_error();
+			}
+
+			const size_t prefix_size = m_nonce_size - counter_size;
+			unsigned char* const cnonce = static_cast<unsigned char*>(nonce);
+
+			std::memcpy(cnonce, state.prefix, prefix_size);
+
+			boost::uint64_t counter = state.counter++;
+
+			for (size_t i = 0; i < counter_size; ++i, counter >>= 8)
+			{
+				cnonce[m_nonce_size - 1 - i] = static_cast<unsigned char>(counter & 0xff);
+			}
+		}
+
+		nonce_generator::thread_state& nonce_generator::get_thread_state() const
+		{
+			thread_state* state = m_thread_states.get();
+
+			if (state && (state->generator_id == m_id))
+			{
+				return *state;
+			}
+
+			const size_t prefix_size = m_nonce_size - counter_size;
+			boost::uint64_t index = m_threads_count.fetch_add(1, boost::memory_order_relaxed);
+
+			// The prefix space must be large enough for every thread to get its own prefix.
+			if ((prefix_size < sizeof(index)) && ((index >> (8 * prefix_size)) != 0))
+			{
+				throw nonce_exhausted_error();
+			}
+
+			state = new thread_state();
+			state->generator_id = m_id;
+			state->counter = 0;
+
+			// prefix = base + index, as big-endian integers.
+			unsigned int carry = 0;
+
+			for (size_t i = prefix_size; i-- > 0; index >>= 8)
+			{
+				const unsigned int sum = m_base[i] + static_cast<unsigned int>(index & 0xff) + carry;
+
+				state->prefix[i] = static_cast<unsigned char>(sum & 0xff);
+				carry = sum >> 8;
+			}
+
+			m_thread_states.reset(state);
+
+			return *state;
+		}
+	}
+}
@@ -0,0 +1,588 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file parallel_cipher.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief Multi-threaded counter mode ciphering functions.
+ */
+
+#include "cipher/parallel_cipher.hpp"
+
+#include "cipher/cipher_context.hpp"
+#include "parallel.hpp"
+
+#include <openssl/crypto.h>
+
+#include <boost/cstdint.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			const size_t counter_block_size = 16;
+
+			// Chunks smaller than this are not worth a thread.
+			const size_t minimum_chunk_size = 64 * 1024;
+
+			// The ciphering and the hashing of a chunk are interleaved by steps of this size, so that the data is still in cache when it is hashed.
+			const size_t step_size = 32 * 1024;
+
+			// The maximum plaintext length for GCM with a 96 bits iv: (2^32 - 2) blocks.
+			const boost::uint64_t gcm_maximum_length = (static_cast<boost::uint64_t>(1) << 36) - 32;
+
+			const size_t gcm_iv_length = 12;
+
+			// The tag lengths that EVP_CTRL_GCM_SET_TAG accepts.
+			const size_t gcm_minimum_tag_length = 12;
+
+			size_t get_chunk_size(size_t len, unsigned int threads_count)
+			{
+				if (threads_count == 0)
+				{
+					threads_count = default_threads_count();
+				}
+
+				size_t chunk_size = (len + threads_count - 1) / threads_count;
+				chunk_size = (chunk_size + counter_block_size - 1) / counter_block_size * counter_block_size;
+
+				return (chunk_size < minimum_chunk_size) ? minimum_chunk_size : chunk_size;
+			}
+
+			void add_to_counter(unsigned char* counter, boost::uint64_t blocks)
+			{
+				unsigned int carry = 0;
+
+				for (size_t i = counter_block_size; i-- > 0;)
+				{
+					const unsigned int sum = counter[i] + static_cast<unsigned int>(blocks & 0xff) + carry;
+
+					counter[i] = static_cast<unsigned char>(sum & 0xff);
+					carry = sum >> 8;
+					blocks >>= 8;
+				}
+			}
+
+			/*
+			 * An element of GF(2^128), as used by GHASH.
+			 *
+			 * hi holds the first 8 bytes of the block in big endian order. The bit ordering is the one of the GCM specification: the most significant bit of hi is the coefficient of x^0.
+			 */
+			struct gf128
+			{
+				boost::uint64_t hi;
+				boost::uint64_t lo;
+			};
+
+			gf128 gf128_load(const unsigned char* buf)
+			{
+				gf128 result = { 0, 0 };
+
+				for (size_t i = 0; i < 8; ++i)
+				{
+					result.hi = (result.hi << 8) | buf[i];
+					result.lo = (result.lo << 8) | buf[i + 8];
+				}
+
+				return result;
+			}
+
+			void gf128_store(unsigned char* buf, gf128 value)
+			{
+				for (size_t i = 8; i-- > 0;)
+				{
+					buf[i] = static_cast<unsigned char>(value.hi & 0xff);
+					buf[i + 8] = static_cast<unsigned char>(value.lo & 0xff);
+					value.hi >>= 8;
+					value.lo >>= 8;
+				}
+			}
+
+			gf128 gf128_xor(const gf128& x, const gf128& y)
+			{
+				const gf128 result = { x.hi ^ y.hi, x.lo ^ y.lo };
+
+				return result;
+			}
+
+			gf128 gf128_multiply(const gf128& x, const gf128& y)
+			{
+				// Algorithm 1 of NIST SP 800-38D. This is only used to combine a few partial results so speed does not matter much.
+				const boost::uint64_t r = static_cast<boost::uint64_t>(0xe1) << 56;
+
+				gf128 z = { 0, 0 };
+				gf128 v = y;
+
+				for (unsigned int i = 0; i < 128; ++i)
+				{
+					const boost::uint64_t word = (i < 64) ? x.hi : x.lo;
+					const boost::uint64_t mask = static_cast<boost::uint64_t>(0) - ((word >> (63 - (i % 64))) & 1);
+
+					z.hi ^= v.hi & mask;
+					z.lo ^= v.lo & mask;
+
+					const boost::uint64_t reduce = static_cast<boost::uint64_t>(0) - (v.lo & 1);
+
+					v.lo = (v.lo >> 1) | (v.hi << 63);
+					v.hi = (v.hi >> 1) ^ (r & reduce);
+				}
+
+				return z;
+			}
+
+			gf128 gf128_one()
+			{
+				const gf128 result = { static_cast<boost::uint64_t>(1) << 63, 0 };
+
+				return result;
+			}
+
+			gf128 gf128_power(gf128 x, boost::uint64_t n)
+			{
+				gf128 result = gf128_one();
+
+				while (n > 0)
+				{
+					if (n & 1)
+					{
+						result = gf128_multiply(result, x);
+					}
+
+					x = gf128_multiply(x, x);
+					n >>= 1;
+				}
+
+				return result;
+			}
+
+			gf128 gf128_inverse(const gf128& x)
+			{
+				// x^-1 = x^(2^128 - 2): 127 one bits followed by a zero bit.
+				gf128 result = gf128_one();
+
+				for (unsigned int i = 0; i < 128; ++i)
+				{
+					result = gf128_multiply(result, result);
+
+					if (i < 127)
+					{
+						result = gf128_multiply(result, x);
+					}
+				}
+
+				return result;
+			}
+
+			gf128 gf128_lengths(boost::uint64_t aad_len, boost::uint64_t len)
+			{
+				const gf128 result = { aad_len * 8, len * 8 };
+
+				return result;
+			}
+
+			bool constant_time_equal(const void* x, const void* y, size_t len)
+			{
+				const unsigned char* cx = static_cast<const unsigned char*>(x);
+				const unsigned char* cy = static_cast<const unsigned char*>(y);
+				unsigned char diff = 0;
+
+				for (size_t i = 0; i < len; ++i)
+				{
+					diff |= cx[i] ^ cy[i];
+				}
+
+				return (diff == 0);
+			}
+
+			void ctr_update(cipher_context& ctx, unsigned char* out, const unsigned char* in, size_t len)
+			{
+				int out_len = 0;
+
+				error::throw_error_if_not(EVP_CipherUpdate(&ctx.raw(), out, &out_len, in, static_cast<int>(len)) != 0);
+			}
+
+			void ghash_update(cipher_context& ctx, const unsigned char* in, size_t len)
+			{
+				int out_len = 0;
+
+				// The data is fed as additional authenticated data, so that the GCM context only computes its GHASH.
+				error::throw_error_if_not(EVP_CipherUpdate(&ctx.raw(), NULL, &out_len, in, static_cast<int>(len)) != 0);
+			}
+
+			gf128 ghash_finalize(cipher_context& ctx)
+			{
+				unsigned char buf[EVP_MAX_BLOCK_LENGTH];
+				unsigned char tag[counter_block_size];
+				int out_len = 0;
+
+				error::throw_error_if_not(EVP_CipherFinal_ex(&ctx.raw(), buf, &out_len) != 0);
+				error::throw_error_if_not(EVP_CIPHER_CTX_ctrl(&ctx.raw(), EVP_CTRL_GCM_GET_TAG, sizeof(tag), tag) != 0);
+
+				return gf128_load(tag);
+			}
+
+			struct gcm_parameters
+			{
+				cipher_algorithm gcm;
+				cipher_algorithm ctr;
+				cipher_algorithm ecb;
+				const void* key;
+				size_t key_len;
+				const void* iv;
+				gf128 h;
+				gf128 h_inverse;
+				gf128 ej0;
+
+				gcm_parameters(const cipher_algorithm& algorithm, const void* _key, size_t _key_len, const void* _iv) :
+					gcm(algorithm),
+					ctr(get_ctr_algorithm(algorithm)),
+					ecb(get_ecb_algorithm(algorithm)),
+					key(_key),
+					key_len(_key_len),
+					iv(_iv)
+				{
+					unsigned char in[2 * counter_block_size] = {};
+					unsigned char out[4 * counter_block_size];
+
+					// H = E(K, 0^128) and E(K, J0), with J0 = IV || 0^31 || 1.
+					std::memcpy(in + counter_block_size, iv, gcm_iv_length);
+					in[2 * counter_block_size - 1] = 0x01;
+
+					cipher_context ctx;
+					ctx.initialize(ecb, cipher_context::encrypt, key, key_len, NULL, 0);
+					ctx.set_padding(false);
+					ctx.update(out, sizeof(out), in, sizeof(in));
+
+					h = gf128_load(out);
+					h_inverse = gf128_inverse(h);
+					ej0 = gf128_load(out + counter_block_size);
+
+					OPENSSL_cleanse(out, sizeof(out));
+				}
+
+				static cipher_algorithm get_ctr_algorithm(const cipher_algorithm& algorithm)
+				{
+					switch (algorithm.type())
+					{
+						case NID_aes_128_gcm:
+							return cipher_algorithm(EVP_aes_128_ctr());
+						case NID_aes_192_gcm:
+							return cipher_algorithm(EVP_aes_192_ctr());
+						case NID_aes_256_gcm:
+							return cipher_algorithm(EVP_aes_256_ctr());
+					}
+
+					throw std::invalid_argument("algorithm");
+				}
+
+				static cipher_algorithm get_ecb_algorithm(const cipher_algorithm& algorithm)
+				{
+					switch (algorithm.type())
+					{
+						case NID_aes_128_gcm:
+							return cipher_algorithm(EVP_aes_128_ecb());
+						case NID_aes_192_gcm:
+							return cipher_algorithm(EVP_aes_192_ecb());
+						case NID_aes_256_gcm:
+							return cipher_algorithm(EVP_aes_256_ecb());
+					}
+
+					throw std::invalid_argument("algorithm");
+				}
+
+				/*
+				 * Get the GHASH state reached after hashing the given data from a zero state.
+				 *
+				 * The tag that the GCM context computes over the data fed as aad is E(K, J0) ^ (S ^ L) * H, where S is that state and L the lengths block.
+				 */
+				gf128 unmask(const gf128& tag, boost::uint64_t aad_len) const
+				{
+					return gf128_xor(gf128_multiply(gf128_xor(tag, ej0), h_inverse), gf128_lengths(aad_len, 0));
+				}
+			};
+
+			class ctr_chunk_worker
+			{
+				public:
+
+					ctr_chunk_worker(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, unsigned char* out, const unsigned char* in, size_t len, size_t chunk_size) :
+						m_algorithm(algorithm), m_key(key), m_key_len(key_len), m_iv(iv), m_out(out), m_in(in), m_len(len), m_chunk_size(chunk_size)
+					{
+					}
+
+					void operator()(size_t index)
+					{
+						const size_t offset = index * m_chunk_size;
+						const size_t len = std::min(m_chunk_size, m_len - offset);
+
+						unsigned char counter[counter_block_size];
+						std::memcpy(counter, m_iv, counter_block_size);
+						add_to_counter(counter, offset / counter_block_size);
+
+						cipher_context ctx;
+						ctx.initialize(m_algorithm, cipher_context::encrypt, m_key, m_key_len, counter, sizeof(counter));
+
+						for (size_t step = 0; step < len; step += step_size)
+						{
+							ctr_update(ctx, m_out + offset + step, m_in + offset + step, std::min(step_size, len - step));
+						}
+					}
+
+				private:
+
+					cipher_algorithm m_algorithm;
+					const void* m_key;
+					size_t m_key_len;
+					const void* m_iv;
+					unsigned char* m_out;
+					const unsigned char* m_in;
+					size_t m_len;
+					size_t m_chunk_size;
+			};
+
+			class gcm_chunk_worker
+			{
+				public:
+
+					gcm_chunk_worker(const gcm_parameters& parameters, cipher_context::cipher_direction direction, unsigned char* out, const unsigned char* in, size_t len, size_t chunk_size, std::vector<gf128>& states) :
+						m_parameters(parameters), m_direction(direction), m_out(out), m_in(in), m_len(len), m_chunk_size(chunk_size), m_states(states)
+					{
+					}
+
+					void operator()(size_t index)
+					{
+						const size_t offset = index * m_chunk_size;
+						const size_t len = std::min(m_chunk_size, m_len - offset);
+
+						// The data counter blocks start at J0 + 1 = IV || 0^30 || 10.
+						unsigned char counter[counter_block_size] = {};
+						std::memcpy(counter, m_parameters.iv, gcm_iv_length);
+						counter[counter_block_size - 1] = 0x02;
+						add_to_counter(counter, offset / counter_block_size);
+
+						cipher_context ctr_ctx;
+						ctr_ctx.initialize(m_parameters.ctr, cipher_context::encrypt, m_parameters.key, m_parameters.key_len, counter, sizeof(counter));
+
+						cipher_context ghash_ctx;
+						ghash_ctx.initialize(m_parameters.gcm, cipher_context::encrypt, m_parameters.key, m_parameters.key_len, m_parameters.iv, gcm_iv_length);
+
+						for (size_t step = 0; step < len; step += step_size)
+						{
+							unsigned char* const out = m_out + offset + step;
+							const unsigned char* const in = m_in + offset + step;
+							const size_t step_len = std::min(step_size, len - step);
+
+							// GHASH is always computed over the ciphertext. When decrypting, it must be read before out (which may be equal to in) is overwritten.
+							if (m_direction == cipher_context::encrypt)
+							{
+								ctr_update(ctr_ctx, out, in, step_len);
+								ghash_update(ghash_ctx, out, step_len);
+							}
+							else
+							{
+								ghash_update(ghash_ctx, in, step_len);
+								ctr_update(ctr_ctx, out, in, step_len);
+							}
+						}
+
+						m_states[index] = m_parameters.unmask(ghash_finalize(ghash_ctx), len);
+					}
+
+				private:
+
+					const gcm_parameters& m_parameters;
+					cipher_context::cipher_direction m_direction;
+					unsigned char* m_out;
+					const unsigned char* m_in;
+					size_t m_len;
+					size_t m_chunk_size;
+					std::vector<gf128>& m_states;
+			};
+
+			void check_key_and_iv(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv)
+			{
+				assert(key);
+				assert(iv);
+
+				static_cast<void>(key);
+				static_cast<void>(iv);
+
+				if (key_len != algorithm.key_length())
+				{
+					throw std::runtime_error("key_len");
+				}
+			}
+
+			void check_tag(const void* tag, size_t tag_len)
+			{
+				assert(tag);
+
+				static_cast<void>(tag);
+
+				if ((tag_len < gcm_minimum_tag_length) || (tag_len > counter_block_size))
+				{
+					throw std::invalid_argument("tag_len");
+				}
+			}
+
+			gf128 gcm_process(const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, const void* key, size_t key_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* out, const void* in, size_t len, unsigned int threads_count)
+			{
+				assert(out || (len == 0));
+				assert(in || (len == 0));
+				assert(aad || (aad_len == 0));
+
+				check_key_and_iv(algorithm, key, key_len, iv);
+
+				if (iv_len != gcm_iv_length)
+				{
+					throw std::invalid_argument("iv_len");
+				}
+
+				if (static_cast<boost::uint64_t>(len) > gcm_maximum_length)
+				{
+					throw std::invalid_argument("len");
+				}
+
+				const gcm_parameters parameters(algorithm, key, key_len, iv);
+
+				gf128 state = { 0, 0 };
+
+				if (aad_len > 0)
+				{
+					cipher_context ghash_ctx;
+					ghash_ctx.initialize(algorithm, cipher_context::encrypt, key, key_len, iv, iv_len);
+					ghash_update(ghash_ctx, static_cast<const unsigned char*>(aad), aad_len);
+
+					state = parameters.unmask(ghash_finalize(ghash_ctx), aad_len);
+				}
+
+				if (len > 0)
+				{
+					const size_t chunk_size = get_chunk_size(len, threads_count);
+					const size_t chunks_count = (len + chunk_size - 1) / chunk_size;
+
+					std::vector<gf128> states(chunks_count);
+
+					parallel_for(chunks_count, threads_count, gcm_chunk_worker(parameters, direction, static_cast<unsigned char*>(out), static_cast<const unsigned char*>(in), len, chunk_size, states));
+
+					// GHASH is linear: resuming from a state S over n blocks gives S * H^n ^ (the state reached from zero).
+					for (size_t i = 0; i < chunks_count; ++i)
+					{
+						const size_t chunk_len = std::min(chunk_size, len - i * chunk_size);
+						const boost::uint64_t blocks = (chunk_len + counter_block_size - 1) / counter_block_size;
+
+						state = gf128_xor(gf128_multiply(state, gf128_power(parameters.h, blocks)), states[i]);
+					}
+				}
+
+				state = gf128_multiply(gf128_xor(state, gf128_lengths(aad_len, len)), parameters.h);
+
+				return gf128_xor(state, parameters.ej0);
+			}
+		}
+
+		void parallel_encrypt(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, void* out, const void* in, size_t len, unsigned int threads_count)
+		{
+			assert(out || (len == 0));
+			assert(in || (len == 0));
+
+			check_key_and_iv(algorithm, key, key_len, iv);
+
+			if ((algorithm.mode() != EVP_CIPH_CTR_MODE) || (algorithm.iv_length() != counter_block_size))
+			{
+				throw std::invalid_argument("algorithm");
+			}
+
+			if (iv_len != algorithm.iv_length())
+			{
+				throw std::runtime_error("iv_len");
+			}
+
+			if (len == 0)
+			{
+				return;
+			}
+
+			const size_t chunk_size = get_chunk_size(len, threads_count);
+			const size_t chunks_count = (len + chunk_size - 1) / chunk_size;
+
+			parallel_for(chunks_count, threads_count, ctr_chunk_worker(algorithm, key, key_len, iv, static_cast<unsigned char*>(out), static_cast<const unsigned char*>(in), len, chunk_size));
+		}
+
+		void parallel_encrypt(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* out, const void* in, size_t len, void* tag, size_t tag_len, unsigned int threads_count)
+		{
+			check_tag(tag, tag_len);
+
+			unsigned char full_tag[counter_block_size];
+
+			gf128_store(full_tag, gcm_process(algorithm, cipher_context::encrypt, key, key_len, iv, iv_len, aad, aad_len, out, in, len, threads_count));
+
+			std::memcpy(tag, full_tag, tag_len);
+		}
+
+		bool parallel_decrypt(const cipher_algorithm& algorithm, const void* key, size_t key_len, const void* iv, size_t iv_len, const void* aad, size_t aad_len, void* out, const void* in, size_t len, const void* tag, size_t tag_len, unsigned int threads_count)
+		{
+			check_tag(tag, tag_len);
+
+			unsigned char full_tag[counter_block_size];
+
+			gf128_store(full_tag, gcm_process(algorithm, cipher_context::decrypt, key, key_len, iv, iv_len, aad, aad_len, out, in, len, threads_count));
+
+			const bool result = constant_time_equal(full_tag, tag, tag_len);
+
+			if (!result)
+			{
+				OPENSSL_cleanse(out, len);
+			}
+
+			return result;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file sector_cipher.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A XTS sector cipher class.
+ */
+
+#include "cipher/sector_cipher.hpp"
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+
+namespace cryptoplus
+{
+	namespace cipher
+	{
+		namespace
+		{
+			const size_t tweak_size = 16;
+
+			// Runs shorter than this are not worth a thread.
+			const size_t minimum_run_size = 64 * 1024;
+
+			class sector_worker
+			{
+				public:
+
+					sector_worker(std::vector<boost::shared_ptr<cipher_context> >& contexts, size_t sector_size, size_t sectors_per_run, size_t sectors_count, boost::uint64_t first_sector, unsigned char* out, const unsigned char* in) :
+						m_contexts(contexts), m_sector_size(sector_size), m_sectors_per_run(sectors_per_run), m_sectors_count(sectors_count), m_first_sector(first_sector), m_out(out), m_in(in)
+					{
+					}
+
+					void operator()(size_t run)
+					{
+						EVP_CIPHER_CTX& ctx = m_contexts[run]->raw();
+
+						const size_t first = run * m_sectors_per_run;
+						const size_t last = std::min(first + m_sectors_per_run, m_sectors_count);
+
+						for (size_t index = first; index < last; ++index)
+						{
+							unsigned char tweak[tweak_size] = {};
+							boost::uint64_t sector = m_first_sector + index;
+
+							for (size_t i = 0; i < 8; ++i, sector >>= 8)
+							{
+								tweak[i] = static_cast<unsigned char>(sector & 0xff);
+							}
+
+							const size_t offset = index * m_sector_size;
+							int len = 0;
+
+							// Only the tweak changes: the key schedules are kept.
+							error::throw_error_if_not(EVP_CipherInit_ex(&ctx, NULL, NULL, NULL, tweak, -1) != 0);
+							error::throw_error_if_not(EVP_CipherUpdate(&ctx, m_out + offset, &len, m_in + offset, static_cast<int>(m_sector_size)) != 0);
+						}
+					}
+
+				private:
+
+					std::vector<boost::shared_ptr<cipher_context> >& m_contexts;
+					size_t m_sector_size;
+					size_t m_sectors_per_run;
+					size_t m_sectors_count;
+					boost::uint64_t m_first_sector;
+					unsigned char* m_out;
+					const unsigned char* m_in;
+			};
+		}
+
+		const size_t sector_cipher::default_sector_size = 4096;
+
+		sector_cipher::sector_cipher(const cipher_algorithm& _algorithm, const void* key, size_t key_len, size_t _sector_size, unsigned int threads_count) :
+			m_algorithm(_algorithm),
+			m_sector_size(_sector_size)
+		{
+			if (m_algorithm.mode() != EVP_CIPH_XTS_MODE)
+			{
+				throw std::invalid_argument("algorithm");
+			}
+
+			if ((m_sector_size < tweak_size) || (m_sector_size > static_cast<size_t>(std::numeric_limits<int>::max())))
+			{
+				throw std::invalid_argument("sector_size");
+			}
+
+			if (threads_count == 0)
+			{
+				threads_count = default_threads_count();
+			}
+
+			m_encrypt_contexts.resize(threads_count);
+			m_decrypt_contexts.resize(threads_count);
+
+			for (unsigned int i = 0; i < threads_count; ++i)
+			{
+				m_encrypt_contexts[i].reset(new cipher_context());
+				m_encrypt_contexts[i]->initialize(m_algorithm, cipher_context::encrypt, key, key_len, NULL, m_algorithm.iv_length());
+
+				m_decrypt_contexts[i].reset(new cipher_context());
+				m_decrypt_contexts[i]->initialize(m_algorithm, cipher_context::decrypt, key, key_len, NULL, m_algorithm.iv_length());
+			}
+		}
+
+		void sector_cipher::process(context_list& contexts, boost::uint64_t sector, void* out, const void* in, size_t len)
+		{
+			assert(out || (len == 0));
+			assert(in || (len == 0));
+
+			if (len % m_sector_size != 0)
+			{
+				throw std::invalid_argument("len");
+			}
+
+			const size_t sectors_count = len / m_sector_size;
+
+			if (sectors_count == 0)
+			{
+				return;
+			}
+
+			// One run per context, unless the runs would get too small.
+			const size_t minimum_sectors_per_run = std::max(minimum_run_size / m_sector_size, static_cast<size_t>(1));
+			const size_t runs_count = std::max(std::min(contexts.size(), sectors_count / minimum_sectors_per_run), static_cast<size_t>(1));
+			const size_t sectors_per_run = (sectors_count + runs_count - 1) / runs_count;
+
+			parallel_for(runs_count, static_cast<unsigned int>(runs_count), sector_worker(contexts, m_sector_size, sectors_per_run, sectors_count, sector, static_cast<unsigned char*>(out), static_cast<const unsigned char*>(in)));
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file tree_digest.cpp
+ * \author Julien KAUFFMANN <julien.kauffmann@freelan.org>
+ * \brief A Merkle tree digest class.
+ */
+
+#include "hash/tree_digest.hpp"
+
+#include "hash/message_digest_context.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace cryptoplus
+{
+	namespace hash
+	{
+		namespace
+		{
+			// The domain separation prefixes of RFC 6962.
+			const unsigned char leaf_prefix = 0x00;
+			const unsigned char node_prefix = 0x01;
+
+			// Runs shorter than this are not worth a thread.
+			const size_t minimum_run_size = 1024 * 1024;
+
+			void hash_leaf(message_digest_context& ctx, const message_digest_algorithm& algorithm, unsigned char* out, const void* leaf, size_t leaf_len)
+			{
+				ctx.initialize(algorithm);
+				ctx.update(&leaf_prefix, sizeof(leaf_prefix));
+				ctx.update(leaf, leaf_len);
+				ctx.finalize(out, algorithm.result_size());
+			}
+
+			void hash_node(message_digest_context& ctx, const message_digest_algorithm& algorithm, unsigned char* out, const unsigned char* left, const unsigned char* right)
+			{
+				ctx.initialize(algorithm);
+				ctx.update(&node_prefix, sizeof(node_prefix));
+				ctx.update(left, algorithm.result_size());
+				ctx.update(right, algorithm.result_size());
+				ctx.finalize(out, algorithm.result_size());
+			}
+
+			class leaf_worker
+			{
+				public:
+
+					leaf_worker(const message_digest_algorithm& algorithm, size_t leaf_size, size_t leaves_per_run, size_t leaves_count, const unsigned char* data, size_t len, unsigned char* out) :
+						m_algorithm(algorithm), m_leaf_size(leaf_size), m_leaves_per_run(leaves_per_run), m_leaves_count(leaves_count), m_data(data), m_len(len), m_out(out)
+					{
+					}
+
+					void operator()(size_t run)
+					{
+						message_digest_context ctx;
+
+						const size_t first = run * m_leaves_per_run;
+						const size_t last = std::min(first + m_leaves_per_run, m_leaves_count);
+
+						for (size_t index = first; index < last; ++index)
+						{
+							const size_t offset = index * m_leaf_size;
+
+							hash_leaf(ctx, m_algorithm, m_out + index * m_algorithm.result_size(), m_data + offset, std::min(m_leaf_size, m_len - offset));
+						}
+					}
+
+				private:
+
+					const message_digest_algorithm& m_algorithm;
+					size_t m_leaf_size;
+					size_t m_leaves_per_run;
+					size_t m_leaves_count;
+					const unsigned char* m_data;
+					size_t m_len;
+					unsigned char* m_out;
+			};
+		}
+
+		const size_t tree_digest::default_leaf_size = 1024 * 1024;
+
+		bool tree_digest::verify_inclusion_proof(const message_digest_algorithm& algorithm, const void* root, size_t root_len, const void* leaf, size_t leaf_len, size_t leaf_index, size_t leaves_count, const proof_type& proof)
+		{
+			assert(root || (root_len == 0));
+			assert(leaf || (leaf_len == 0));
+
+			const size_t hash_size = algorithm.result_size();
+
+			if ((root_len != hash_size) || (leaf_index >= leaves_count))
+			{
+				return false;
+			}
+
+			// This is the verification algorithm of RFC 9162, section 2.1.3.2.
+			message_digest_context ctx;
+			std::vector<unsigned char> result(hash_size);
+			size_t fn = leaf_index;
+			size_t sn = leaves_count - 1;
+
+			hash_leaf(ctx, algorithm, &result[0], leaf, leaf_len);
+
+			for (proof_type::const_iterator node = proof.begin(); node != proof.end(); ++node)
+			{
+				if ((sn == 0) || (node->size() != hash_size))
+				{
+					return false;
+				}
+
+				if ((fn & 1) || (fn == sn))
+				{
+					hash_node(ctx, algorithm, &result[0], &(*node)[0], &result[0]);
+
+					while (!(fn & 1) && (fn != 0))
+					{
+						fn >>= 1;
+						sn >>= 1;
+					}
+				}
+				else
+				{
+					hash_node(ctx, algorithm, &result[0], &result[0], &(*node)[0]);
+				}
+
+				fn >>= 1;
+				sn >>= 1;
+			}
+
+			return (sn == 0) && std::equal(result.begin(), result.end(), static_cast<const unsigned char*>(root));
+		}
+
+		tree_digest::tree_digest(const void* data, size_t len, const message_digest_algorithm& _algorithm, size_t _leaf_size, unsigned int threads_count) :
+			m_algorithm(_algorithm),
+			m_leaf_size(_leaf_size)
+		{
+			assert(data || (len == 0));
+
+			if (m_leaf_size == 0)
+			{
+				throw std::invalid_argument("leaf_size");
+			}
+
+			if (len == 0)
+			{
+				message_digest_context ctx;
+
+				ctx.initialize(m_algorithm);
+				m_root = ctx.finalize<unsigned char>();
+
+				return;
+			}
+
+			const size_t hash_size = m_algorithm.result_size();
+			const size_t leaves_count = len / m_leaf_size + ((len % m_leaf_size != 0) ? 1 : 0);
+
+			if (threads_count == 0)
+			{
+				threads_count = default_threads_count();
+			}
+
+			// One run per thread, unless the runs would get too small.
+			const size_t minimum_leaves_per_run = std::max(minimum_run_size / m_leaf_size, static_cast<size_t>(1));
+			const size_t runs_count = std::max(std::min(static_cast<size_t>(threads_count), leaves_count / minimum_leaves_per_run), static_cast<size_t>(1));
+			const size_t leaves_per_run = (leaves_count + runs_count - 1) / runs_count;
+
+			m_levels.push_back(std::vector<unsigned char>(leaves_count * hash_size));
+
+			parallel_for(runs_count, static_cast<unsigned int>(runs_count), leaf_worker(m_algorithm, m_leaf_size, leaves_per_run, leaves_count, static_cast<const unsigned char*>(data), len, &m_levels.back()[0]));
+
+			// Pairing the nodes of each level and moving a lone last node up unchanged gives the RFC 6962 tree.
+			message_digest_context ctx;
+
+			for (size_t count = leaves_count; count > 1; count = (count + 1) / 2)
+			{
+				const std::vector<unsigned char>& level = m_levels.back();
+				std::vector<unsigned char> parent((count + 1) / 2 * hash_size);
+
+				for (size_t index = 0; index + 1 < count; index += 2)
+				{
+					hash_node(ctx, m_algorithm, &parent[index / 2 * hash_size], &level[index * hash_size], &level[(index + 1) * hash_size]);
+				}
+
+				if (count % 2 != 0)
+				{
+					std::copy(level.end() - hash_size, level.end(), parent.end() - hash_size);
+				}
+
+				m_levels.push_back(parent);
+			}
+
+			m_root = m_levels.back();
+		}
+
+		tree_digest::proof_type tree_digest::inclusion_proof(size_t leaf_index) const
+		{
+			if (leaf_index >= leaves_count())
+			{
+				throw std::out_of_range("leaf_index");
+			}
+
+			const size_t hash_size = m_algorithm.result_size();
+			proof_type result;
+
+			for (size_t level = 0; level + 1 < m_levels.size(); ++level, leaf_index /= 2)
+			{
+				const size_t sibling = leaf_index ^ 1;
+
+				// A lone last node has no sibling on this level.
+				if ((sibling + 1) * hash_size <= m_levels[level].size())
+				{
+					const std::vector<unsigned char>::const_iterator node = m_levels[level].begin() + sibling * hash_size;
+
+					result.push_back(std::vector<unsigned char>(node, node + hash_size));
+				}
+			}
+
+			return result;
+		}
+	}
+}
@@ -0,0 +1,1245 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher.cpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief The cipher test file.
+ */
+
+#include "cipher.hpp"
+
+#include <cryptoplus/cipher/cipher.hpp>
+#include <cryptoplus/cipher/authenticated_cipher.hpp>
+#include <cryptoplus/cipher/cipher_context.hpp>
+#include <cryptoplus/cipher/cipher_context_cache.hpp>
+#include <cryptoplus/cipher/parallel_cipher.hpp>
+#include <cryptoplus/cipher/file_cipher.hpp>
+#include <cryptoplus/cipher/chunked_container.hpp>
+#include <cryptoplus/cipher/sector_cipher.hpp>
+#include <cryptoplus/cipher/cipher_selection.hpp>
+#include <cryptoplus/cipher/cipher_stream.hpp>
+#include <cryptoplus/cipher/cipher_streambuf.hpp>
+#include <cryptoplus/cipher/channel.hpp>
+#include <cryptoplus/cipher/key_wrap.hpp>
+#include <cryptoplus/cipher/keystream_cipher.hpp>
+#include <cryptoplus/bio/bio_chain.hpp>
+#include <cryptoplus/pkey/pkey.hpp>
+#include <cryptoplus/pkey/rsa_key.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <sstream>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CipherTest);
+
+using namespace cryptoplus::cipher;
+
+namespace
+{
+	std::vector<unsigned char> get_buffer(size_t len)
+	{
+		std::vector<unsigned char> result(len);
+
+		for (size_t i = 0; i < len; ++i)
+		{
+			result[i] = static_cast<unsigned char>(i * 7 + 3);
+		}
+
+		return result;
+	}
+
+	// Two different halves, as XTS requires.
+	std::vector<unsigned char> get_xts_key()
+	{
+		std::vector<unsigned char> result(32, 0x11);
+
+		std::fill(result.begin() + 16, result.end(), 0x22);
+
+		return result;
+	}
+
+	cryptoplus::file make_file(const std::vector<unsigned char>& content)
+	{
+		cryptoplus::file result = cryptoplus::file::take_ownership(std::tmpfile());
+
+		CPPUNIT_ASSERT(result);
+		CPPUNIT_ASSERT(content.empty() || (std::fwrite(&content[0], 1, content.size(), result.raw()) == content.size()));
+
+		std::rewind(result.raw());
+
+		return result;
+	}
+
+	std::vector<unsigned char> read_file(cryptoplus::file source)
+	{
+		std::vector<unsigned char> result;
+		unsigned char buffer[4096];
+		size_t cnt;
+
+		std::rewind(source.raw());
+
+		while ((cnt = std::fread(buffer, 1, sizeof(buffer), source.raw())) > 0)
+		{
+			result.insert(result.end(), buffer, buffer + cnt);
+		}
+
+		return result;
+	}
+
+	// Cipher the same data out of place and in place (in several calls) and check that both results are identical.
+	void check_in_place(const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, bool padding, size_t len, size_t step)
+	{
+		const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+		const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+		const std::vector<unsigned char> input = get_buffer(len);
+
+		cipher_context ctx;
+		ctx.initialize(algorithm, direction, &key[0], key.size(), iv.empty() ? NULL : &iv[0], iv.size());
+		ctx.set_padding(padding);
+
+		std::vector<unsigned char> expected(len + algorithm.block_size());
+		expected.resize(ctx.update(&expected[0], expected.size(), &input[0], input.size()));
+
+		ctx.initialize(algorithm, direction, &key[0], key.size(), iv.empty() ? NULL : &iv[0], iv.size());
+		ctx.set_padding(padding);
+
+		std::vector<unsigned char> buffer = input;
+
+		for (size_t offset = 0; offset < len; offset += step)
+		{
+			ctx.update_in_place(&buffer[offset], std::min(step, len - offset));
+		}
+
+		CPPUNIT_ASSERT(buffer == expected);
+	}
+
+	// Split a buffer in uneven fragments: the last one gets whatever remains.
+	template <typename BufferType, typename PointerType>
+	std::vector<BufferType> fragment(PointerType data, size_t len, const size_t* sizes, size_t sizes_count)
+	{
+		std::vector<BufferType> result;
+
+		for (size_t i = 0; i < sizes_count; ++i)
+		{
+			CPPUNIT_ASSERT(sizes[i] <= len);
+
+			result.push_back(BufferType(data, sizes[i]));
+			data += sizes[i];
+			len -= sizes[i];
+		}
+
+		result.push_back(BufferType(data, len));
+
+		return result;
+	}
+
+	// A cipher_stream sink that collects its output and remembers the size of the biggest chunk.
+	class chunk_collector
+	{
+		public:
+
+			chunk_collector(std::vector<unsigned char>& output, size_t& max_chunk_size) : m_output(output), m_max_chunk_size(max_chunk_size) {}
+
+			void operator()(const void* buf, size_t buf_len)
+			{
+				const unsigned char* const cbuf = static_cast<const unsigned char*>(buf);
+
+				m_output.insert(m_output.end(), cbuf, cbuf + buf_len);
+				m_max_chunk_size = std::max(m_max_chunk_size, buf_len);
+			}
+
+		private:
+
+			std::vector<unsigned char>& m_output;
+			size_t& m_max_chunk_size;
+	};
+
+	// Cipher the same data contiguously and through uneven scattered fragments, check that both results are identical and return it.
+	std::vector<unsigned char> check_scatter_gather(const cipher_algorithm& algorithm, cipher_context::cipher_direction direction, const std::vector<unsigned char>& input)
+	{
+		const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+		const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+
+		cipher_context ctx;
+		ctx.initialize(algorithm, direction, &key[0], key.size(), iv.empty() ? NULL : &iv[0], iv.size());
+
+		std::vector<unsigned char> expected(input.size() + 2 * algorithm.block_size());
+		size_t cnt = ctx.update(&expected[0], expected.size(), &input[0], input.size());
+		cnt += ctx.finalize(&expected[cnt], expected.size() - cnt);
+		expected.resize(cnt);
+
+		// Neither the input nor the output fragments are aligned on blocks, and some are empty.
+		const size_t in_sizes[] = { 1, 15, 17, 0, 300 };
+		const size_t out_sizes[] = { 5, 100, 0, 33 };
+		const size_t final_sizes[] = { algorithm.block_size() / 5 };
+
+		std::vector<unsigned char> output(input.size() + 2 * algorithm.block_size());
+
+		const std::vector<cryptoplus::const_buffer> in = fragment<cryptoplus::const_buffer>(&input[0], input.size(), in_sizes, sizeof(in_sizes) / sizeof(in_sizes[0]));
+		const std::vector<cryptoplus::mutable_buffer> out = fragment<cryptoplus::mutable_buffer>(&output[0], output.size(), out_sizes, sizeof(out_sizes) / sizeof(out_sizes[0]));
+
+		ctx.initialize(algorithm, direction, &key[0], key.size(), iv.empty() ? NULL : &iv[0], iv.size());
+		cnt = ctx.update(&out[0], out.size(), &in[0], in.size());
+
+		const std::vector<cryptoplus::mutable_buffer> final_out = fragment<cryptoplus::mutable_buffer>(&output[cnt], output.size() - cnt, final_sizes, sizeof(final_sizes) / sizeof(final_sizes[0]));
+
+		cnt += ctx.finalize(&final_out[0], final_out.size());
+		output.resize(cnt);
+
+		CPPUNIT_ASSERT(output == expected);
+
+		return output;
+	}
+}
+
+void CipherTest::setUp()
+{
+}
+
+void CipherTest::tearDown()
+{
+}
+
+void CipherTest::testInPlaceCTR()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	check_in_place(cipher_algorithm(EVP_aes_128_ctr()), cipher_context::encrypt, true, 1000, 1000);
+	check_in_place(cipher_algorithm(EVP_aes_128_ctr()), cipher_context::encrypt, true, 1000, 7);
+	check_in_place(cipher_algorithm(EVP_aes_256_ctr()), cipher_context::decrypt, true, 1000, 13);
+#endif
+}
+
+void CipherTest::testInPlaceGCM()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	check_in_place(cipher_algorithm(EVP_aes_128_gcm()), cipher_context::encrypt, true, 1000, 1000);
+	check_in_place(cipher_algorithm(EVP_aes_256_gcm()), cipher_context::encrypt, true, 1000, 17);
+#endif
+}
+
+void CipherTest::testInPlaceChaCha20()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	check_in_place(cipher_algorithm(EVP_chacha20()), cipher_context::encrypt, true, 1000, 1000);
+	check_in_place(cipher_algorithm(EVP_chacha20_poly1305()), cipher_context::encrypt, true, 1000, 33);
+#endif
+}
+
+void CipherTest::testInPlaceCBC()
+{
+	check_in_place(cipher_algorithm(EVP_aes_128_cbc()), cipher_context::encrypt, false, 1024, 1024);
+	check_in_place(cipher_algorithm(EVP_aes_128_cbc()), cipher_context::decrypt, false, 1024, 1024);
+	check_in_place(cipher_algorithm(EVP_aes_256_cbc()), cipher_context::decrypt, false, 1024, 64);
+}
+
+void CipherTest::testInPlaceStream()
+{
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+
+	std::vector<unsigned char> buffer = get_buffer(256);
+
+	cipher_stream stream(0);
+	stream.initialize(algorithm, cipher_stream::encrypt, &key[0], key.size(), &iv[0], iv.size());
+	stream.set_padding(false);
+	stream.update_in_place(&buffer[0], buffer.size());
+
+	stream.initialize(algorithm, cipher_stream::decrypt, &key[0], key.size(), &iv[0], iv.size());
+	stream.set_padding(false);
+	stream.update_in_place(&buffer[0], buffer.size());
+
+	CPPUNIT_ASSERT(buffer == get_buffer(256));
+}
+
+void CipherTest::testInPlacePaddingException()
+{
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+
+	std::vector<unsigned char> buffer = get_buffer(64);
+
+	cipher_context ctx;
+	ctx.initialize(algorithm, cipher_context::decrypt, &key[0], key.size(), &iv[0], iv.size());
+	ctx.update_in_place(&buffer[0], buffer.size());
+}
+
+void CipherTest::testInPlaceLengthException()
+{
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+
+	std::vector<unsigned char> buffer = get_buffer(64);
+
+	cipher_context ctx;
+	ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &iv[0], iv.size());
+	ctx.set_padding(false);
+	ctx.update_in_place(&buffer[0], buffer.size() - 1);
+}
+
+void CipherTest::testScatterGather()
+{
+	const std::vector<unsigned char> input = get_buffer(1000);
+
+	const cipher_algorithm cbc(EVP_aes_128_cbc());
+	const std::vector<unsigned char> ciphertext = check_scatter_gather(cbc, cipher_context::encrypt, input);
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(1008), ciphertext.size());
+	CPPUNIT_ASSERT(check_scatter_gather(cbc, cipher_context::decrypt, ciphertext) == input);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const cipher_algorithm ctr(EVP_aes_128_ctr());
+
+	CPPUNIT_ASSERT(check_scatter_gather(ctr, cipher_context::decrypt, check_scatter_gather(ctr, cipher_context::encrypt, input)) == input);
+#endif
+
+	// Output buffers too small to hold the result are rejected.
+	const std::vector<unsigned char> key(cbc.key_length(), 0x42);
+	const std::vector<unsigned char> iv(cbc.iv_length(), 0x24);
+	std::vector<unsigned char> output(input.size() / 2);
+
+	const cryptoplus::const_buffer in(&input[0], input.size());
+	const cryptoplus::mutable_buffer out(&output[0], output.size());
+
+	cipher_context ctx;
+	ctx.initialize(cbc, cipher_context::encrypt, &key[0], key.size(), &iv[0], iv.size());
+
+	CPPUNIT_ASSERT_THROW(ctx.update(&out, 1, &in, 1), std::logic_error);
+}
+
+void CipherTest::testStreamSink()
+{
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+	const std::vector<unsigned char> input = get_buffer(1000);
+
+	cipher_context ctx;
+	ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &iv[0], iv.size());
+
+	std::vector<unsigned char> expected(input.size() + algorithm.block_size());
+	size_t cnt = ctx.update(&expected[0], expected.size(), &input[0], input.size());
+	cnt += ctx.finalize(&expected[cnt], expected.size() - cnt);
+	expected.resize(cnt);
+
+	// The appended pieces are neither aligned on blocks nor on the buffer size.
+	const size_t sizes[] = { 1, 63, 200, 0, 736 };
+	const size_t buffer_size = 2 * EVP_MAX_BLOCK_LENGTH;
+
+	std::vector<unsigned char> output;
+	size_t max_chunk_size = 0;
+
+	cipher_stream stream(buffer_size, chunk_collector(output, max_chunk_size));
+	stream.initialize(algorithm, cipher_stream::encrypt, &key[0], key.size(), &iv[0], iv.size());
+
+	size_t offset = 0;
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+	{
+		stream.append(&input[offset], sizes[i]);
+		offset += sizes[i];
+	}
+
+	CPPUNIT_ASSERT_EQUAL(input.size(), offset);
+	CPPUNIT_ASSERT(!output.empty());
+
+	stream.finalize();
+
+	CPPUNIT_ASSERT(output == expected);
+	CPPUNIT_ASSERT(max_chunk_size <= buffer_size);
+
+	// Decrypt back into a memory BIO.
+	cryptoplus::bio::bio_chain memory(BIO_s_mem());
+	cipher_stream decrypt_stream(buffer_size, cipher_stream::bio_sink(memory.first()));
+	decrypt_stream.initialize(algorithm, cipher_stream::decrypt, &key[0], key.size(), &iv[0], iv.size());
+	decrypt_stream.append(&output[0], 17);
+	decrypt_stream.append(&output[17], output.size() - 17);
+	decrypt_stream.finalize();
+
+	char* data = NULL;
+	const size_t data_len = memory.first().get_mem_data(data);
+
+	CPPUNIT_ASSERT(std::vector<unsigned char>(data, data + data_len) == input);
+
+	// A failed write to the sink is reported to the caller.
+	cryptoplus::bio::bio_chain read_only(BIO_new_mem_buf(&expected[0], static_cast<int>(expected.size())));
+	cipher_stream failing_stream(buffer_size, cipher_stream::bio_sink(read_only.first()));
+	failing_stream.initialize(algorithm, cipher_stream::encrypt, &key[0], key.size(), &iv[0], iv.size());
+
+	CPPUNIT_ASSERT_THROW(failing_stream.append(&input[0], input.size()), cryptoplus::error::cryptographic_exception);
+}
+
+void CipherTest::testStreambuf()
+{
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+	const std::vector<unsigned char> input = get_buffer(1000);
+
+	cipher_context ctx;
+	ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &iv[0], iv.size());
+
+	std::vector<unsigned char> expected(input.size() + algorithm.block_size());
+	size_t cnt = ctx.update(&expected[0], expected.size(), &input[0], input.size());
+	cnt += ctx.finalize(&expected[cnt], expected.size() - cnt);
+	expected.resize(cnt);
+
+	// Single characters, small writes that go through the internal buffer and writes bigger than it.
+	const size_t sizes[] = { 1, 62, 200, 0, 5, 732 };
+	const size_t buffer_size = 64;
+
+	std::stringbuf destination;
+
+	{
+		cipher_ostreambuf obuf(&destination, buffer_size);
+		obuf.context().initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &iv[0], iv.size());
+
+		std::ostream os(&obuf);
+		const char* const data = reinterpret_cast<const char*>(&input[0]);
+		size_t offset = 0;
+
+		os.put(data[offset++]);
+
+		for (size_t i = 1; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+		{
+			os.write(data + offset, sizes[i]);
+			offset += sizes[i];
+		}
+
+		CPPUNIT_ASSERT(os.good());
+		CPPUNIT_ASSERT_EQUAL(input.size(), offset);
+
+		obuf.finalize();
+	}
+
+	const std::string ciphertext = destination.str();
+
+	CPPUNIT_ASSERT(std::vector<unsigned char>(ciphertext.begin(), ciphertext.end()) == expected);
+
+	// Read it back in uneven pieces.
+	std::stringbuf source(ciphertext);
+	cipher_istreambuf ibuf(&source, buffer_size);
+	ibuf.context().initialize(algorithm, cipher_context::decrypt, &key[0], key.size(), &iv[0], iv.size());
+
+	std::istream is(&ibuf);
+	std::vector<char> output(input.size() + algorithm.block_size());
+	size_t offset = 0;
+
+	for (size_t i = 0; (i < sizeof(sizes) / sizeof(sizes[0])) && is.read(&output[offset], sizes[i]); ++i)
+	{
+		offset += sizes[i];
+	}
+
+	CPPUNIT_ASSERT_EQUAL(input.size(), offset);
+	CPPUNIT_ASSERT(!is.read(&output[offset], output.size() - offset));
+	CPPUNIT_ASSERT_EQUAL(static_cast<std::streamsize>(0), is.gcount());
+	CPPUNIT_ASSERT(is.eof());
+	CPPUNIT_ASSERT(!is.bad());
+	CPPUNIT_ASSERT(std::vector<unsigned char>(output.begin(), output.begin() + offset) == input);
+
+	// A bad padding is reported once the source reaches its end.
+	std::string tampered = ciphertext;
+	tampered[tampered.size() - 1] ^= 0x01;
+
+	std::stringbuf tampered_source(tampered);
+	cipher_istreambuf tampered_ibuf(&tampered_source, buffer_size);
+	tampered_ibuf.context().initialize(algorithm, cipher_context::decrypt, &key[0], key.size(), &iv[0], iv.size());
+
+	std::istream tampered_is(&tampered_ibuf);
+
+	CPPUNIT_ASSERT(!tampered_is.read(&output[0], output.size()));
+	CPPUNIT_ASSERT(tampered_is.bad());
+}
+
+void CipherTest::testSealArena()
+{
+	using cryptoplus::pkey::pkey;
+	using cryptoplus::pkey::rsa_key;
+
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> input = get_buffer(1000);
+
+	std::vector<rsa_key> private_keys;
+	std::vector<pkey> public_keys;
+
+	for (size_t i = 0; i < 3; ++i)
+	{
+		private_keys.push_back(rsa_key::generate_private_key(1024, 65537));
+		public_keys.push_back(pkey::from_rsa_key(private_keys.back().to_public_key()));
+	}
+
+	std::vector<unsigned char> arena(cipher_context::get_seal_arena_size(&public_keys[0], public_keys.size()));
+	std::vector<unsigned char> iv(algorithm.iv_length());
+	size_t ek_len[3];
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(3 * 128), arena.size());
+
+	cipher_context ctx;
+
+	// The arena must be big enough for all the recipients.
+	CPPUNIT_ASSERT_THROW(ctx.seal_initialize(algorithm, &iv[0], iv.size(), &public_keys[0], public_keys.size(), &arena[0], arena.size() - 1, ek_len, 2), std::runtime_error);
+
+	ctx.seal_initialize(algorithm, &iv[0], iv.size(), &public_keys[0], public_keys.size(), &arena[0], arena.size(), ek_len, 2);
+
+	std::vector<unsigned char> ciphertext(input.size() + algorithm.block_size());
+	size_t cnt = ctx.seal_update(&ciphertext[0], ciphertext.size(), &input[0], input.size());
+	cnt += ctx.seal_finalize(&ciphertext[cnt], ciphertext.size() - cnt);
+	ciphertext.resize(cnt);
+
+	// Every recipient gets the same session key, at its own offset in the arena.
+	std::vector<unsigned char> session_key;
+
+	for (size_t i = 0; i < private_keys.size(); ++i)
+	{
+		const size_t offset = cipher_context::get_seal_arena_size(&public_keys[0], i);
+
+		CPPUNIT_ASSERT(ek_len[i] <= public_keys[i].size());
+
+		std::vector<unsigned char> key(private_keys[i].size());
+		key.resize(private_keys[i].private_decrypt(&key[0], key.size(), &arena[offset], ek_len[i], RSA_PKCS1_PADDING));
+
+		CPPUNIT_ASSERT_EQUAL(algorithm.key_length(), key.size());
+		CPPUNIT_ASSERT(session_key.empty() || (key == session_key));
+
+		session_key = key;
+
+		cipher_context decrypt_ctx;
+		decrypt_ctx.initialize(algorithm, cipher_context::decrypt, &key[0], key.size(), &iv[0], iv.size());
+
+		std::vector<unsigned char> output(ciphertext.size() + algorithm.block_size());
+		size_t output_cnt = decrypt_ctx.update(&output[0], output.size(), &ciphertext[0], ciphertext.size());
+		output_cnt += decrypt_ctx.finalize(&output[output_cnt], output.size() - output_cnt);
+		output.resize(output_cnt);
+
+		CPPUNIT_ASSERT(output == input);
+	}
+}
+
+void CipherTest::testAeadLengths()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const cipher_algorithm algorithm(EVP_aes_128_gcm());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(16, 0x24);
+
+	std::vector<unsigned char> buffer = get_buffer(64);
+	unsigned char tag[16];
+
+	cipher_context ctx;
+	ctx.aead_initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), 12, 16);
+	ctx.aead_encrypt(&buffer[0], buffer.size(), &iv[0], 12, NULL, 0, tag, 16);
+
+	// The lengths must be the ones given to aead_initialize().
+	CPPUNIT_ASSERT_THROW(ctx.aead_encrypt(&buffer[0], buffer.size(), &iv[0], 16, NULL, 0, tag, 16), std::runtime_error);
+	CPPUNIT_ASSERT_THROW(ctx.aead_encrypt(&buffer[0], buffer.size(), &iv[0], 12, NULL, 0, tag, 12), std::runtime_error);
+
+	ctx.aead_initialize(algorithm, cipher_context::decrypt, &key[0], key.size(), 12, 16);
+
+	CPPUNIT_ASSERT_THROW(ctx.aead_decrypt(&buffer[0], buffer.size(), &iv[0], 16, NULL, 0, tag, 16), std::runtime_error);
+	CPPUNIT_ASSERT_THROW(ctx.aead_decrypt(&buffer[0], buffer.size(), &iv[0], 12, NULL, 0, tag, 8), std::runtime_error);
+	CPPUNIT_ASSERT(ctx.aead_decrypt(&buffer[0], buffer.size(), &iv[0], 12, NULL, 0, tag, 16));
+	CPPUNIT_ASSERT(buffer == get_buffer(64));
+#endif
+}
+
+void CipherTest::testCipherContextCache()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key_a(algorithm.key_length(), 0x0a);
+	const std::vector<unsigned char> key_b(algorithm.key_length(), 0x0b);
+	const std::vector<unsigned char> key_c(algorithm.key_length(), 0x0c);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+	const std::vector<unsigned char> input = get_buffer(100);
+
+	cipher_context_cache cache(2);
+
+	cache.insert("a", algorithm, cipher_context::encrypt, &key_a[0], key_a.size());
+	cache.insert("b", algorithm, cipher_context::encrypt, &key_b[0], key_b.size());
+
+	// A cached context gives the same ciphertext as a freshly initialized one.
+	cipher_context ctx;
+	cipher_context fresh;
+	std::vector<unsigned char> output(input.size() + algorithm.block_size());
+	std::vector<unsigned char> expected(input.size() + algorithm.block_size());
+
+	CPPUNIT_ASSERT(cache.get("a", cipher_context::encrypt, ctx, &iv[0], iv.size()));
+	fresh.initialize(algorithm, cipher_context::encrypt, &key_a[0], key_a.size(), &iv[0], iv.size());
+
+	size_t cnt = ctx.update(&output[0], output.size(), &input[0], input.size());
+	cnt += ctx.finalize(&output[cnt], output.size() - cnt);
+	size_t expected_cnt = fresh.update(&expected[0], expected.size(), &input[0], input.size());
+	expected_cnt += fresh.finalize(&expected[expected_cnt], expected.size() - expected_cnt);
+
+	CPPUNIT_ASSERT_EQUAL(expected_cnt, cnt);
+	CPPUNIT_ASSERT(output == expected);
+
+	// "a" was just used: inserting "c" evicts "b", the least recently used entry.
+	cache.insert("c", algorithm, cipher_context::encrypt, &key_c[0], key_c.size());
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), cache.size());
+	CPPUNIT_ASSERT(!cache.get("b", cipher_context::encrypt, ctx, &iv[0], iv.size()));
+	CPPUNIT_ASSERT(cache.get("a", cipher_context::encrypt, ctx, &iv[0], iv.size()));
+	CPPUNIT_ASSERT(cache.get("c", cipher_context::encrypt, ctx, &iv[0], iv.size()));
+
+	// The direction is part of the index.
+	CPPUNIT_ASSERT(!cache.get("a", cipher_context::decrypt, ctx, &iv[0], iv.size()));
+
+	// Replacing an entry evicts nothing.
+	cache.insert("a", algorithm, cipher_context::encrypt, &key_a[0], key_a.size());
+
+	CPPUNIT_ASSERT_EQUAL(3ul, cache.hits());
+	CPPUNIT_ASSERT_EQUAL(2ul, cache.misses());
+	CPPUNIT_ASSERT_EQUAL(1ul, cache.evictions());
+
+	CPPUNIT_ASSERT(cache.erase("c", cipher_context::encrypt));
+	CPPUNIT_ASSERT(!cache.erase("c", cipher_context::encrypt));
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(1), cache.size());
+	CPPUNIT_ASSERT(!cache.get("c", cipher_context::encrypt, ctx, &iv[0], iv.size()));
+
+	// A cached decryption context reverses the encryption.
+	cache.insert("a", algorithm, cipher_context::decrypt, &key_a[0], key_a.size());
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2), cache.size());
+	CPPUNIT_ASSERT_EQUAL(1ul, cache.evictions());
+	CPPUNIT_ASSERT(cache.get("a", cipher_context::decrypt, ctx, &iv[0], iv.size()));
+
+	std::vector<unsigned char> decrypted(output.size() + algorithm.block_size());
+	size_t decrypted_cnt = ctx.update(&decrypted[0], decrypted.size(), &output[0], cnt);
+	decrypted_cnt += ctx.finalize(&decrypted[decrypted_cnt], decrypted.size() - decrypted_cnt);
+
+	CPPUNIT_ASSERT(std::vector<unsigned char>(decrypted.begin(), decrypted.begin() + decrypted_cnt) == input);
+
+	cache.reset_statistics();
+
+	CPPUNIT_ASSERT_EQUAL(0ul, cache.hits());
+	CPPUNIT_ASSERT_EQUAL(0ul, cache.misses());
+	CPPUNIT_ASSERT_EQUAL(0ul, cache.evictions());
+
+	cache.clear();
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), cache.size());
+	CPPUNIT_ASSERT_THROW(cipher_context_cache(0), std::invalid_argument);
+#endif
+}
+
+void CipherTest::testParallelGCM()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const cipher_algorithm algorithm(EVP_aes_128_gcm());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(12, 0x24);
+	const std::vector<unsigned char> aad = get_buffer(21);
+
+	// A length that is not a multiple of the block size, split in up to 5 chunks of at least 64 KiB.
+	const size_t len = 300001;
+	const std::vector<unsigned char> input = get_buffer(len);
+
+	std::vector<unsigned char> expected = input;
+	unsigned char expected_tag[16];
+
+	cipher_context ctx;
+	ctx.aead_initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), iv.size(), sizeof(expected_tag));
+	ctx.aead_encrypt(&expected[0], expected.size(), &iv[0], iv.size(), &aad[0], aad.size(), expected_tag, sizeof(expected_tag));
+
+	const unsigned int threads_counts[] = { 1, 2, 3, 4, 7 };
+
+	for (size_t i = 0; i < sizeof(threads_counts) / sizeof(threads_counts[0]); ++i)
+	{
+		std::vector<unsigned char> output(len);
+		unsigned char tag[16];
+
+		parallel_encrypt(algorithm, &key[0], key.size(), &iv[0], iv.size(), &aad[0], aad.size(), &output[0], &input[0], len, tag, sizeof(tag), threads_counts[i]);
+
+		CPPUNIT_ASSERT(output == expected);
+		CPPUNIT_ASSERT(std::equal(tag, tag + sizeof(tag), expected_tag));
+
+		std::vector<unsigned char> decrypted(len);
+
+		CPPUNIT_ASSERT(parallel_decrypt(algorithm, &key[0], key.size(), &iv[0], iv.size(), &aad[0], aad.size(), &decrypted[0], &output[0], len, tag, 12, threads_counts[i]));
+		CPPUNIT_ASSERT(decrypted == input);
+
+		// A tampered tag is rejected and no plaintext is left.
+		tag[5] ^= 0x01;
+
+		CPPUNIT_ASSERT(!parallel_decrypt(algorithm, &key[0], key.size(), &iv[0], iv.size(), &aad[0], aad.size(), &decrypted[0], &output[0], len, tag, sizeof(tag), threads_counts[i]));
+		CPPUNIT_ASSERT(decrypted == std::vector<unsigned char>(len, 0x00));
+	}
+
+	// Short or oversized tags are refused.
+	std::vector<unsigned char> output(len);
+	unsigned char tag[32] = {};
+
+	CPPUNIT_ASSERT_THROW(parallel_encrypt(algorithm, &key[0], key.size(), &iv[0], iv.size(), &aad[0], aad.size(), &output[0], &input[0], len, tag, 17, 1), std::invalid_argument);
+	CPPUNIT_ASSERT_THROW(parallel_decrypt(algorithm, &key[0], key.size(), &iv[0], iv.size(), &aad[0], aad.size(), &output[0], &expected[0], len, tag, 0, 1), std::invalid_argument);
+	CPPUNIT_ASSERT_THROW(parallel_decrypt(algorithm, &key[0], key.size(), &iv[0], iv.size(), &aad[0], aad.size(), &output[0], &expected[0], len, tag, 11, 1), std::invalid_argument);
+#endif
+}
+
+void CipherTest::testFileCipher()
+{
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+	const size_t buffer_size = 1024;
+
+	// An exact multiple of buffer_size leaves an empty last buffer.
+	const size_t lengths[] = { 4 * buffer_size, 4 * buffer_size + 1 };
+
+	for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+	{
+		const std::vector<unsigned char> plaintext = get_buffer(lengths[i]);
+
+		cipher_context ctx;
+		ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &iv[0], iv.size());
+
+		std::vector<unsigned char> expected(plaintext.size() + algorithm.block_size());
+		size_t cnt = ctx.update(&expected[0], expected.size(), &plaintext[0], plaintext.size());
+		cnt += ctx.finalize(&expected[cnt], expected.size() - cnt);
+		expected.resize(cnt);
+
+		cryptoplus::file ciphertext_file = make_file(std::vector<unsigned char>());
+
+		CPPUNIT_ASSERT_EQUAL(static_cast<boost::uint64_t>(expected.size()), encrypt_file(ciphertext_file, make_file(plaintext), algorithm, &key[0], key.size(), &iv[0], iv.size(), buffer_size, 3));
+
+		const std::vector<unsigned char> ciphertext = read_file(ciphertext_file);
+
+		CPPUNIT_ASSERT(ciphertext == expected);
+
+		cryptoplus::file plaintext_file = make_file(std::vector<unsigned char>());
+
+		CPPUNIT_ASSERT_EQUAL(static_cast<boost::uint64_t>(plaintext.size()), decrypt_file(plaintext_file, make_file(ciphertext), algorithm, &key[0], key.size(), &iv[0], iv.size(), buffer_size, 3));
+		CPPUNIT_ASSERT(read_file(plaintext_file) == plaintext);
+
+		// A truncated ciphertext cannot be decrypted: the error of the cipher stage reaches the caller.
+		const std::vector<unsigned char> truncated(ciphertext.begin(), ciphertext.end() - 1);
+
+		CPPUNIT_ASSERT_THROW(decrypt_file(make_file(std::vector<unsigned char>()), make_file(truncated), algorithm, &key[0], key.size(), &iv[0], iv.size(), buffer_size, 3), cryptoplus::error::cryptographic_exception);
+	}
+}
+
+void CipherTest::testChunkedContainer()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const cipher_algorithm algorithm(EVP_aes_256_gcm());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const size_t chunk_size = 100;
+	const size_t record_size = chunk_size + 16;
+	const size_t header_size = 24;
+
+	// 10 full chunks and a 50 bytes one, written in uneven pieces and sealed by batches of 3 chunks.
+	const std::vector<unsigned char> plaintext = get_buffer(1050);
+
+	cryptoplus::file container_file = make_file(std::vector<unsigned char>());
+
+	{
+		chunked_writer writer(container_file, algorithm, &key[0], key.size(), chunk_size, 3);
+
+		writer.write(&plaintext[0], 7);
+		writer.write(&plaintext[7], 500);
+		writer.write(&plaintext[507], plaintext.size() - 507);
+		writer.finalize();
+
+		CPPUNIT_ASSERT_EQUAL(static_cast<boost::uint64_t>(plaintext.size()), writer.size());
+	}
+
+	const std::vector<unsigned char> container = read_file(container_file);
+
+	CPPUNIT_ASSERT_EQUAL(header_size + 10 * record_size + 50 + 16 + 12 + 16, container.size());
+
+	// The header: magic, version, tag length, reserved bytes, big-endian NID and chunk size, then the nonce prefix.
+	const unsigned char expected_header[] = { 'C', 'P', 'X', 'C', 1, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, chunk_size };
+	const int nid = algorithm.type();
+
+	CPPUNIT_ASSERT(std::equal(container.begin(), container.begin() + 8, expected_header));
+	CPPUNIT_ASSERT(container[10] == static_cast<unsigned char>(nid >> 8) && container[11] == static_cast<unsigned char>(nid));
+	CPPUNIT_ASSERT(std::equal(container.begin() + 12, container.begin() + 16, expected_header + 12));
+
+	// Open chunk 3 and the index by hand: the nonce is the prefix and the big-endian chunk index, the additional data the header and a flag.
+	const std::vector<unsigned char> header(container.begin(), container.begin() + header_size);
+
+	cipher_context ctx;
+	ctx.aead_initialize(algorithm, cipher_context::decrypt, &key[0], key.size(), 12, 16);
+
+	std::vector<unsigned char> nonce(header.end() - 8, header.end());
+	const unsigned char chunk_index[] = { 0, 0, 0, 3 };
+	nonce.insert(nonce.end(), chunk_index, chunk_index + sizeof(chunk_index));
+
+	std::vector<unsigned char> aad(header);
+	aad.push_back(0);
+
+	std::vector<unsigned char> record(container.begin() + header_size + 3 * record_size, container.begin() + header_size + 4 * record_size);
+
+	CPPUNIT_ASSERT(ctx.aead_decrypt(&record[0], chunk_size, &nonce[0], nonce.size(), &aad[0], aad.size(), &record[chunk_size], 16));
+	CPPUNIT_ASSERT(std::equal(record.begin(), record.begin() + chunk_size, plaintext.begin() + 3 * chunk_size));
+
+	std::fill(nonce.end() - 4, nonce.end(), 0xff);
+	aad.back() = 2;
+
+	std::vector<unsigned char> index(container.end() - 28, container.end());
+	const unsigned char expected_index[] = { 0, 0, 0, 0, 0, 0, 0x04, 0x1a, 0, 0, 0, 11 };
+
+	CPPUNIT_ASSERT(ctx.aead_decrypt(&index[0], 12, &nonce[0], nonce.size(), &aad[0], aad.size(), &index[12], 16));
+	CPPUNIT_ASSERT(std::equal(index.begin(), index.begin() + 12, expected_index));
+
+	// Random access reads.
+	{
+		chunked_reader reader(make_file(container), &key[0], key.size());
+
+		CPPUNIT_ASSERT_EQUAL(static_cast<boost::uint64_t>(plaintext.size()), reader.size());
+		CPPUNIT_ASSERT_EQUAL(chunk_size, reader.chunk_size());
+		CPPUNIT_ASSERT(reader.algorithm().type() == nid);
+
+		std::vector<unsigned char> buffer(300);
+
+		CPPUNIT_ASSERT_EQUAL(buffer.size(), reader.read(250, &buffer[0], buffer.size()));
+		CPPUNIT_ASSERT(std::equal(buffer.begin(), buffer.end(), plaintext.begin() + 250));
+		CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(20), reader.read(1030, &buffer[0], buffer.size()));
+		CPPUNIT_ASSERT(std::equal(buffer.begin(), buffer.begin() + 20, plaintext.begin() + 1030));
+		CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), reader.read(plaintext.size(), &buffer[0], buffer.size()));
+	}
+
+	// A tampered chunk only fails once it is read.
+	{
+		std::vector<unsigned char> tampered(container);
+		tampered[header_size + 2 * record_size + 5] ^= 0x01;
+
+		chunked_reader reader(make_file(tampered), &key[0], key.size());
+		unsigned char byte;
+
+		CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(1), reader.read(0, &byte, 1));
+		CPPUNIT_ASSERT_THROW(reader.read(2 * chunk_size, &byte, 1), std::runtime_error);
+	}
+
+	// Swapped chunks.
+	{
+		std::vector<unsigned char> reordered(container);
+		std::swap_ranges(reordered.begin() + header_size + record_size, reordered.begin() + header_size + 2 * record_size, reordered.begin() + header_size + 2 * record_size);
+
+		chunked_reader reader(make_file(reordered), &key[0], key.size());
+		unsigned char byte;
+
+		CPPUNIT_ASSERT_THROW(reader.read(chunk_size, &byte, 1), std::runtime_error);
+	}
+
+	// A missing last chunk, a missing index and a tampered header are detected on construction.
+	std::vector<unsigned char> truncated(container.begin(), container.end() - 28 - 66);
+	truncated.insert(truncated.end(), container.end() - 28, container.end());
+
+	CPPUNIT_ASSERT_THROW(chunked_reader(make_file(truncated), &key[0], key.size()), std::runtime_error);
+	CPPUNIT_ASSERT_THROW(chunked_reader(make_file(std::vector<unsigned char>(container.begin(), container.end() - 28)), &key[0], key.size()), std::runtime_error);
+
+	std::vector<unsigned char> tampered_header(container);
+	tampered_header[header_size - 1] ^= 0x01;
+
+	CPPUNIT_ASSERT_THROW(chunked_reader(make_file(tampered_header), &key[0], key.size()), std::runtime_error);
+#endif
+}
+
+void CipherTest::testSectorCipher()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const cipher_algorithm algorithm(EVP_aes_128_xts());
+
+	// IEEE 1619, XTS-AES-128 test vector 2: the data unit sequence number is the sector number.
+	{
+		const std::vector<unsigned char> key = get_xts_key();
+		const std::vector<unsigned char> plaintext(32, 0x44);
+		const unsigned char expected[] = {
+			0xc4, 0x54, 0x18, 0x5e, 0x6a, 0x16, 0x93, 0x6e, 0x39, 0x33, 0x40, 0x38, 0xac, 0xef, 0x83, 0x8b,
+			0xfb, 0x18, 0x6f, 0xff, 0x74, 0x80, 0xad, 0xc4, 0x28, 0x93, 0x82, 0xec, 0xd6, 0xd3, 0x94, 0xf0
+		};
+
+		sector_cipher cipher(algorithm, &key[0], key.size(), plaintext.size(), 1);
+		std::vector<unsigned char> ciphertext(plaintext.size());
+
+		cipher.encrypt(0x3333333333ULL, &ciphertext[0], &plaintext[0], plaintext.size());
+
+		CPPUNIT_ASSERT(ciphertext == std::vector<unsigned char>(expected, expected + sizeof(expected)));
+	}
+
+	// 700 sectors of 512 bytes: 4 threads get runs of at least 64 KiB each.
+	const std::vector<unsigned char> key = get_xts_key();
+	const size_t sector_size = 512;
+	const boost::uint64_t first_sector = 0x100000005ULL;
+	const std::vector<unsigned char> plaintext = get_buffer(700 * sector_size);
+
+	sector_cipher single(algorithm, &key[0], key.size(), sector_size, 1);
+	sector_cipher multiple(algorithm, &key[0], key.size(), sector_size, 4);
+
+	std::vector<unsigned char> expected(plaintext.size());
+	std::vector<unsigned char> ciphertext(plaintext);
+
+	single.encrypt(first_sector, &expected[0], &plaintext[0], plaintext.size());
+	multiple.encrypt(first_sector, &ciphertext[0], &ciphertext[0], ciphertext.size());
+
+	CPPUNIT_ASSERT(ciphertext == expected);
+
+	// Any sector matches a cipher_context whose IV is the little-endian sector number.
+	const size_t index = 633;
+	const unsigned char tweak[16] = { 0x7e, 0x02, 0x00, 0x00, 0x01 };
+	std::vector<unsigned char> sector(sector_size);
+
+	CPPUNIT_ASSERT(first_sector + index == 0x10000027eULL);
+
+	cipher_context ctx;
+	ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), tweak, sizeof(tweak));
+	ctx.update(&sector[0], sector.size(), &plaintext[index * sector_size], sector_size);
+
+	CPPUNIT_ASSERT(std::equal(sector.begin(), sector.end(), expected.begin() + index * sector_size));
+
+	multiple.decrypt(first_sector, &ciphertext[0], &ciphertext[0], ciphertext.size());
+
+	CPPUNIT_ASSERT(ciphertext == plaintext);
+
+	CPPUNIT_ASSERT_THROW(multiple.encrypt(first_sector, &ciphertext[0], &plaintext[0], sector_size + 1), std::invalid_argument);
+	CPPUNIT_ASSERT_THROW(sector_cipher(cipher_algorithm(EVP_aes_128_cbc()), &key[0], 16), std::invalid_argument);
+#endif
+}
+
+void CipherTest::testSelectFastest()
+{
+	const cipher_algorithm candidates[] = { EVP_aes_128_cbc(), EVP_aes_256_cbc() };
+	const size_t candidates_count = sizeof(candidates) / sizeof(candidates[0]);
+
+	const cipher_algorithm fastest = select_fastest(candidates, candidates_count, 1024);
+
+	CPPUNIT_ASSERT((fastest.raw() == candidates[0].raw()) || (fastest.raw() == candidates[1].raw()));
+
+	// The result is cached.
+	for (unsigned int i = 0; i < 10; ++i)
+	{
+		CPPUNIT_ASSERT(select_fastest(candidates, candidates_count, 1024).raw() == fastest.raw());
+	}
+
+	CPPUNIT_ASSERT_THROW(select_fastest(candidates, 0, 1024), std::invalid_argument);
+	CPPUNIT_ASSERT_THROW(select_fastest(std::vector<cipher_algorithm>(), 1024), std::invalid_argument);
+	CPPUNIT_ASSERT_THROW(select_fastest(candidates, candidates_count, 0), std::invalid_argument);
+
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+	// Neither XTS nor a key wrapping mode can cipher 13 bytes messages.
+	const cipher_algorithm unusable_candidates[] = { EVP_aes_128_xts(), EVP_aes_128_wrap() };
+
+	CPPUNIT_ASSERT_THROW(select_fastest(unusable_candidates, sizeof(unusable_candidates) / sizeof(unusable_candidates[0]), 13), std::invalid_argument);
+#endif
+}
+
+void CipherTest::testChannel()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const std::vector<unsigned char> key(16, 0x42);
+	const std::vector<unsigned char> iv(16, 0x24);
+	const std::vector<unsigned char> mac_key(32, 0x12);
+	const std::vector<unsigned char> input = get_buffer(1000);
+
+	channel aead_sender(cipher_algorithm(EVP_aes_128_gcm()), &key[0], key.size(), &iv[0], 12);
+	channel aead_receiver(cipher_algorithm(EVP_aes_128_gcm()), &key[0], key.size(), &iv[0], 12);
+	channel etm_sender(cipher_algorithm(EVP_aes_128_ctr()), &key[0], key.size(), &iv[0], iv.size(), cryptoplus::hash::message_digest_algorithm(EVP_sha256()), &mac_key[0], mac_key.size());
+	channel etm_receiver(cipher_algorithm(EVP_aes_128_ctr()), &key[0], key.size(), &iv[0], iv.size(), cryptoplus::hash::message_digest_algorithm(EVP_sha256()), &mac_key[0], mac_key.size());
+
+	channel* const senders[] = { &aead_sender, &etm_sender };
+	channel* const receivers[] = { &aead_receiver, &etm_receiver };
+
+	for (size_t i = 0; i < 2; ++i)
+	{
+		std::vector<unsigned char> first(input.size() + senders[i]->overhead());
+		std::vector<unsigned char> second(input.size() + senders[i]->overhead());
+		std::vector<unsigned char> output(input.size());
+		size_t len = 0;
+
+		CPPUNIT_ASSERT_EQUAL(first.size(), senders[i]->seal(&first[0], first.size(), &input[0], input.size()));
+		CPPUNIT_ASSERT_EQUAL(second.size(), senders[i]->seal(&second[0], second.size(), &input[0], input.size()));
+
+		// Out of order datagrams are fine, replayed or tampered ones are not.
+		CPPUNIT_ASSERT_EQUAL(channel::opened, receivers[i]->open(&output[0], output.size(), &second[0], second.size(), &len));
+		CPPUNIT_ASSERT(std::vector<unsigned char>(output.begin(), output.begin() + len) == input);
+		CPPUNIT_ASSERT_EQUAL(channel::replayed, receivers[i]->open(&output[0], output.size(), &second[0], second.size(), &len));
+
+		// Output buffers that are too short: nothing is written and the datagram can still be opened later.
+		std::vector<unsigned char> short_buffer(first.size() - 1);
+
+		CPPUNIT_ASSERT_THROW(senders[i]->seal(&short_buffer[0], short_buffer.size(), &input[0], input.size()), std::runtime_error);
+		CPPUNIT_ASSERT_EQUAL(channel::malformed, receivers[i]->open(&short_buffer[0], input.size() - 1, &first[0], first.size(), &len));
+
+		first[channel::header_size] ^= 0x01;
+		CPPUNIT_ASSERT_EQUAL(channel::forged, receivers[i]->open(&output[0], output.size(), &first[0], first.size(), &len));
+		first[channel::header_size] ^= 0x01;
+
+		// Opening in place.
+		CPPUNIT_ASSERT_EQUAL(channel::opened, receivers[i]->open(&first[0], first.size(), &first[0], first.size(), &len));
+		CPPUNIT_ASSERT(std::vector<unsigned char>(first.begin(), first.begin() + len) == input);
+
+		CPPUNIT_ASSERT_EQUAL(channel::malformed, receivers[i]->open(&output[0], output.size(), &first[0], senders[i]->overhead() - 1, &len));
+	}
+#endif
+}
+
+void CipherTest::testReplayWindow()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	replay_window window(2048);
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(2048), window.size());
+	CPPUNIT_ASSERT(window.accept(5000));
+	CPPUNIT_ASSERT(!window.accept(5000));
+	CPPUNIT_ASSERT(window.accept(4000));
+	CPPUNIT_ASSERT(!window.accept(5000 - 2048));
+	CPPUNIT_ASSERT(window.check(5000 - 2047));
+	CPPUNIT_ASSERT(window.accept(5000 - 2047));
+	CPPUNIT_ASSERT(!window.check(5000 - 2047));
+
+	for (boost::uint64_t sequence = 5001; sequence < 20000; ++sequence)
+	{
+		CPPUNIT_ASSERT(window.accept(sequence));
+	}
+
+	CPPUNIT_ASSERT(!window.accept(4000));
+	CPPUNIT_ASSERT(!window.accept(19999));
+	CPPUNIT_ASSERT_EQUAL(static_cast<boost::uint64_t>(19999), window.highest());
+#endif
+}
+
+void CipherTest::testKeyWrap()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+	// RFC 3394, section 4.1.
+	const unsigned char kek[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+	const unsigned char key[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+	const unsigned char wrapped_key[] = { 0x1f, 0xa6, 0x8b, 0x0a, 0x81, 0x12, 0xb4, 0x47, 0xae, 0xf3, 0x4b, 0xd8, 0xfb, 0x5a, 0x7b, 0x82, 0x9d, 0x3e, 0x86, 0x23, 0x71, 0xd2, 0xcf, 0xe5 };
+
+	const cipher_algorithm algorithm(EVP_aes_128_wrap());
+	const size_t entries_count = 1000;
+
+	std::vector<unsigned char> wrapped(entries_count * sizeof(wrapped_key));
+	std::vector<unsigned char> unwrapped(entries_count * sizeof(key));
+	std::vector<key_wrap_entry> entries(entries_count);
+
+	CPPUNIT_ASSERT_EQUAL(sizeof(wrapped_key), get_wrapped_key_size(algorithm, sizeof(key)));
+
+	for (size_t i = 0; i < entries_count; ++i)
+	{
+		const key_wrap_entry entry = { key, sizeof(key), &wrapped[i * sizeof(wrapped_key)], sizeof(wrapped_key), 0 };
+		entries[i] = entry;
+	}
+
+	key_wrap(algorithm, kek, sizeof(kek), &entries[0], entries.size(), 4);
+
+	for (size_t i = 0; i < entries_count; ++i)
+	{
+		CPPUNIT_ASSERT_EQUAL(sizeof(wrapped_key), entries[i].result_len);
+		CPPUNIT_ASSERT(std::equal(wrapped_key, wrapped_key + sizeof(wrapped_key), &wrapped[i * sizeof(wrapped_key)]));
+
+		const key_wrap_entry entry = { &wrapped[i * sizeof(wrapped_key)], sizeof(wrapped_key), &unwrapped[i * sizeof(key)], sizeof(key), 0 };
+		entries[i] = entry;
+	}
+
+	// A tampered entry fails alone.
+	wrapped[0] ^= 0x01;
+
+	CPPUNIT_ASSERT_EQUAL(entries_count - 1, key_unwrap(algorithm, kek, sizeof(kek), &entries[0], entries.size(), 4));
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), entries[0].result_len);
+
+	for (size_t i = 1; i < entries_count; ++i)
+	{
+		CPPUNIT_ASSERT_EQUAL(sizeof(key), entries[i].result_len);
+		CPPUNIT_ASSERT(std::equal(key, key + sizeof(key), &unwrapped[i * sizeof(key)]));
+	}
+#endif
+}
+
+void CipherTest::testOneShot()
+{
+	const cipher_algorithm algorithm(EVP_aes_256_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+	const std::vector<unsigned char> input = get_buffer(100);
+
+	cipher_stream stream(0);
+	stream.initialize(algorithm, cipher_stream::encrypt, &key[0], key.size(), &iv[0], iv.size());
+	stream.append(&input[0], input.size());
+	stream.finalize();
+
+	// The second round uses the pooled contexts, the third one fresh contexts again.
+	for (size_t i = 0; i < 3; ++i)
+	{
+		if (i == 2)
+		{
+			clear_context_pool();
+		}
+
+		const std::vector<unsigned char> ciphertext = encrypt<unsigned char>(&input[0], input.size(), algorithm, &key[0], key.size(), &iv[0], iv.size());
+
+		CPPUNIT_ASSERT(ciphertext == stream.result());
+		CPPUNIT_ASSERT(decrypt<unsigned char>(&ciphertext[0], ciphertext.size(), algorithm, &key[0], key.size(), &iv[0], iv.size()) == input);
+	}
+
+	// Clearing an empty pool is harmless.
+	clear_context_pool();
+	clear_context_pool();
+}
+
+void CipherTest::testNonceGenerator()
+{
+	nonce_generator generator;
+	std::set<std::vector<unsigned char> > nonces;
+
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		const std::vector<unsigned char> nonce = generator.generate<unsigned char>();
+
+		CPPUNIT_ASSERT_EQUAL(nonce_generator::default_nonce_size, nonce.size());
+		CPPUNIT_ASSERT(nonces.insert(nonce).second);
+	}
+
+	CPPUNIT_ASSERT_EQUAL(nonce_generator::default_limit - 1000, generator.remaining());
+}
+
+void CipherTest::testNonceGeneratorExhaustion()
+{
+	nonce_generator generator(nonce_generator::default_nonce_size, 2);
+
+	generator.generate<unsigned char>();
+	generator.generate<unsigned char>();
+	generator.generate<unsigned char>();
+}
+
+void CipherTest::testNonceGeneratorAlgorithms()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const std::vector<unsigned char> key(16, 0x42);
+	unsigned char iv[16];
+
+	// AEAD algorithms take generated nonces.
+	nonce_generator gcm_generator(12);
+	cipher_context ctx;
+	ctx.initialize(EVP_aes_128_gcm(), cipher_context::encrypt, &key[0], key.size(), gcm_generator, iv, 12);
+	ctx.set_iv(gcm_generator, iv, 12);
+
+	// Counter and CBC modes do not: their ivs would overlap or be predictable.
+	nonce_generator generator(16);
+
+	CPPUNIT_ASSERT_THROW(ctx.initialize(EVP_aes_128_ctr(), cipher_context::encrypt, &key[0], key.size(), generator, iv, sizeof(iv)), std::invalid_argument);
+	CPPUNIT_ASSERT_THROW(ctx.initialize(EVP_aes_128_cbc(), cipher_context::encrypt, &key[0], key.size(), generator, iv, sizeof(iv)), std::invalid_argument);
+
+	ctx.initialize(EVP_aes_128_ctr(), cipher_context::encrypt, &key[0], key.size(), iv, sizeof(iv));
+
+	CPPUNIT_ASSERT_THROW(ctx.set_iv(generator, iv, sizeof(iv)), std::invalid_argument);
+
+	// No nonce was consumed by the refused calls.
+	CPPUNIT_ASSERT_EQUAL(nonce_generator::default_limit, generator.remaining());
+#endif
+}
+
+void CipherTest::testAuthenticatedCipher()
+{
+	const cipher_algorithm algorithm(EVP_aes_128_cbc());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> mac_key(32, 0x43);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0x24);
+	const std::vector<unsigned char> aad = get_buffer(20);
+
+	// Larger than a chunk and not a multiple of it.
+	const std::vector<unsigned char> input = get_buffer(3 * authenticated_cipher::chunk_size + 100);
+
+	authenticated_cipher cipher(algorithm, &key[0], key.size(), EVP_sha256(), &mac_key[0], mac_key.size());
+
+	std::vector<unsigned char> ciphertext(input.size() + algorithm.block_size());
+	unsigned char tag[16];
+	ciphertext.resize(cipher.encrypt(&ciphertext[0], ciphertext.size(), &input[0], input.size(), &iv[0], iv.size(), &aad[0], aad.size(), tag, sizeof(tag)));
+
+	CPPUNIT_ASSERT(ciphertext == encrypt<unsigned char>(&input[0], input.size(), algorithm, &key[0], key.size(), &iv[0], iv.size()));
+
+	std::vector<unsigned char> output(ciphertext.size() + algorithm.block_size());
+	size_t len = 0;
+
+	CPPUNIT_ASSERT(cipher.decrypt(&output[0], output.size(), &ciphertext[0], ciphertext.size(), &iv[0], iv.size(), &aad[0], aad.size(), tag, sizeof(tag), &len));
+	output.resize(len);
+	CPPUNIT_ASSERT(output == input);
+
+	output.assign(ciphertext.size() + algorithm.block_size(), 0x00);
+
+	CPPUNIT_ASSERT(!cipher.decrypt(&output[0], output.size(), &ciphertext[0], ciphertext.size(), &iv[0], iv.size(), &aad[0], aad.size() - 1, tag, sizeof(tag), &len));
+
+	ciphertext[authenticated_cipher::chunk_size] ^= 0x01;
+
+	CPPUNIT_ASSERT(!cipher.decrypt(&output[0], output.size(), &ciphertext[0], ciphertext.size(), &iv[0], iv.size(), &aad[0], aad.size(), tag, sizeof(tag), &len));
+	CPPUNIT_ASSERT(std::count(output.begin(), output.end(), 0) == static_cast<std::ptrdiff_t>(output.size()));
+
+	// A short message: the last block held back by the padding must not be left in output either.
+	const std::vector<unsigned char> short_input = get_buffer(70);
+
+	ciphertext.resize(short_input.size() + algorithm.block_size());
+	ciphertext.resize(cipher.encrypt(&ciphertext[0], ciphertext.size(), &short_input[0], short_input.size(), &iv[0], iv.size(), &aad[0], aad.size(), tag, sizeof(tag)));
+	tag[0] ^= 0x01;
+	output.assign(ciphertext.size() + algorithm.block_size(), 0x00);
+
+	CPPUNIT_ASSERT(!cipher.decrypt(&output[0], output.size(), &ciphertext[0], ciphertext.size(), &iv[0], iv.size(), &aad[0], aad.size(), tag, sizeof(tag), &len));
+	CPPUNIT_ASSERT(std::count(output.begin(), output.end(), 0) == static_cast<std::ptrdiff_t>(output.size()));
+}
+
+void CipherTest::testKeystreamCipher()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+	const cipher_algorithm algorithm(EVP_aes_128_ctr());
+	const std::vector<unsigned char> key(algorithm.key_length(), 0x42);
+	const std::vector<unsigned char> iv(algorithm.iv_length(), 0xff);
+	const std::vector<unsigned char> input = get_buffer(100000);
+
+	std::vector<unsigned char> expected(input.size() + algorithm.block_size());
+	cipher_context ctx;
+	ctx.initialize(algorithm, cipher_context::encrypt, &key[0], key.size(), &iv[0], iv.size());
+	expected.resize(ctx.update(&expected[0], expected.size(), &input[0], input.size()));
+
+	// A small ring buffer, so that both the precomputed and the synchronous paths are taken.
+	keystream_cipher cipher(algorithm, &key[0], key.size(), &iv[0], iv.size(), 1000);
+	std::vector<unsigned char> buffer = input;
+
+	for (size_t offset = 0, step = 1; offset < buffer.size(); offset += step, step = step * 3 % 1777)
+	{
+		cipher.update(&buffer[offset], &buffer[offset], std::min(step, buffer.size() - offset));
+	}
+
+	CPPUNIT_ASSERT(buffer == expected);
+	CPPUNIT_ASSERT_EQUAL(static_cast<boost::uint64_t>(input.size()), cipher.position());
+#endif
+}
@@ -0,0 +1,120 @@
+/*
+ * libcryptoplus - C++ portable OpenSSL cryptographic wrapper library.
+ * Copyright (C) 2010-2011 Julien Kauffmann <julien.kauffmann@freelan.org>
+ *
+ * This file is part of libcryptoplus.
+ *
+ * libcryptoplus is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * libcryptoplus is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program. If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ *
+ * If you intend to use libcryptoplus in a commercial software, please
+ * contact me : we may arrange this for a small fee or no fee at all,
+ * depending on the nature of your project.
+ */
+
+/**
+ * \file cipher.hpp
+ * \author Julien Kauffmann <julien.kauffmann@freelan.org>
+ * \brief The cipher test file.
+ */
+
+#ifndef TESTS_CIPHER_HPP
+#define TESTS_CIPHER_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cryptoplus/cipher/nonce_generator.hpp>
+
+#include <stdexcept>
+
+class CipherTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CipherTest);
+	CPPUNIT_TEST(testInPlaceCTR);
+	CPPUNIT_TEST(testInPlaceGCM);
+	CPPUNIT_TEST(testInPlaceChaCha20);
+	CPPUNIT_TEST(testInPlaceCBC);
+	CPPUNIT_TEST(testInPlaceStream);
+	CPPUNIT_TEST_EXCEPTION(testInPlacePaddingException, std::logic_error);
+	CPPUNIT_TEST_EXCEPTION(testInPlaceLengthException, std::logic_error);
+	CPPUNIT_TEST(testScatterGather);
+	CPPUNIT_TEST(testStreamSink);
+	CPPUNIT_TEST(testStreambuf);
+	CPPUNIT_TEST(testSealArena);
+	CPPUNIT_TEST(testAeadLengths);
+	CPPUNIT_TEST(testCipherContextCache);
+	CPPUNIT_TEST(testParallelGCM);
+	CPPUNIT_TEST(testFileCipher);
+	CPPUNIT_TEST(testChunkedContainer);
+	CPPUNIT_TEST(testSectorCipher);
+	CPPUNIT_TEST(testSelectFastest);
+	CPPUNIT_TEST(testChannel);
+	CPPUNIT_TEST(testReplayWindow);
+	CPPUNIT_TEST(testKeyWrap);
+	CPPUNIT_TEST(testOneShot);
+	CPPUNIT_TEST(testNonceGenerator);
+	CPPUNIT_TEST_EXCEPTION(testNonceGeneratorExhaustion, cryptoplus::cipher::nonce_exhausted_error);
+	CPPUNIT_TEST(testNonceGeneratorAlgorithms);
+	CPPUNIT_TEST(testAuthenticatedCipher);
+	CPPUNIT_TEST(testKeystreamCipher);
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+
+		void setUp();
+		void tearDown();
+
+		void testInPlaceCTR();
+		void testInPlaceGCM();
+		void testInPlaceChaCha20();
+		void testInPlaceCBC();
+		void testInPlaceStream();
+		void testInPlacePaddingException();
+		void testInPlaceLengthException();
+		void testScatterGather();
+		void testStreamSink();
+		void testStreambuf();
+		void testSealArena();
+		void testAeadLengths();
+		void testCipherContextCache();
+		void testParallelGCM();
+		void testFileCipher();
+		void testChunkedContainer();
+		void testSectorCipher();
+		void testSelectFastest();
+		void testChannel();
+		void testReplayWindow();
+		void testKeyWrap();
+		void testOneShot();
+		void testNonceGenerator();
+		void testNonceGeneratorExhaustion();
+		void testNonceGeneratorAlgorithms();
+		void testAuthenticatedCipher();
+		void testKeystreamCipher();
+};
+
+#endif /* TESTS_CIPHER_HPP */
@@ -45,11 +45,53 @@
 #include "hash.hpp"
 
 #include <cryptoplus/hash/message_digest_algorithm.hpp>
+#include <cryptoplus/hash/hmac_context.hpp>
+#include <cryptoplus/hash/hmac.hpp>
+#include <cryptoplus/hash/message_digest.hpp>
+#include <cryptoplus/hash/tree_digest.hpp>
+#include <cryptoplus/parallel.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
 
 CPPUNIT_TEST_SUITE_REGISTRATION(HashTest);
 
 using namespace cryptoplus::hash;
 
+namespace
+{
+	// Built before main(), possibly before the library statics: the fetch cache must already be usable.
+	const message_digest_algorithm static_algorithm(EVP_sha1());
+
+	class algorithm_lookup
+	{
+		public:
+
+			explicit algorithm_lookup(const EVP_MD** handles) : m_handles(handles) {}
+
+			void operator()(size_t index) const
+			{
+				m_handles[index] = message_digest_algorithm(EVP_sha256()).raw();
+			}
+
+		private:
+
+			const EVP_MD** m_handles;
+	};
+
+	std::vector<unsigned char> tree_hash(const message_digest_algorithm& algorithm, unsigned char prefix, const std::vector<unsigned char>& left, const std::vector<unsigned char>& right = std::vector<unsigned char>())
+	{
+		std::vector<unsigned char> buffer(1, prefix);
+
+		buffer.insert(buffer.end(), left.begin(), left.end());
+		buffer.insert(buffer.end(), right.begin(), right.end());
+
+		return message_digest<unsigned char>(&buffer[0], buffer.size(), algorithm);
+	}
+}
+
 void HashTest::setUp()
 {
 }
@@ -69,4 +111,198 @@ void HashTest::testAlgorithms()
 	message_digest_algorithm a2("SHA256");
 
 	CPPUNIT_ASSERT(a1.raw() == a2.raw());
+	CPPUNIT_ASSERT(static_algorithm.raw() == message_digest_algorithm(EVP_sha1()).raw());
+
+	// Threads that look the same algorithm up concurrently all get the same handle.
+	std::vector<const EVP_MD*> handles(64);
+
+	cryptoplus::parallel_for(handles.size(), 4, algorithm_lookup(&handles[0]));
+
+	CPPUNIT_ASSERT(std::count(handles.begin(), handles.end(), a1.raw()) == static_cast<std::ptrdiff_t>(handles.size()));
+}
+
+void HashTest::testHmacContext()
+{
+	// RFC 4231, test case 2.
+	const char key[] = "Jefe";
+	const char data[] = "what do ya want for nothing?";
+	const unsigned char expected[] = {
+		0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+		0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+	};
+
+	const message_digest_algorithm algorithm(EVP_sha256());
+
+	hmac_context ctx;
+	ctx.initialize(key, std::strlen(key), &algorithm);
+	ctx.update(data, std::strlen(data));
+
+	CPPUNIT_ASSERT(ctx.finalize<unsigned char>() == std::vector<unsigned char>(expected, expected + sizeof(expected)));
+	CPPUNIT_ASSERT(ctx.algorithm().raw() == algorithm.raw());
+
+	// The key and the algorithm are kept.
+	ctx.initialize(NULL, 0, NULL);
+	ctx.update(data, std::strlen(data));
+
+	CPPUNIT_ASSERT(ctx.finalize<unsigned char>() == std::vector<unsigned char>(expected, expected + sizeof(expected)));
+}
+
+void HashTest::testHmacKey()
+{
+	// RFC 4231, test case 6: a key longer than a block.
+	const std::vector<unsigned char> key(131, 0xaa);
+	const char data[] = "Test Using Larger Than Block-Size Key - Hash Key First";
+	const unsigned char expected[] = {
+		0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f, 0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+		0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14, 0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54
+	};
+
+	const hmac_key long_key(&key[0], key.size(), message_digest_algorithm(EVP_sha256()));
+
+	CPPUNIT_ASSERT(hmac<unsigned char>(data, std::strlen(data), long_key) == std::vector<unsigned char>(expected, expected + sizeof(expected)));
+
+	// The key can be used for several messages, and gives the same results as hmac().
+	const message_digest_algorithm algorithms[] = { EVP_sha1(), EVP_sha256(), EVP_sha512() };
+
+	for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); ++a)
+	{
+		for (size_t key_len = 0; key_len < key.size(); key_len += 13)
+		{
+			const hmac_key precomputed_key(&key[0], key_len, algorithms[a]);
+
+			for (size_t len = 0; len < std::strlen(data); len += 7)
+			{
+				CPPUNIT_ASSERT(hmac<unsigned char>(data, len, precomputed_key) == hmac<unsigned char>(&key[0], key_len, data, len, algorithms[a]));
+			}
+		}
+	}
+}
+
+void HashTest::testMessageDigestBatch()
+{
+	const message_digest_algorithm algorithms[] = { EVP_sha1(), EVP_sha256(), EVP_sha512() };
+
+	// Every padding case, and more buffers than there are lanes.
+	const size_t count = 130;
+	std::vector<unsigned char> data(count);
+
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<unsigned char>(i * 7 + 3);
+	}
+
+	// Check both code paths, whatever the host would pick: the AVX2 lanes are only skipped without AVX2.
+	const cryptoplus::hash::detail::batch_mode modes[] = { cryptoplus::hash::detail::batch_one_by_one, cryptoplus::hash::detail::batch_multi_buffer };
+
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m)
+	{
+		if (!cryptoplus::hash::detail::set_batch_mode(modes[m]))
+		{
+			continue;
+		}
+
+		for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); ++a)
+		{
+			std::vector<cryptoplus::const_buffer> inputs;
+			std::vector<cryptoplus::mutable_buffer> outputs;
+			std::vector<unsigned char> results(count * algorithms[a].result_size());
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				inputs.push_back(cryptoplus::const_buffer(&data[0], i));
+				outputs.push_back(cryptoplus::mutable_buffer(&results[i * algorithms[a].result_size()], algorithms[a].result_size()));
+			}
+
+			message_digest_batch(algorithms[a], &inputs[0], &outputs[0], count);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const std::vector<unsigned char> expected = message_digest<unsigned char>(&data[0], i, algorithms[a]);
+
+				CPPUNIT_ASSERT(std::vector<unsigned char>(results.begin() + i * expected.size(), results.begin() + (i + 1) * expected.size()) == expected);
+			}
+		}
+	}
+
+	CPPUNIT_ASSERT(cryptoplus::hash::detail::set_batch_mode(cryptoplus::hash::detail::batch_auto));
+}
+
+void HashTest::testTreeDigest()
+{
+	const message_digest_algorithm algorithm(EVP_sha256());
+
+	// 20 bytes in leaves of 3 bytes: 7 leaves, the last one being 2 bytes long.
+	std::vector<unsigned char> data(20);
+
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<unsigned char>(i * 7 + 3);
+	}
+
+	std::vector<std::vector<unsigned char> > leaves;
+
+	for (size_t offset = 0; offset < data.size(); offset += 3)
+	{
+		leaves.push_back(tree_hash(algorithm, 0x00, std::vector<unsigned char>(data.begin() + offset, data.begin() + std::min(offset + 3, data.size()))));
+	}
+
+	// RFC 6962: the left subtree holds the first 4 leaves, the right one the last 3.
+	const std::vector<unsigned char> left = tree_hash(algorithm, 0x01, tree_hash(algorithm, 0x01, leaves[0], leaves[1]), tree_hash(algorithm, 0x01, leaves[2], leaves[3]));
+	const std::vector<unsigned char> right = tree_hash(algorithm, 0x01, tree_hash(algorithm, 0x01, leaves[4], leaves[5]), leaves[6]);
+	const std::vector<unsigned char> expected = tree_hash(algorithm, 0x01, left, right);
+
+	const tree_digest tree(&data[0], data.size(), algorithm, 3, 1);
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(7), tree.leaves_count());
+	CPPUNIT_ASSERT(tree.root() == expected);
+	CPPUNIT_ASSERT(tree_digest(&data[0], data.size(), algorithm, 3, 4).root() == expected);
+
+	// Runs are at least 1 MiB long: 5 MiB and 7 bytes in 1 MiB leaves give 6 leaves, hashed in 3 runs of 2 leaves with 3 or 4 threads.
+	std::vector<unsigned char> large_data(5 * tree_digest::default_leaf_size + 7);
+
+	for (size_t i = 0; i < large_data.size(); ++i)
+	{
+		large_data[i] = static_cast<unsigned char>(i * 7 + 3);
+	}
+
+	std::vector<std::vector<unsigned char> > large_leaves;
+
+	for (size_t offset = 0; offset < large_data.size(); offset += tree_digest::default_leaf_size)
+	{
+		large_leaves.push_back(tree_hash(algorithm, 0x00, std::vector<unsigned char>(large_data.begin() + offset, large_data.begin() + std::min(offset + tree_digest::default_leaf_size, large_data.size()))));
+	}
+
+	// RFC 6962: the left subtree holds the first 4 leaves, the right one the last 2.
+	const std::vector<unsigned char> large_expected = tree_hash(algorithm, 0x01, tree_hash(algorithm, 0x01, tree_hash(algorithm, 0x01, large_leaves[0], large_leaves[1]), tree_hash(algorithm, 0x01, large_leaves[2], large_leaves[3])), tree_hash(algorithm, 0x01, large_leaves[4], large_leaves[5]));
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(6), large_leaves.size());
+
+	for (unsigned int threads_count = 1; threads_count <= 4; ++threads_count)
+	{
+		const tree_digest large_tree(&large_data[0], large_data.size(), algorithm, tree_digest::default_leaf_size, threads_count);
+
+		CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(6), large_tree.leaves_count());
+		CPPUNIT_ASSERT(large_tree.root() == large_expected);
+	}
+
+	for (size_t i = 0; i < tree.leaves_count(); ++i)
+	{
+		const size_t offset = i * 3;
+		const size_t len = std::min(static_cast<size_t>(3), data.size() - offset);
+		const tree_digest::proof_type proof = tree.inclusion_proof(i);
+
+		CPPUNIT_ASSERT(tree_digest::verify_inclusion_proof(algorithm, &expected[0], expected.size(), &data[offset], len, i, tree.leaves_count(), proof));
+		CPPUNIT_ASSERT(!tree_digest::verify_inclusion_proof(algorithm, &expected[0], expected.size(), &data[offset], len, (i + 1) % tree.leaves_count(), tree.leaves_count(), proof));
+		CPPUNIT_ASSERT(!tree_digest::verify_inclusion_proof(algorithm, &expected[0], expected.size(), &data[offset], len - 1, i, tree.leaves_count(), proof));
+	}
+
+	CPPUNIT_ASSERT(tree.inclusion_proof(6).size() == 2);
+	CPPUNIT_ASSERT(tree.inclusion_proof(6)[0] == tree_hash(algorithm, 0x01, leaves[4], leaves[5]));
+	CPPUNIT_ASSERT(tree.inclusion_proof(6)[1] == left);
+
+	// An empty buffer has no leaves and its root is the digest of the empty string.
+	const tree_digest empty_tree(NULL, 0, algorithm);
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), empty_tree.leaves_count());
+	CPPUNIT_ASSERT(empty_tree.root() == message_digest<unsigned char>(&data[0], 0, algorithm));
 }
@@ -54,6 +54,10 @@ class HashTest : public CppUnit::TestFixture
 	CPPUNIT_TEST_SUITE(HashTest);
 	CPPUNIT_TEST_EXCEPTION(testInvalidNameException, std::invalid_argument);
 	CPPUNIT_TEST(testAlgorithms);
+	CPPUNIT_TEST(testHmacContext);
+	CPPUNIT_TEST(testHmacKey);
+	CPPUNIT_TEST(testMessageDigestBatch);
+	CPPUNIT_TEST(testTreeDigest);
 	CPPUNIT_TEST_SUITE_END();
 
 	public:
@@ -63,6 +67,10 @@ class HashTest : public CppUnit::TestFixture
 
 		void testInvalidNameException();
 		void testAlgorithms();
+		void testHmacContext();
+		void testHmacKey();
+		void testMessageDigestBatch();
+		void testTreeDigest();
 };
 
 #endif /* TESTS_HASH_HPP */